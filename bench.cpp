@@ -0,0 +1,1018 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "columnbatch.h"
+#include "fieldinstrumentation.h"
+#include "genericpacketparser.h"
+#include "latencyhistogram.h"
+#include "objectpool.h"
+#include "packetbatcher.h"
+#include "packetgenerator.h"
+#include "packettranscoder.h"
+#include "packetwriter.h"
+#include "parallelparser.h"
+#include "parserstats.h"
+#include "pipeline.h"
+#include "shardedparser.h"
+#include "stringinterner.h"
+
+#if defined(__linux__)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace GenericPacketParser;
+
+struct SubPacket
+{
+    string name;
+    uint32_t value;
+    void setName(const char* s) { name = s; }
+    void setValue(uint32_t v) { value = v; }
+};
+
+struct MyPacket
+{
+    string name;
+    uint32_t value;
+    vector<SubPacket> array;
+    void setName(const char* s) { name = s; }
+    void setValue(uint32_t v) { value = v; }
+    void addToArray(SubPacket& sp) { array.emplace_back(sp); }
+};
+
+struct VersionedPacket
+{
+    string name;
+    uint32_t value;
+    uint64_t timestamp;
+    vector<SubPacket> array;
+    void setName(const char* s) { name = s; }
+    void setValue(uint32_t v) { value = v; }
+    void setShortValue(uint16_t v) { value = v; }
+    void setTimestamp(uint64_t v) { timestamp = v; }
+    void addToArray(SubPacket& sp) { array.emplace_back(sp); }
+};
+
+struct BlobPacket
+{
+    uint32_t value;
+    vector<unsigned char> payload;
+    void setValue(uint32_t v) { value = v; }
+    void setPayload(const unsigned char* data, size_t length) { payload.assign(data, data + length); }
+};
+
+struct Tick
+{
+    uint64_t timestamp;
+    uint32_t price;
+    uint16_t quantity;
+    uint8_t side;
+    void setTimestamp(uint64_t v) { timestamp = v; }
+    void setPrice(uint32_t v) { price = v; }
+    void setQuantity(uint16_t v) { quantity = v; }
+    void setSide(uint8_t v) { side = v; }
+};
+
+struct Quote
+{
+    uint16_t instrument;
+    uint32_t sequence;
+    void setInstrument(uint16_t v) { instrument = v; }
+    void setSequence(uint32_t v) { sequence = v; }
+};
+
+struct Trade
+{
+    uint32_t id;
+    string venue;
+    uint64_t price;
+    vector<uint16_t> sizes;
+    void setId(uint32_t v) { id = v; }
+    void setVenue(const char* s) { venue = s; }
+    void setPrice(uint64_t v) { price = v; }
+    void addSize(uint16_t v) { sizes.push_back(v); }
+};
+
+struct NamedOrder
+{
+    string symbol;
+    string venue;
+    uint32_t quantity;
+    void setSymbol(const char* s) { symbol = s; }
+    void setVenue(const char* s) { venue = s; }
+    void setQuantity(uint32_t v) { quantity = v; }
+};
+
+struct InternedOrder
+{
+    InternedText symbol;
+    InternedText venue;
+    uint32_t quantity;
+    void setSymbol(InternedText text) { symbol = text; }
+    void setVenue(InternedText text) { venue = text; }
+    void setQuantity(uint32_t v) { quantity = v; }
+};
+
+struct Level
+{
+    uint64_t price;
+    uint32_t quantity;
+    void setPrice(uint64_t v) { price = v; }
+    void setQuantity(uint32_t v) { quantity = v; }
+};
+
+struct Snapshot
+{
+    vector<Level> levels;
+    void addLevel(Level& level) { levels.push_back(level); }
+};
+
+struct Record
+{
+    string name;
+    uint32_t value;
+    vector<unsigned char> payload;
+    void setName(const char* s) { name = s; }
+    void setValue(uint32_t v) { value = v; }
+    void setPayload(const unsigned char* data, size_t length) { payload.assign(data, data + length); }
+};
+
+struct RecordBatch
+{
+    vector<Record> records;
+    void addRecord(Record& record) { records.push_back(record); }
+};
+
+struct PooledPacket
+{
+    string name;
+    uint32_t value;
+    vector<SubPacket> array;
+    void setName(const char* s) { name = s; }
+    void setValue(uint32_t v) { value = v; }
+    void addToArray(SubPacket& sp) { array.emplace_back(sp); }
+    void reset() { name.clear(); value = 0; array.clear(); }
+};
+
+struct FieldPacket
+{
+    uint32_t value;
+    uint64_t wide;
+    string text;
+    vector<unsigned char> payload;
+    Level level;
+    vector<uint32_t> values;
+    void setValue(uint32_t v) { value = v; }
+    void setWide(uint64_t v) { wide = v; }
+    void setText(const char* s) { text = s; }
+    void setPayload(const unsigned char* data, size_t length) { payload.assign(data, data + length); }
+    void setLevel(Level& l) { level = l; }
+    void addValue(uint32_t v) { values.push_back(v); }
+    void reset() { text.clear(); payload.clear(); values.clear(); }
+};
+
+// Heap allocations so far, counted by the allocation functions of allocationcounter.cpp
+size_t allocationCount();
+
+// Prevents the compiler from discarding benchmarked work
+static volatile size_t sink;
+
+/**
+* Timing of one benchmark. Each timed round gives a mean time per operation, and the round statistics
+* are taken over these round means: they show the spread between rounds, not per-operation latencies.
+*/
+struct BenchmarkResult
+{
+    string name;
+    size_t iterations;
+    size_t rounds;
+    double meanNs;
+    double roundMinNs;
+    double roundMedianNs;
+    double roundP99Ns;
+    double roundMaxNs;
+    double megabytesPerSecond;
+};
+
+static vector<BenchmarkResult> benchmarkResults;
+
+// Only benchmarks whose name contains it run, set with --filter
+static string benchmarkFilter;
+static bool lastBenchmarkRan = false;
+
+/**
+* Runs the function for the given number of iterations after a warm-up, prints the timing and records it
+*
+* The iterations are timed in up to 100 rounds, so clock reads do not weigh on short operations.
+* The percentiles printed are those of the round means, see BenchmarkResult.
+*/
+template <class Function>
+void runBenchmark(const char* name, size_t iterations, size_t bytesPerIteration, Function&& function)
+{
+    lastBenchmarkRan = benchmarkFilter.empty() || string(name).find(benchmarkFilter) != string::npos;
+    if (!lastBenchmarkRan)
+        return;
+
+    for (size_t i = 0; i < iterations / 10; ++i)
+        function();
+
+    const size_t roundCount = min<size_t>(iterations, 100);
+    vector<double> roundNs;
+    roundNs.reserve(roundCount);
+    double totalSeconds = 0;
+    for (size_t round = 0; round < roundCount; ++round)
+    {
+        const size_t count = iterations * (round + 1) / roundCount - iterations * round / roundCount;
+        const auto begin = chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i)
+            function();
+        const auto end = chrono::steady_clock::now();
+
+        const double seconds = chrono::duration<double>(end - begin).count();
+        totalSeconds += seconds;
+        roundNs.push_back(seconds * 1e9 / count);
+    }
+    sort(roundNs.begin(), roundNs.end());
+
+    auto percentile = [&](double rank)
+    {
+        return roundNs[static_cast<size_t>(rank * (roundNs.size() - 1) + 0.5)];
+    };
+
+    const BenchmarkResult result{
+        name,
+        iterations,
+        roundCount,
+        totalSeconds * 1e9 / iterations,
+        roundNs.front(),
+        percentile(0.5),
+        percentile(0.99),
+        roundNs.back(),
+        bytesPerIteration * iterations / totalSeconds / 1e6};
+    benchmarkResults.push_back(result);
+
+    printf("%-32s %10.1f ns/op %10.1f MB/s %10.1f round p50 %10.1f round p99\n",
+        name,
+        result.meanNs,
+        result.megabytesPerSecond,
+        result.roundMedianNs,
+        result.roundP99Ns);
+}
+
+/**
+* Prints details under the last benchmark, if it ran
+*/
+template <class... Arguments>
+void printDetails(const char* format, Arguments... arguments)
+{
+    if (lastBenchmarkRan)
+        printf(format, "", arguments...);
+}
+
+/**
+* Writes the recorded results as JSON, compared between commits by bench_compare.py
+*/
+bool writeBenchmarkResults(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (file == nullptr)
+        return false;
+
+    fprintf(file, "{\n  \"benchmarks\": [");
+    for (size_t i = 0; i < benchmarkResults.size(); ++i)
+    {
+        const BenchmarkResult& result = benchmarkResults[i];
+        string name;
+        for (const char c : result.name)
+        {
+            if (c == '"' || c == '\\')
+                name += '\\';
+            name += c;
+        }
+
+        fprintf(file, "%s\n    {\"name\": \"%s\", \"iterations\": %zu, \"rounds\": %zu, \"ns_per_op\": %.2f, "
+            "\"round_min_ns\": %.2f, \"round_p50_ns\": %.2f, \"round_p99_ns\": %.2f, \"round_max_ns\": %.2f, \"mb_per_s\": %.2f}",
+            i > 0 ? "," : "",
+            name.c_str(),
+            result.iterations,
+            result.rounds,
+            result.meanNs,
+            result.roundMinNs,
+            result.roundMedianNs,
+            result.roundP99Ns,
+            result.roundMaxNs,
+            result.megabytesPerSecond);
+    }
+    fprintf(file, "\n  ]\n}\n");
+    return fclose(file) == 0;
+}
+
+/**
+* Parses generated packets holding a single field type, reusing the output
+*/
+template <class OutputType, class ParserType>
+void benchmarkFieldType(const char* name, ParserType parser, GeneratorOptions options = {})
+{
+    vector<unsigned char> packet;
+    makePacketGenerator(parser, options).generate(packet);
+    OutputType output{};
+    runBenchmark(name, 1000000, packet.size(), [&]
+    {
+        resetObject(output);
+        sink = static_cast<size_t>(parser.parse(packet.data(), packet.size(), output));
+    });
+}
+
+#if defined(__linux__)
+/**
+* Sends messages to a loopback UDP socket, one datagram per message then batched with sendmmsg.
+* The receiver is drained after every 32 datagrams and rates count the messages that arrived,
+* so datagrams dropped by a full receive buffer are not reported as sent.
+*/
+template <class WriterType, class InputType>
+void benchmarkLoopback(WriterType writer, const InputType& message, size_t messageCount)
+{
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t addressLength = sizeof(address);
+
+    const int receiver = socket(AF_INET, SOCK_DGRAM, 0);
+    const int sender = socket(AF_INET, SOCK_DGRAM, 0);
+    if (receiver < 0 || sender < 0
+        || bind(receiver, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+        || getsockname(receiver, reinterpret_cast<sockaddr*>(&address), &addressLength) != 0
+        || connect(sender, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        perror("udp loopback setup");
+        if (receiver >= 0)
+            close(receiver);
+        if (sender >= 0)
+            close(sender);
+        return;
+    }
+
+    // Batches start with this header followed by their message count
+    const vector<unsigned char> header = {0, 0, 0, 0};
+    vector<unsigned char> datagram(65536);
+    size_t received = 0;
+    auto drain = [&](bool batched)
+    {
+        ssize_t length;
+        while ((length = recv(receiver, datagram.data(), datagram.size(), MSG_DONTWAIT)) >= 0)
+        {
+            if (!batched)
+                ++received;
+            else if (static_cast<size_t>(length) >= header.size() + sizeof(uint16_t))
+                received += loadUnaligned<uint16_t>(&datagram[header.size()]);
+        }
+    };
+
+    auto report = [&](const char* name, chrono::steady_clock::duration elapsed)
+    {
+        const double seconds = chrono::duration<double>(elapsed).count();
+        printf("%-32s %10.1f ns/msg %10.2f Mmsg/s %6.1f%% received\n",
+            name, seconds * 1e9 / received, received / seconds / 1e6, 100.0 * received / messageCount);
+    };
+
+    // One send per message
+    vector<unsigned char> buffer;
+    auto begin = chrono::steady_clock::now();
+    for (size_t i = 0; i < messageCount; ++i)
+    {
+        writer.write(message, buffer);
+        if (send(sender, buffer.data(), buffer.size(), 0) < 0)
+        {
+            perror("send");
+            break;
+        }
+        if (i % 32 == 31)
+            drain(false);
+    }
+    drain(false);
+    report("udp loopback, send per message", chrono::steady_clock::now() - begin);
+
+    // Coalesced messages sent 32 datagrams at a time
+    auto batcher = makePacketBatcher(writer, header);
+    vector<mmsghdr> messages;
+    received = 0;
+    begin = chrono::steady_clock::now();
+    for (size_t i = 0; i < messageCount; ++i)
+    {
+        batcher.append(message, begin);
+        if (batcher.readyBatches().size() == 32 || i + 1 == messageCount)
+        {
+            batcher.flush();
+            const vector<IoVec>& batches = batcher.readyBatches();
+            messages.assign(batches.size(), mmsghdr{});
+            for (size_t j = 0; j < batches.size(); ++j)
+            {
+                messages[j].msg_hdr.msg_iov = const_cast<IoVec*>(&batches[j]);
+                messages[j].msg_hdr.msg_iovlen = 1;
+            }
+            if (sendmmsg(sender, messages.data(), static_cast<unsigned int>(messages.size()), 0) < 0)
+            {
+                perror("sendmmsg");
+                break;
+            }
+            batcher.releaseBatches();
+            drain(true);
+        }
+    }
+    drain(true);
+    report("udp loopback, batched sendmmsg", chrono::steady_clock::now() - begin);
+
+    close(sender);
+    close(receiver);
+}
+#endif
+
+int main(int argc, char** argv)
+{
+    const char* jsonPath = nullptr;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (string(argv[i]) == "--json")
+            jsonPath = argv[i + 1];
+        else if (string(argv[i]) == "--filter")
+            benchmarkFilter = argv[i + 1];
+    }
+
+    // One field type per packet
+    GeneratorOptions fieldOptions;
+    fieldOptions.textLength = {24, 24};
+    fieldOptions.binaryLength = {256, 256};
+    fieldOptions.arraySize = {64, 64};
+    benchmarkFieldType<FieldPacket>("field value", makePacketParser(
+        VALUE_FIELD(&FieldPacket::setValue, uint32_t)), fieldOptions);
+    benchmarkFieldType<FieldPacket>("field value, endian", makePacketParser(
+        VALUE_FIELD_ENDIAN(&FieldPacket::setWide, uint64_t)), fieldOptions);
+    benchmarkFieldType<FieldPacket>("field text, 24 chars", makePacketParser(
+        TEXT_FIELD(&FieldPacket::setText, 32)), fieldOptions);
+    benchmarkFieldType<FieldPacket>("field binary, 256 bytes", makePacketParser(
+        BINARY_FIELD(uint16_t, &FieldPacket::setPayload)), fieldOptions);
+    benchmarkFieldType<FieldPacket>("field multi", makePacketParser(
+        MULTI_FIELD(Level, &FieldPacket::setLevel,
+            VALUE_FIELD_ENDIAN(&Level::setPrice, uint64_t),
+            VALUE_FIELD_ENDIAN(&Level::setQuantity, uint32_t))), fieldOptions);
+    benchmarkFieldType<FieldPacket>("field dynamic array, 64 values", makePacketParser(
+        DYNAMIC_ARRAY(uint8_t, VALUE_FIELD(&FieldPacket::addValue, uint32_t))), fieldOptions);
+    benchmarkFieldType<FieldPacket>("field static array, 64 values", makePacketParser(
+        STATIC_ARRAY(64, VALUE_FIELD(&FieldPacket::addValue, uint32_t))), fieldOptions);
+
+    // Composite packet
+    auto parser = makePacketParser(
+        WITH_GETTER(TEXT_FIELD(&MyPacket::setName, 16), &MyPacket::name),
+        WITH_GETTER(VALUE_FIELD(&MyPacket::setValue, uint32_t), &MyPacket::value),
+        DYNAMIC_ARRAY(uint8_t,
+            WITH_GETTER(MULTI_FIELD(SubPacket, &MyPacket::addToArray,
+                WITH_GETTER(TEXT_FIELD_ALLOW_EMPTY(&SubPacket::setName, 16), &SubPacket::name),
+                WITH_GETTER(VALUE_FIELD_ENDIAN(&SubPacket::setValue, uint32_t), &SubPacket::value)
+            ), &MyPacket::array)
+        )
+    );
+    auto writer = makePacketWriter(parser);
+
+    MyPacket input{"Alexandre Dumas", 257, {{"", 1}, {"Aramis", 2}, {"Athos", 3}, {"Porthos", 4}}};
+    vector<unsigned char> buffer;
+    writer.write(input, buffer);
+    const size_t packetSize = buffer.size();
+    const size_t iterations = 1000000;
+
+    runBenchmark("write", iterations, packetSize, [&]
+    {
+        writer.write(input, buffer);
+        sink = buffer.size();
+    });
+
+    runBenchmark("parse", iterations, packetSize, [&]
+    {
+        MyPacket output{};
+        parser.parse(buffer.data(), buffer.size(), output);
+        sink = output.array.size();
+    });
+
+    auto instrumentedParser = makeBasicPacketParser<FieldInstrumentation>(
+        TEXT_FIELD(&MyPacket::setName, 16),
+        VALUE_FIELD(&MyPacket::setValue, uint32_t),
+        DYNAMIC_ARRAY(uint8_t,
+            MULTI_FIELD(SubPacket, &MyPacket::addToArray,
+                TEXT_FIELD_ALLOW_EMPTY(&SubPacket::setName, 16),
+                VALUE_FIELD_ENDIAN(&SubPacket::setValue, uint32_t))));
+
+    runBenchmark("parse, field instrumentation", iterations, packetSize, [&]
+    {
+        MyPacket output{};
+        instrumentedParser.parse(buffer.data(), buffer.size(), output);
+        sink = output.array.size();
+    });
+
+    const FieldProfile profile = snapshotFieldProfile(instrumentedParser);
+    for (size_t i = 0; i < profile.counters.size() && profile.counters[0].count > 0; ++i)
+    {
+        printDetails("%-32s %-8s %10.1f cycles/parse %8.1f bytes/parse\n",
+            profile.paths[i].c_str(),
+            static_cast<double>(profile.counters[i].cycles) / profile.counters[0].count,
+            static_cast<double>(profile.counters[i].bytes) / profile.counters[0].count);
+    }
+
+    ParserStats stats;
+    runBenchmark("parse, outcome stats", iterations, packetSize, [&]
+    {
+        MyPacket output{};
+        parseCounted(parser, stats, buffer.data(), buffer.size(), output);
+        sink = output.array.size();
+    });
+
+    LatencyRecorder latencies;
+    runBenchmark("parse, latency histogram", iterations, packetSize, [&]
+    {
+        MyPacket output{};
+        parseTimed(parser, latencies, buffer.data(), buffer.size(), output);
+        sink = output.array.size();
+    });
+
+    const LatencySnapshot latency = latencies.snapshot();
+    printDetails("%-32s p50 %.0f ns p99 %.0f ns p99.9 %.0f ns max %.0f ns, invariant TSC: %s\n",
+        latency.percentile(50),
+        latency.percentile(99),
+        latency.percentile(99.9),
+        latency.max(),
+        TscClock::invariant() ? "yes" : "no");
+
+    // A sample costs two clock reads and a record, clock reads being much slower under virtualization
+    LatencyRecorder samples;
+    uint64_t sampleTicks = 0;
+    runBenchmark("latency record", iterations * 10, 0, [&]
+    {
+        samples.record(++sampleTicks & 1023);
+    });
+
+    runBenchmark("latency clock read", iterations * 10, 0, [&]
+    {
+        sink = static_cast<size_t>(TscClock::now());
+    });
+
+    runBenchmark("write + parse round trip", iterations, packetSize, [&]
+    {
+        writer.write(input, buffer);
+        MyPacket output{};
+        parser.parse(buffer.data(), buffer.size(), output);
+        sink = output.array.size();
+    });
+
+    // Fresh outputs against pooled outputs
+    auto pooledParser = makePacketParser(
+        TEXT_FIELD(&PooledPacket::setName, 16),
+        VALUE_FIELD(&PooledPacket::setValue, uint32_t),
+        DYNAMIC_ARRAY(uint8_t,
+            MULTI_FIELD(SubPacket, &PooledPacket::addToArray,
+                TEXT_FIELD_ALLOW_EMPTY(&SubPacket::setName, 16),
+                VALUE_FIELD_ENDIAN(&SubPacket::setValue, uint32_t))));
+    ObjectPool<PooledPacket> pool(16);
+    size_t allocationsBefore = allocationCount();
+
+    runBenchmark("parse, fresh output", iterations, packetSize, [&]
+    {
+        PooledPacket output{};
+        pooledParser.parse(buffer.data(), buffer.size(), output);
+        sink = output.array.size();
+    });
+    printDetails("%-32s %10.2f allocations/op\n", static_cast<double>(allocationCount() - allocationsBefore) / (iterations * 11 / 10));
+
+    allocationsBefore = allocationCount();
+    runBenchmark("parsePooled", iterations, packetSize, [&]
+    {
+        PacketParserErrorId error;
+        auto output = parsePooled(pooledParser, pool, buffer.data(), buffer.size(), error);
+        sink = output->array.size();
+    });
+    printDetails("%-32s %10.2f allocations/op\n", static_cast<double>(allocationCount() - allocationsBefore) / (iterations * 11 / 10));
+
+    // Protocol version conversion
+    auto subPacket = WITH_GETTER(MULTI_FIELD(SubPacket, &VersionedPacket::addToArray,
+        WITH_GETTER(TEXT_FIELD_ALLOW_EMPTY(&SubPacket::setName, 16), &SubPacket::name),
+        WITH_GETTER(VALUE_FIELD_ENDIAN(&SubPacket::setValue, uint32_t), &SubPacket::value)
+    ), &VersionedPacket::array);
+
+    auto version1 = makePacketParser(
+        WITH_GETTER(TEXT_FIELD(&VersionedPacket::setName, 16), &VersionedPacket::name),
+        WITH_GETTER(VALUE_FIELD(&VersionedPacket::setShortValue, uint16_t), &VersionedPacket::value),
+        WITH_GETTER(VALUE_FIELD_ENDIAN(&VersionedPacket::setTimestamp, uint64_t), &VersionedPacket::timestamp),
+        DYNAMIC_ARRAY(uint8_t, subPacket));
+
+    auto version2 = makePacketParser(
+        WITH_GETTER(VALUE_FIELD(&VersionedPacket::setTimestamp, uint64_t), &VersionedPacket::timestamp),
+        WITH_GETTER(VALUE_FIELD(&VersionedPacket::setValue, uint32_t), &VersionedPacket::value),
+        WITH_GETTER(TEXT_FIELD(&VersionedPacket::setName, 16), &VersionedPacket::name),
+        DYNAMIC_ARRAY(uint16_t, subPacket));
+
+    auto version2Writer = makePacketWriter(version2);
+    auto transcoder = makePacketTranscoder<2, 1, 0, 3>(version1, version2);
+
+    VersionedPacket versioned{"Dumas", 1844, 1234567890, {{"Aramis", 2}, {"Athos", 3}, {"Porthos", 4}, {"D'Artagnan", 5}}};
+    vector<unsigned char> source;
+    vector<unsigned char> target;
+    makePacketWriter(version1).write(versioned, source);
+
+    runBenchmark("parse v1 + write v2", iterations, source.size(), [&]
+    {
+        VersionedPacket output{};
+        version1.parse(source.data(), source.size(), output);
+        version2Writer.write(output, target);
+        sink = target.size();
+    });
+
+    runBenchmark("transcode v1 to v2", iterations, source.size(), [&]
+    {
+        transcoder.transcode(source.data(), source.size(), target);
+        sink = target.size();
+    });
+
+    // Corpus generation
+    vector<unsigned char> corpus;
+    vector<Frame> frames;
+    auto generator = makePacketGenerator(parser);
+    generator.generateCorpus(100000, corpus, frames);
+    runBenchmark("generate corpus, 100k packets", 20, corpus.size(), [&]
+    {
+        generator.generateCorpus(100000, corpus, frames);
+        sink = corpus.size();
+    });
+
+    GeneratorOptions binaryOptions;
+    binaryOptions.binaryLength = {256, 4096};
+    auto binaryGenerator = makePacketGenerator(makePacketParser(
+        VALUE_FIELD(&BlobPacket::setValue, uint32_t),
+        BINARY_FIELD(uint16_t, &BlobPacket::setPayload)), binaryOptions);
+    binaryGenerator.generateCorpus(10000, corpus, frames);
+    runBenchmark("generate corpus, 10k payloads", 20, corpus.size(), [&]
+    {
+        binaryGenerator.generateCorpus(10000, corpus, frames);
+        sink = corpus.size();
+    });
+
+    // Batch parsing, frames shuffled over a corpus larger than the caches
+    vector<unsigned char> largeCorpus;
+    vector<Frame> shuffledFrames;
+    generator.generateCorpus(1000000, largeCorpus, shuffledFrames);
+    FastRandom random(1);
+    for (size_t i = shuffledFrames.size() - 1; i > 0; --i)
+        swap(shuffledFrames[i], shuffledFrames[random.nextInRange(0, i)]);
+
+    const size_t batchSize = 256;
+    const size_t batchCount = shuffledFrames.size() / batchSize;
+    const size_t bytesPerBatch = largeCorpus.size() / batchCount;
+    vector<MyPacket> outputs(batchSize);
+    vector<ParseResult> results(batchSize);
+    size_t batch = 0;
+
+    runBenchmark("parse per packet, 256 frames", batchCount, bytesPerBatch, [&]
+    {
+        const Frame* batchFrames = &shuffledFrames[(batch++ % batchCount) * batchSize];
+        size_t parsed = 0;
+        for (size_t i = 0; i < batchSize; ++i)
+        {
+            outputs[i].array.clear();
+            parsed += parser.parse(batchFrames[i].data, batchFrames[i].length, outputs[i]) == PacketParserErrorId::NoError ? 1 : 0;
+        }
+        sink = parsed;
+    });
+
+    runBenchmark("parseBatch, 256 frames", batchCount, bytesPerBatch, [&]
+    {
+        const Frame* batchFrames = &shuffledFrames[(batch++ % batchCount) * batchSize];
+        for (MyPacket& output : outputs)
+            output.array.clear();
+        sink = parser.parseBatch(Span<const Frame>(batchFrames, batchSize), Span<MyPacket>(outputs), Span<ParseResult>(results));
+    });
+
+    // Rows against columns, prices summed afterwards as an analytics job would
+    auto tradeParser = makePacketParser(
+        VALUE_FIELD_ENDIAN(&Trade::setId, uint32_t),
+        TEXT_FIELD(&Trade::setVenue, 8),
+        VALUE_FIELD_ENDIAN(&Trade::setPrice, uint64_t),
+        DYNAMIC_ARRAY(uint8_t, VALUE_FIELD_ENDIAN(&Trade::addSize, uint16_t)));
+    GeneratorOptions tradeOptions;
+    tradeOptions.textLength = {4, 7};
+    tradeOptions.arraySize = {0, 10};
+    vector<unsigned char> tradeCorpus;
+    vector<Frame> tradeFrames;
+    makePacketGenerator(tradeParser, tradeOptions).generateCorpus(batchSize * 1000, tradeCorpus, tradeFrames);
+    const size_t tradeBatchCount = tradeFrames.size() / batchSize;
+    const size_t tradeBytesPerBatch = tradeCorpus.size() / tradeBatchCount;
+    vector<Trade> trades(batchSize);
+
+    runBenchmark("trade rows, 256 frames", tradeBatchCount, tradeBytesPerBatch, [&]
+    {
+        const Frame* batchFrames = &tradeFrames[(batch++ % tradeBatchCount) * batchSize];
+        for (Trade& trade : trades)
+            trade.sizes.clear();
+        tradeParser.parseBatch(Span<const Frame>(batchFrames, batchSize), Span<Trade>(trades), Span<ParseResult>(results));
+        uint64_t total = 0;
+        for (const Trade& trade : trades)
+            total += trade.price;
+        sink = static_cast<size_t>(total);
+    });
+
+    auto tradeColumns = makeColumnBatch(tradeParser);
+    runBenchmark("trade columns, 256 frames", tradeBatchCount, tradeBytesPerBatch, [&]
+    {
+        const Frame* batchFrames = &tradeFrames[(batch++ % tradeBatchCount) * batchSize];
+        tradeColumns.clear();
+        parseColumns(tradeParser, Span<const Frame>(batchFrames, batchSize), tradeColumns, Span<ParseResult>(results));
+        uint64_t total = 0;
+        for (const uint64_t price : tradeColumns.column<2>().values)
+            total += price;
+        sink = static_cast<size_t>(total);
+    });
+
+    // Orders drawing their symbol among 500 and their venue among 10, copied to strings then interned
+    vector<unsigned char> orderCorpus;
+    vector<size_t> orderOffsets;
+    FastRandom orderRandom(7);
+    for (size_t i = 0; i < batchSize * 1000; ++i)
+    {
+        orderOffsets.push_back(orderCorpus.size());
+        const string symbol = "SYMBOL" + to_string(orderRandom.nextInRange(0, 499));
+        const string venue = "VENUE" + to_string(orderRandom.nextInRange(0, 9));
+        orderCorpus.insert(orderCorpus.end(), symbol.c_str(), symbol.c_str() + symbol.size() + 1);
+        orderCorpus.insert(orderCorpus.end(), venue.c_str(), venue.c_str() + venue.size() + 1);
+        orderCorpus.insert(orderCorpus.end(), 4, static_cast<unsigned char>(i));
+    }
+    orderOffsets.push_back(orderCorpus.size());
+    vector<Frame> orderFrames;
+    for (size_t i = 0; i + 1 < orderOffsets.size(); ++i)
+        orderFrames.push_back({orderCorpus.data() + orderOffsets[i], orderOffsets[i + 1] - orderOffsets[i]});
+    const size_t orderBatchCount = orderFrames.size() / batchSize;
+    const size_t orderBytesPerBatch = orderCorpus.size() / orderBatchCount;
+
+    auto namedOrderParser = makePacketParser(
+        TEXT_FIELD(&NamedOrder::setSymbol, 16),
+        TEXT_FIELD(&NamedOrder::setVenue, 16),
+        VALUE_FIELD(&NamedOrder::setQuantity, uint32_t));
+    vector<NamedOrder> namedOrders(batchSize);
+    runBenchmark("orders, string symbols", orderBatchCount, orderBytesPerBatch, [&]
+    {
+        const Frame* batchFrames = &orderFrames[(batch++ % orderBatchCount) * batchSize];
+        sink = namedOrderParser.parseBatch(Span<const Frame>(batchFrames, batchSize), Span<NamedOrder>(namedOrders), Span<ParseResult>(results));
+    });
+
+    StringInterner orderInterner;
+    auto internedOrderParser = makePacketParser(
+        INTERNED_TEXT(TEXT_FIELD(&InternedOrder::setSymbol, 16), orderInterner),
+        INTERNED_TEXT(TEXT_FIELD(&InternedOrder::setVenue, 16), orderInterner),
+        VALUE_FIELD(&InternedOrder::setQuantity, uint32_t));
+    vector<InternedOrder> internedOrders(batchSize);
+    runBenchmark("orders, interned symbols", orderBatchCount, orderBytesPerBatch, [&]
+    {
+        const Frame* batchFrames = &orderFrames[(batch++ % orderBatchCount) * batchSize];
+        sink = internedOrderParser.parseBatch(Span<const Frame>(batchFrames, batchSize), Span<InternedOrder>(internedOrders), Span<ParseResult>(results));
+    });
+    printDetails("%-32s interner %zu texts %zu bytes\n", orderInterner.size(), orderInterner.memoryUsage());
+
+    // Parallel parsing scaling, over the shuffled corpus
+    vector<MyPacket> parallelOutputs(shuffledFrames.size());
+    vector<ParseResult> parallelResults(shuffledFrames.size());
+    for (size_t threadCount = 1; threadCount <= 64; threadCount *= 2)
+    {
+        ParallelOptions parallelOptions;
+        parallelOptions.threadCount = threadCount;
+        auto parallelParser = makeParallelParser(parser, parallelOptions);
+        const string name = "parallel parse, " + to_string(threadCount) + " threads";
+        runBenchmark(name.c_str(), 5, largeCorpus.size(), [&]
+        {
+            for (MyPacket& output : parallelOutputs)
+                output.array.clear();
+            sink = parallelParser.parse(Span<const Frame>(shuffledFrames), Span<MyPacket>(parallelOutputs), Span<ParseResult>(parallelResults));
+        });
+    }
+
+    // Pipeline, datagrams from memory
+    const Span<const Frame> pipelineFrames(shuffledFrames.data(), 100000);
+    for (const PipelineMode mode : {PipelineMode::ThreadPerStage, PipelineMode::RunToCompletion})
+    {
+        PipelineOptions pipelineOptions;
+        pipelineOptions.mode = mode;
+        pipelineOptions.maxChunkSize = 2048;
+        size_t pipelineBytes = 0;
+        for (const Frame& frame : pipelineFrames)
+            pipelineBytes += frame.length;
+
+        StageMetrics dispatchMetrics{};
+        const char* name = mode == PipelineMode::ThreadPerStage ? "pipeline thread per stage" : "pipeline run to completion";
+        runBenchmark(name, 5, pipelineBytes, [&]
+        {
+            auto pipeline = makePipeline<MyPacket>(parser, MemorySource(pipelineFrames), DatagramFramer(), [](MyPacket& output, const ParseResult&)
+            {
+                sink = output.value;
+            }, pipelineOptions);
+            pipeline.start();
+            pipeline.wait();
+            dispatchMetrics = pipeline.metrics(PipelineStage::Dispatch);
+        });
+        printDetails("%-32s %10.1f ns mean latency %8.1f us max\n",
+            static_cast<double>(dispatchMetrics.totalLatency) / dispatchMetrics.processed,
+            dispatchMetrics.maxLatency / 1e3);
+    }
+
+    // Single snapshot with a huge array, serial then in parallel
+    auto snapshotParser = makePacketParser(
+        DYNAMIC_ARRAY(uint32_t,
+            MULTI_FIELD(Level, &Snapshot::addLevel,
+                VALUE_FIELD_ENDIAN(&Level::setPrice, uint64_t),
+                VALUE_FIELD_ENDIAN(&Level::setQuantity, uint32_t))));
+    GeneratorOptions snapshotOptions;
+    snapshotOptions.arraySize = {2000000, 2000000};
+    vector<unsigned char> snapshotPacket;
+    makePacketGenerator(snapshotParser, snapshotOptions).generate(snapshotPacket);
+    Snapshot snapshot;
+    snapshot.levels.reserve(2000000);
+
+    runBenchmark("snapshot 2M levels, serial", 20, snapshotPacket.size(), [&]
+    {
+        snapshot.levels.clear();
+        snapshotParser.parse(snapshotPacket.data(), snapshotPacket.size(), snapshot);
+        sink = snapshot.levels.size();
+    });
+
+    // Same snapshot with its records transposed into one column per member
+    auto snapshotColumns = makeColumnBatch(snapshotParser);
+    const Frame snapshotFrame{snapshotPacket.data(), snapshotPacket.size()};
+    ParseResult snapshotResult;
+    runBenchmark("snapshot 2M levels, columns", 20, snapshotPacket.size(), [&]
+    {
+        snapshotColumns.clear();
+        parseColumns(snapshotParser, Span<const Frame>(&snapshotFrame, 1), snapshotColumns, Span<ParseResult>(&snapshotResult, 1));
+        sink = std::get<0>(snapshotColumns.column<0>().members).size();
+    });
+
+    for (size_t threadCount = 1;threadCount <= 16; threadCount *= 2)
+    {
+        WorkStealingPool pool(threadCount);
+        auto parallelSnapshotParser = snapshotParser;
+        parallelSnapshotParser.setArrayExecutor(makeArrayExecutor(pool));
+        const string name = "snapshot 2M levels, " + to_string(threadCount) + " threads";
+        runBenchmark(name.c_str(), 20, snapshotPacket.size(), [&]
+        {
+            snapshot.levels.clear();
+            parallelSnapshotParser.parse(snapshotPacket.data(), snapshotPacket.size(), snapshot);
+            sink = snapshot.levels.size();
+        });
+    }
+
+    // Single packet with 100k records of variable size, serial then scanned and decoded in parallel
+    auto recordsField = DYNAMIC_ARRAY(uint32_t,
+        MULTI_FIELD(Record, &RecordBatch::addRecord,
+            TEXT_FIELD_ALLOW_EMPTY(&Record::setName, 64),
+            VALUE_FIELD_ENDIAN(&Record::setValue, uint32_t),
+            BINARY_FIELD(uint8_t, &Record::setPayload)));
+    auto recordsParser = makePacketParser(recordsField);
+    GeneratorOptions recordsOptions;
+    recordsOptions.arraySize = {100000, 100000};
+    recordsOptions.textLength = {0, 63, SizeDistribution::Shape::Skewed};
+    recordsOptions.binaryLength = {0, 200, SizeDistribution::Shape::Skewed};
+    vector<unsigned char> recordsPacket;
+    makePacketGenerator(recordsParser, recordsOptions).generate(recordsPacket);
+    RecordBatch recordBatch;
+
+    runBenchmark("100k records, boundary scan", 100, recordsPacket.size(), [&]
+    {
+        size_t offset = 0;
+        PacketParserErrorId error = PacketParserErrorId::NoError;
+        FieldScanner::scanField(recordsField, recordsPacket.data(), recordsPacket.size(), offset, error);
+        sink = offset;
+    });
+
+    runBenchmark("100k records, serial", 20, recordsPacket.size(), [&]
+    {
+        recordBatch.records.clear();
+        recordsParser.parse(recordsPacket.data(), recordsPacket.size(), recordBatch);
+        sink = recordBatch.records.size();
+    });
+
+    for (size_t threadCount = 1; threadCount <= 8; threadCount *= 2)
+    {
+        WorkStealingPool pool(threadCount);
+        auto parallelRecordsParser = recordsParser;
+        parallelRecordsParser.setArrayExecutor(makeArrayExecutor(pool));
+        const string name = "100k records, " + to_string(threadCount) + " threads";
+        runBenchmark(name.c_str(), 20, recordsPacket.size(), [&]
+        {
+            recordBatch.records.clear();
+            parallelRecordsParser.parse(recordsPacket.data(), recordsPacket.size(), recordBatch);
+            sink = recordBatch.records.size();
+        });
+    }
+
+    // Sharded parsing, uniform then skewed instruments
+    auto quoteParser = makePacketParser(
+        VALUE_FIELD(&Quote::setInstrument, uint16_t),
+        VALUE_FIELD_ENDIAN(&Quote::setSequence, uint32_t));
+    const size_t quoteCount = 1000000;
+    vector<unsigned char> quotes(quoteCount * 6);
+    vector<Frame> quoteFrames(quoteCount);
+    for (const bool skewed : {false, true})
+    {
+        for (size_t i = 0; i < quoteCount; ++i)
+        {
+            const double unit = random.nextUnit();
+            storeUnaligned(&quotes[i * 6], static_cast<uint16_t>(1000 * (skewed ? unit * unit * unit : unit)));
+            storeUnaligned(&quotes[i * 6 + 2], static_cast<uint32_t>(i));
+            quoteFrames[i] = {&quotes[i * 6], 6};
+        }
+
+        for (size_t shardCount = 1; shardCount <= 8; shardCount *= 2)
+        {
+            ShardingOptions shardingOptions;
+            shardingOptions.shardCount = shardCount;
+            auto sharded = makeShardedParser<0, Quote>(quoteParser, [](size_t, Quote& quote, const ParseResult&)
+            {
+                sink = quote.sequence;
+            }, shardingOptions);
+
+            const string name = string(skewed ? "sharded skewed, " : "sharded uniform, ") + to_string(shardCount) + " shards";
+            runBenchmark(name.c_str(), 3, quotes.size(), [&]
+            {
+                for (const Frame& frame : quoteFrames)
+                    sharded.dispatch(frame);
+                sharded.drain();
+            });
+
+            size_t stalls = 0;
+            for (const ShardStats& shard : sharded.stats())
+                stalls += shard.stalls;
+            printDetails("%-32s %10.2f imbalance %8zu stalls\n", sharded.imbalance(), stalls);
+        }
+    }
+
+    // Fixed-size messages decoded in lanes
+    auto tickParser = makePacketParser(
+        VALUE_FIELD_ENDIAN(&Tick::setTimestamp, uint64_t),
+        VALUE_FIELD_ENDIAN(&Tick::setPrice, uint32_t),
+        VALUE_FIELD_ENDIAN(&Tick::setQuantity, uint16_t),
+        VALUE_FIELD(&Tick::setSide, uint8_t));
+    vector<unsigned char> ticks;
+    vector<Frame> tickFrames;
+    makePacketGenerator(tickParser).generateCorpus(batchSize * 64, ticks, tickFrames);
+    vector<Tick> tickOutputs(batchSize);
+    const size_t tickBytesPerBatch = ticks.size() / 64;
+
+    // Reached through a volatile pointer, so the setters are not resolved at compile time as for a long-lived parser
+    decltype(tickParser)* volatile opaqueTickParser = &tickParser;
+
+    runBenchmark("parse per tick, 256 frames", 100000, tickBytesPerBatch, [&]
+    {
+        const Frame* batchFrames = &tickFrames[(batch++ % 64) * batchSize];
+        size_t parsed = 0;
+        for (size_t i = 0; i < batchSize; ++i)
+            parsed += opaqueTickParser->parse(batchFrames[i].data, batchFrames[i].length, tickOutputs[i]) == PacketParserErrorId::NoError ? 1 : 0;
+        sink = parsed;
+    });
+
+    runBenchmark("parseFixedBatch, 256 frames", 100000, tickBytesPerBatch, [&]
+    {
+        const Frame* batchFrames = &tickFrames[(batch++ % 64) * batchSize];
+        sink = opaqueTickParser->parseFixedBatch(Span<const Frame>(batchFrames, batchSize), Span<Tick>(tickOutputs), Span<ParseResult>(results));
+    });
+
+    vector<uint64_t> timestamps(batchSize);
+    vector<uint32_t> prices(batchSize);
+    vector<uint16_t> quantities(batchSize);
+    vector<uint8_t> sides(batchSize);
+
+    runBenchmark("gatherField columns, 256 frames", 100000, tickBytesPerBatch, [&]
+    {
+        const Span<const Frame> batchFrames(&tickFrames[(batch++ % 64) * batchSize], batchSize);
+        tickParser.gatherField<0>(batchFrames, timestamps.data());
+        tickParser.gatherField<1>(batchFrames, prices.data());
+        tickParser.gatherField<2>(batchFrames, quantities.data());
+        tickParser.gatherField<3>(batchFrames, sides.data());
+        sink = timestamps[0] + prices[0];
+    });
+
+#if defined(__linux__)
+    // Datagram coalescing
+    auto messageWriter = makePacketWriter(
+        WITH_GETTER(TEXT_FIELD_ALLOW_EMPTY(&SubPacket::setName, 16), &SubPacket::name),
+        WITH_GETTER(VALUE_FIELD_ENDIAN(&SubPacket::setValue, uint32_t), &SubPacket::value));
+    if (benchmarkFilter.empty())
+        benchmarkLoopback(messageWriter, SubPacket{"Porthos", 4}, iterations);
+#endif
+
+    if (jsonPath != nullptr && !writeBenchmarkResults(jsonPath))
+    {
+        fprintf(stderr, "Cannot write %s\n", jsonPath);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+"""Compares two JSON files written by `bench --json` and flags the benchmarks that slowed down.
+
+Usage: bench_compare.py baseline.json current.json [--threshold PERCENT] [--metric ns_per_op|round_p50_ns|round_p99_ns]
+
+round_p50_ns and round_p99_ns are percentiles of the mean time per operation of each timed round,
+not of single operations.
+
+Exits with 1 when a benchmark is slower than the baseline by more than the threshold.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as file:
+        return {benchmark["name"]: benchmark for benchmark in json.load(file)["benchmarks"]}
+
+
+def main():
+    arguments = argparse.ArgumentParser(description="Flags benchmark slowdowns between two bench --json results")
+    arguments.add_argument("baseline")
+    arguments.add_argument("current")
+    arguments.add_argument("--threshold", type=float, default=5.0, help="slowdown in percent flagged as a regression")
+    arguments.add_argument("--metric", default="ns_per_op", choices=["ns_per_op", "round_p50_ns", "round_p99_ns"])
+    options = arguments.parse_args()
+
+    baseline = load(options.baseline)
+    current = load(options.current)
+
+    regressions = 0
+    print(f"{'benchmark':<32} {'baseline':>12} {'current':>12} {'change':>9}")
+    for name, result in current.items():
+        if name not in baseline:
+            print(f"{name:<32} {'':>12} {result[options.metric]:>12.1f} {'new':>9}")
+            continue
+
+        before = baseline[name][options.metric]
+        after = result[options.metric]
+        change = (after - before) / before * 100 if before > 0 else 0.0
+        slower = change > options.threshold
+        regressions += slower
+        print(f"{name:<32} {before:>12.1f} {after:>12.1f} {change:>+8.1f}%{'  SLOWER' if slower else ''}")
+
+    for name in baseline:
+        if name not in current:
+            print(f"{name:<32} {baseline[name][options.metric]:>12.1f} {'':>12} {'missing':>9}")
+
+    if regressions:
+        print(f"{regressions} benchmark(s) slower by more than {options.threshold}%")
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,681 @@
+#pragma once
+
+#include "genericpacketparser.h"
+
+#include <cstring>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace GenericPacketParser
+{
+
+// =============================================================================
+// Validity bitmaps
+// =============================================================================
+
+/**
+* Bitmap with one bit per row, least significant bit first as in Apache Arrow
+*/
+class ValidityBitmap
+{
+public:
+    bool operator[](size_t row) const
+    {
+        return (_bytes[row / 8] >> (row % 8)) & 1;
+    }
+
+    /**
+    * Sets the bit of a row, rows being appended in order
+    */
+    void set(size_t row, bool valid)
+    {
+        if (row / 8 >= _bytes.size())
+            _bytes.push_back(0);
+
+        const uint8_t bit = static_cast<uint8_t>(1 << (row % 8));
+        _bytes[row / 8] = valid ? (_bytes[row / 8] | bit) : (_bytes[row / 8] & ~bit);
+    }
+
+    const uint8_t* data() const
+    {
+        return _bytes.data();
+    }
+
+    void clear()
+    {
+        _bytes.clear();
+    }
+
+    void reserve(size_t rows)
+    {
+        _bytes.reserve((rows + 7) / 8);
+    }
+
+private:
+    std::vector<uint8_t> _bytes;
+};
+
+// =============================================================================
+// Columns
+// =============================================================================
+
+/**
+* Column of the values of a value field, in host order
+*
+* @tparam T Value type of the field
+*/
+template <class T>
+struct ValueColumn
+{
+    using ValueType = T;
+
+    // One value per row, 0 for null rows
+    std::vector<T> values;
+    ValidityBitmap validity;
+
+    size_t size() const
+    {
+        return values.size();
+    }
+
+    bool valid(size_t row) const
+    {
+        return validity[row];
+    }
+
+    T operator[](size_t row) const
+    {
+        return values[row];
+    }
+
+    void clear()
+    {
+        values.clear();
+        validity.clear();
+    }
+
+    void reserve(size_t rows)
+    {
+        values.reserve(rows);
+        validity.reserve(rows);
+    }
+};
+
+/**
+* Column of the bytes of a text or binary field: row i spans data[offsets[i]] to data[offsets[i + 1]]
+*
+* @tparam Byte char for text, without terminator, or unsigned char for binary data
+*/
+template <class Byte>
+struct VariableColumn
+{
+    std::vector<uint32_t> offsets{0};
+    std::vector<Byte> data;
+    ValidityBitmap validity;
+
+    size_t size() const
+    {
+        return offsets.size() - 1;
+    }
+
+    bool valid(size_t row) const
+    {
+        return validity[row];
+    }
+
+    std::basic_string_view<Byte> operator[](size_t row) const
+    {
+        return {data.data() + offsets[row], offsets[row + 1] - offsets[row]};
+    }
+
+    void clear()
+    {
+        offsets.assign(1, 0);
+        data.clear();
+        validity.clear();
+    }
+
+    void reserve(size_t rows)
+    {
+        offsets.reserve(rows + 1);
+        validity.reserve(rows);
+    }
+};
+
+using TextColumn = VariableColumn<char>;
+using BinaryColumn = VariableColumn<unsigned char>;
+
+/**
+* Column of the elements of an array of value fields: row i spans values[offsets[i]] to values[offsets[i + 1]]
+*
+* @tparam T Value type of the array elements
+*/
+template <class T>
+struct ListColumn
+{
+    using ValueType = T;
+
+    std::vector<uint32_t> offsets{0};
+    std::vector<T> values;
+    ValidityBitmap validity;
+
+    size_t size() const
+    {
+        return offsets.size() - 1;
+    }
+
+    bool valid(size_t row) const
+    {
+        return validity[row];
+    }
+
+    Span<const T> operator[](size_t row) const
+    {
+        return {values.data() + offsets[row], offsets[row + 1] - offsets[row]};
+    }
+
+    void clear()
+    {
+        offsets.assign(1, 0);
+        values.clear();
+        validity.clear();
+    }
+
+    void reserve(size_t rows)
+    {
+        offsets.reserve(rows + 1);
+        validity.reserve(rows);
+    }
+};
+
+/**
+* Column of the records of an array of value records, one array per member: row i spans
+* records offsets[i] to offsets[i + 1] of every member array
+*
+* @tparam T Value types of the record members
+*/
+template <class... T>
+struct RecordListColumn
+{
+    std::vector<uint32_t> offsets{0};
+    std::tuple<std::vector<T>...> members;
+    ValidityBitmap validity;
+
+    size_t size() const
+    {
+        return offsets.size() - 1;
+    }
+
+    bool valid(size_t row) const
+    {
+        return validity[row];
+    }
+
+    /**
+    * @return Values of member MemberIndex of the records of a row
+    */
+    template <size_t MemberIndex>
+    auto member(size_t row) const
+    {
+        using ValueType = std::tuple_element_t<MemberIndex, std::tuple<T...>>;
+        return Span<const ValueType>(std::get<MemberIndex>(members).data() + offsets[row], offsets[row + 1] - offsets[row]);
+    }
+
+    void clear()
+    {
+        offsets.assign(1, 0);
+        std::apply([](auto&... values) { (values.clear(), ...); }, members);
+        validity.clear();
+    }
+
+    void reserve(size_t rows)
+    {
+        offsets.reserve(rows + 1);
+        validity.reserve(rows);
+    }
+};
+
+template <class Tuple>
+struct RecordListColumnOf;
+
+template <class... Fields>
+struct RecordListColumnOf<std::tuple<Fields...>>
+{
+    using Type = RecordListColumn<typename Fields::ValueType...>;
+};
+
+/**
+* Metafunction giving the column type of a field
+*
+* @note Multi fields and arrays of anything but value fields or value records have no column type
+*/
+template <class FieldType, FieldTypeId TypeId = FieldType::typeId>
+struct ColumnOf
+{
+    static_assert(TypeId != FieldTypeId::MultiField, "Multi fields cannot be decoded to columns");
+};
+
+template <class FieldType>
+struct ColumnOf<FieldType, FieldTypeId::ValueField>
+{
+    using Type = ValueColumn<typename FieldType::ValueType>;
+};
+
+template <class FieldType>
+struct ColumnOf<FieldType, FieldTypeId::TextField>
+{
+    using Type = TextColumn;
+};
+
+template <class FieldType>
+struct ColumnOf<FieldType, FieldTypeId::BinaryField>
+{
+    using Type = BinaryColumn;
+};
+
+template <class ElementFieldType, bool IsRecord = IsValueRecord<ElementFieldType>::value>
+struct ArrayColumnOf
+{
+    static_assert(ElementFieldType::typeId == FieldTypeId::ValueField, "Only arrays of value fields or value records can be decoded to columns");
+    using Type = ListColumn<typename ElementFieldType::ValueType>;
+};
+
+template <class ElementFieldType>
+struct ArrayColumnOf<ElementFieldType, true> : RecordListColumnOf<typename ElementFieldType::FieldsType>
+{
+};
+
+template <class FieldType>
+struct ColumnOf<FieldType, FieldTypeId::DynamicFieldArray> : ArrayColumnOf<typename FieldType::ArrayFieldType>
+{
+};
+
+template <class FieldType>
+struct ColumnOf<FieldType, FieldTypeId::StaticFieldArray> : ColumnOf<FieldType, FieldTypeId::DynamicFieldArray>
+{
+};
+
+// =============================================================================
+// ColumnBatch
+// =============================================================================
+
+/**
+* Struct holding one column per top-level field of a layout, rows being appended by parseColumns
+*
+* @tparam Fields Field types of the layout
+*/
+template <class... Fields>
+struct ColumnBatch
+{
+    std::tuple<typename ColumnOf<Fields>::Type...> columns;
+
+    /**
+    * Number of rows, valid or not
+    */
+    size_t rows = 0;
+
+    /**
+    * @return Column of the top-level field FieldIndex
+    */
+    template <size_t FieldIndex>
+    auto& column()
+    {
+        return std::get<FieldIndex>(columns);
+    }
+
+    template <size_t FieldIndex>
+    const auto& column() const
+    {
+        return std::get<FieldIndex>(columns);
+    }
+
+    /**
+    * Removes all rows, keeping the buffers for the next batch
+    */
+    void clear()
+    {
+        std::apply([](auto&... column) { (column.clear(), ...); }, columns);
+        rows = 0;
+    }
+
+    void reserve(size_t rowCount)
+    {
+        std::apply([&](auto&... column) { (column.reserve(rowCount), ...); }, columns);
+    }
+};
+
+// =============================================================================
+// ColumnDecoder
+// =============================================================================
+
+/**
+* Struct decoding the top-level fields of packets straight into the columns of a batch, without setters
+*/
+struct ColumnDecoder
+{
+    /**
+    * Number of array elements from which they are copied and byte swapped in bulk
+    */
+    static constexpr size_t bulkElementCount = 32;
+
+    /**
+    * Work of a row, charged to the work budget of the parser as parse() charges it
+    */
+    struct RowWork
+    {
+        const WorkBudget& budget;
+        size_t elementCount;
+        size_t setterCallCount;
+
+        /**
+        * Charges the elements of an array and their setter calls
+        *
+        * @return False if the budget is exceeded
+        */
+        template <class ElementFieldType>
+        bool chargeElements(size_t count)
+        {
+            if (count > budget.maxElements - elementCount)
+                return false;
+            elementCount += count;
+
+            constexpr size_t setterCalls = FieldSetterCount<ElementFieldType>::value;
+            if (setterCalls > 0 && count > (budget.maxSetterCalls - setterCallCount) / setterCalls)
+                return false;
+            setterCallCount += count * setterCalls;
+            return true;
+        }
+    };
+
+    /**
+    * Decodes a field at an offset into its column, appending a row
+    *
+    * @return Error of the field, the row is then left to be nulled by the caller
+    */
+    template <class FieldType, class ColumnType>
+    static PacketParserErrorId decode(const FieldType& field, const unsigned char* data, size_t length, size_t& offset,
+        ColumnType& column, RowWork& work)
+    {
+        if constexpr (FieldType::typeId == FieldTypeId::ValueField)
+        {
+            using ValueType = typename FieldType::ValueType;
+            if (sizeof(ValueType) > length - offset)
+                return PacketParserErrorId::ExceededDataRange;
+
+            column.values.push_back(applyEndianness<FieldType>(loadUnaligned<ValueType>(&data[offset])));
+            offset += sizeof(ValueType);
+        }
+        else if constexpr (FieldType::typeId == FieldTypeId::TextField)
+        {
+            const size_t available = length - offset;
+            const void* terminator = std::memchr(&data[offset], 0, field.length < available ? field.length : available);
+            if (terminator == nullptr)
+                return available < field.length ? PacketParserErrorId::ExceededDataRange : PacketParserErrorId::MissingNullTerminator;
+
+            const size_t textLength = static_cast<const unsigned char*>(terminator) - &data[offset];
+            if (!FieldType::allowEmpty && textLength == 0)
+                return PacketParserErrorId::EmptyTextNotAllowed;
+
+            appendBytes(column, &data[offset], textLength);
+            offset += textLength + 1;
+        }
+        else if constexpr (FieldType::typeId == FieldTypeId::BinaryField)
+        {
+            using SizeType = typename FieldType::PayloadSizeType;
+            if (sizeof(SizeType) > length - offset)
+                return PacketParserErrorId::ExceededDataRange;
+
+            const size_t payloadSize = loadUnaligned<SizeType>(&data[offset]);
+            offset += sizeof(SizeType);
+            if (payloadSize > length - offset)
+                return PacketParserErrorId::ExceededDataRange;
+
+            appendBytes(column, &data[offset], payloadSize);
+            offset += payloadSize;
+        }
+        else
+        {
+            size_t count = 0;
+            if constexpr (FieldType::typeId == FieldTypeId::DynamicFieldArray)
+            {
+                using SizeType = typename FieldType::ArraySizeType;
+                if (sizeof(SizeType) > length - offset)
+                    return PacketParserErrorId::ExceededDataRange;
+
+                count = loadUnaligned<SizeType>(&data[offset]);
+                offset += sizeof(SizeType);
+            }
+            else
+            {
+                count = field.size;
+            }
+
+            using ElementFieldType = typename FieldType::ArrayFieldType;
+            if (!work.chargeElements<ElementFieldType>(count))
+                return PacketParserErrorId::WorkBudgetExceeded;
+
+            if constexpr (IsValueRecord<ElementFieldType>::value)
+            {
+                // Records are transposed into the member arrays in a single pass
+                constexpr size_t stride = FieldWireSize<ElementFieldType>::value;
+                if (count > (length - offset) / stride)
+                    return PacketParserErrorId::ExceededDataRange;
+
+                appendRecords<ElementFieldType>(column, &data[offset], count, std::make_index_sequence<ElementFieldType::fieldCount>());
+                offset += count * stride;
+            }
+            else
+            {
+                using ValueType = typename ElementFieldType::ValueType;
+                if (count > (length - offset) / sizeof(ValueType))
+                    return PacketParserErrorId::ExceededDataRange;
+
+                // Elements are contiguous on the wire: long arrays are copied at once then byte swapped in SIMD lanes,
+                // short ones are cheaper to append one by one
+                if (count >= bulkElementCount)
+                {
+                    const size_t first = column.values.size();
+                    column.values.resize(first + count);
+                    std::memcpy(column.values.data() + first, &data[offset], count * sizeof(ValueType));
+                    if constexpr (ElementFieldType::invertEndianness)
+                        swapLanes(column.values.data() + first, count);
+                }
+                else
+                {
+                    for (size_t i = 0; i < count; ++i)
+                        column.values.push_back(applyEndianness<ElementFieldType>(loadUnaligned<ValueType>(&data[offset + i * sizeof(ValueType)])));
+                }
+
+                column.offsets.push_back(static_cast<uint32_t>(column.values.size()));
+                offset += count * sizeof(ValueType);
+            }
+        }
+        return PacketParserErrorId::NoError;
+    }
+
+    /**
+    * Decodes the fields of a packet into a row, or appends a null row to every column if it is invalid
+    *
+    * @param offset Receives the offset reached
+    * @return Error of the first invalid field, or the one the parser rejects the packet with up front
+    */
+    template <class ParserType, class ColumnsTuple, size_t... I>
+    static PacketParserErrorId decodeRow(const ParserType& parser, const Frame& frame,
+        ColumnsTuple& columns, size_t row, size_t& offset, std::index_sequence<I...>)
+    {
+        offset = 0;
+        PacketParserErrorId error = parser.rejectUpFront(frame.length);
+        RowWork work{parser.workBudget(), 0, TupleSetterCount<typename ParserType::FieldsType>::value};
+
+        // Fields are decoded in order, stopping at the first error
+        const size_t rowStarts[] = {rowStart(std::get<I>(columns))..., 0};
+        ((error = error == PacketParserErrorId::NoError
+            ? decode(std::get<I>(parser.fields()), frame.data, frame.length, offset, std::get<I>(columns), work)
+            : error), ...);
+
+        if (error == PacketParserErrorId::NoError)
+            (std::get<I>(columns).validity.set(row, true), ...);
+        else
+            (nullRow(std::get<I>(columns), row, rowStarts[I]), ...);
+        return error;
+    }
+
+    /**
+    * Gathers every value field of frames long enough for the layout into its column
+    */
+    template <class ParserType, class ColumnsTuple, size_t... I>
+    static void gatherRows(Span<const Frame> frames, ColumnsTuple& columns, size_t firstRow, std::index_sequence<I...>)
+    {
+        ((std::get<I>(columns).values.resize(firstRow + frames.size()),
+            ParserType::template gatherField<I>(frames, std::get<I>(columns).values.data() + firstRow)), ...);
+
+        for (size_t i = 0; i < frames.size(); ++i)
+            (std::get<I>(columns).validity.set(firstRow + i, true), ...);
+    }
+
+private:
+    // Invalid rows roll back what they appended and get a null entry
+
+    template <class T>
+    static size_t rowStart(const ValueColumn<T>& column)
+    {
+        return column.values.size();
+    }
+
+    template <class Byte>
+    static size_t rowStart(const VariableColumn<Byte>& column)
+    {
+        return column.data.size();
+    }
+
+    template <class T>
+    static size_t rowStart(const ListColumn<T>& column)
+    {
+        return column.values.size();
+    }
+
+    template <class... T>
+    static size_t rowStart(const RecordListColumn<T...>& column)
+    {
+        return column.offsets.back();
+    }
+
+    template <class T>
+    static void nullRow(ValueColumn<T>& column, size_t row, size_t)
+    {
+        column.values.resize(row);
+        column.values.push_back(0);
+        column.validity.set(row, false);
+    }
+
+    template <class Byte>
+    static void nullRow(VariableColumn<Byte>& column, size_t row, size_t rowStart)
+    {
+        column.data.resize(rowStart);
+        column.offsets.resize(row + 1);
+        column.offsets.push_back(static_cast<uint32_t>(rowStart));
+        column.validity.set(row, false);
+    }
+
+    template <class T>
+    static void nullRow(ListColumn<T>& column, size_t row, size_t rowStart)
+    {
+        column.values.resize(rowStart);
+        column.offsets.resize(row + 1);
+        column.offsets.push_back(static_cast<uint32_t>(rowStart));
+        column.validity.set(row, false);
+    }
+
+    template <class... T>
+    static void nullRow(RecordListColumn<T...>& column, size_t row, size_t rowStart)
+    {
+        std::apply([&](auto&... values) { (values.resize(rowStart), ...); }, column.members);
+        column.offsets.resize(row + 1);
+        column.offsets.push_back(static_cast<uint32_t>(rowStart));
+        column.validity.set(row, false);
+    }
+
+    template <class Byte>
+    static void appendBytes(VariableColumn<Byte>& column, const unsigned char* bytes, size_t length)
+    {
+        const Byte* first = reinterpret_cast<const Byte*>(bytes);
+        column.data.insert(column.data.end(), first, first + length);
+        column.offsets.push_back(static_cast<uint32_t>(column.data.size()));
+    }
+
+    template <class RecordFieldType, class... T, size_t... I>
+    static void appendRecords(RecordListColumn<T...>& column, const unsigned char* records, size_t count, std::index_sequence<I...>)
+    {
+        const size_t first = column.offsets.back();
+        (std::get<I>(column.members).resize(first + count), ...);
+        transposeRecords<RecordFieldType>(records, count, (std::get<I>(column.members).data() + first)...);
+        column.offsets.push_back(static_cast<uint32_t>(first + count));
+    }
+};
+
+// =============================================================================
+// Utilities
+// =============================================================================
+
+/**
+* @return Empty column batch for the layout of a parser
+*/
+template <class Instrumentation, class... Fields>
+ColumnBatch<Fields...> makeColumnBatch(const BasicPacketParser<Instrumentation, Fields...>&)
+{
+    return ColumnBatch<Fields...>();
+}
+
+/**
+* Parses frames into the columns of a batch, one row per frame, without calling any setter.
+* Invalid frames get a null row in every column.
+*
+* @param parser Parser of the layout
+* @param frames Frames to parse
+* @param batch Receives a row per frame, after its current rows
+* @param results Receives the outcome of each frame
+* @return Number of frames parsed without error
+* @note Layouts made only of value fields are decoded column by column with gatherField
+* when every frame is long enough
+*/
+template <class Instrumentation, class... Fields>
+size_t parseColumns(const BasicPacketParser<Instrumentation, Fields...>& parser, Span<const Frame> frames,
+    ColumnBatch<Fields...>& batch, Span<ParseResult> results)
+{
+    using ParserType = BasicPacketParser<Instrumentation, Fields...>;
+    assert(((void)"Each frame needs a result.", results.size() >= frames.size()));
+
+    const size_t firstRow = batch.rows;
+    batch.rows += frames.size();
+
+    if constexpr (ParserType::fixedFieldCount == sizeof...(Fields) && ((Fields::typeId == FieldTypeId::ValueField) && ...))
+    {
+        bool allValid = true;
+        for (const Frame& frame : frames)
+            allValid = allValid && frame.length >= ParserType::fixedPrefixLength
+                && parser.rejectUpFront(frame.length) == PacketParserErrorId::NoError;
+
+        if (allValid)
+        {
+            ColumnDecoder::gatherRows<ParserType>(frames, batch.columns, firstRow, std::make_index_sequence<sizeof...(Fields)>());
+            for (size_t i = 0; i < frames.size(); ++i)
+                results[i] = {PacketParserErrorId::NoError, ParserType::fixedPrefixLength};
+            return frames.size();
+        }
+    }
+
+    size_t parsedCount = 0;
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+        size_t offset = 0;
+        const PacketParserErrorId error = ColumnDecoder::decodeRow(parser, frames[i], batch.columns, firstRow + i, offset,
+            std::make_index_sequence<sizeof...(Fields)>());
+
+        results[i] = {error, offset < frames[i].length ? offset : frames[i].length};
+        parsedCount += error == PacketParserErrorId::NoError ? 1 : 0;
+    }
+    return parsedCount;
+}
+
+} // namespace GenericPacketParser
@@ -0,0 +1,263 @@
+#pragma once
+
+#include "genericpacketparser.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace GenericPacketParser
+{
+
+// =============================================================================
+// Cycle counter
+// =============================================================================
+
+/**
+* @return Time stamp counter on x86, steady clock nanoseconds elsewhere
+*/
+inline uint64_t readCycles()
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// =============================================================================
+// Field counters
+// =============================================================================
+
+/**
+* Struct holding the measures of a field
+*/
+struct FieldCounters
+{
+    // Times the field was parsed
+    uint64_t count;
+
+    // Bytes consumed by the field, nested fields included
+    uint64_t bytes;
+
+    // Cycles spent parsing the field, nested fields included
+    uint64_t cycles;
+};
+
+/**
+* Struct holding the measures of every field of a layout, indexed in depth-first order
+*/
+struct FieldProfile
+{
+    // Path of each field: "2" for the third field, "2.0" for its first subfield, "2[]" for its array element
+    std::vector<std::string> paths;
+
+    std::vector<FieldCounters> counters;
+
+    /**
+    * Adds the measures of another profile of the same layout, e.g. exported by another process
+    */
+    void merge(const FieldProfile& other)
+    {
+        assert(((void)"Only profiles of the same layout can be merged.", other.counters.size() == counters.size()));
+        for (size_t i = 0; i < counters.size(); ++i)
+        {
+            counters[i].count += other.counters[i].count;
+            counters[i].bytes += other.counters[i].bytes;
+            counters[i].cycles += other.counters[i].cycles;
+        }
+    }
+};
+
+/**
+* Per-thread field counters of a parser type.
+*
+* Each thread writes to its own cache-line aligned counters, registered on its first measure and kept
+* after it exits, so measuring never contends. Snapshots add up the counters of every thread.
+*
+* @tparam ParserType Parser type measured, parsers of the same type share their counters
+*/
+template <class ParserType>
+class FieldCounterRegistry
+{
+public:
+    static void record(size_t node, size_t bytes, uint64_t cycles)
+    {
+        Counters& counters = localCounters()[node];
+        add(counters.count, 1);
+        add(counters.bytes, bytes);
+        add(counters.cycles, cycles);
+    }
+
+    /**
+    * @return Sum of the counters of every thread
+    */
+    static std::vector<FieldCounters> snapshot()
+    {
+        std::vector<FieldCounters> total(ParserType::fieldNodeCount, FieldCounters{0, 0, 0});
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        for (const std::unique_ptr<Counters[]>& thread : registry().threads)
+        {
+            for (size_t i = 0; i < total.size(); ++i)
+            {
+                total[i].count += thread[i].count.load(std::memory_order_relaxed);
+                total[i].bytes += thread[i].bytes.load(std::memory_order_relaxed);
+                total[i].cycles += thread[i].cycles.load(std::memory_order_relaxed);
+            }
+        }
+        return total;
+    }
+
+    /**
+    * @note Measures taken while resetting may be lost
+    */
+    static void reset()
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        for (std::unique_ptr<Counters[]>& thread : registry().threads)
+        {
+            for (size_t i = 0; i < ParserType::fieldNodeCount; ++i)
+            {
+                thread[i].count.store(0, std::memory_order_relaxed);
+                thread[i].bytes.store(0, std::memory_order_relaxed);
+                thread[i].cycles.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct alignas(64) Counters
+    {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> cycles{0};
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Counters[]>> threads;
+    };
+
+    static Registry& registry()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    static Counters* localCounters()
+    {
+        thread_local Counters* counters = registerThread();
+        return counters;
+    }
+
+    static Counters* registerThread()
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        registry().threads.emplace_back(new Counters[ParserType::fieldNodeCount]);
+        return registry().threads.back().get();
+    }
+
+    // Only the owning thread writes, so a plain load and store is enough
+    static void add(std::atomic<uint64_t>& counter, uint64_t value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+};
+
+// =============================================================================
+// FieldInstrumentation
+// =============================================================================
+
+/**
+* Instrumentation policy counting the parses, bytes and cycles of every field into per-thread counters.
+*
+* @note Fields decoded by parseFixedBatch and gatherField are not measured
+* @see GenericPacketParser::makeBasicPacketParser
+*/
+struct FieldInstrumentation
+{
+    static constexpr bool enabled = true;
+
+    static uint64_t begin()
+    {
+        return readCycles();
+    }
+
+    template <class ParserType>
+    static void end(size_t node, size_t bytes, uint64_t begin)
+    {
+        FieldCounterRegistry<ParserType>::record(node, bytes, readCycles() - begin);
+    }
+};
+
+// =============================================================================
+// Field paths
+// =============================================================================
+
+template <class FieldType>
+void appendFieldPaths(const std::string& path, std::vector<std::string>& paths);
+
+template <class Tuple, size_t... I>
+void appendTuplePaths(const std::string& prefix, std::vector<std::string>& paths, std::index_sequence<I...>)
+{
+    (appendFieldPaths<std::tuple_element_t<I, Tuple>>(prefix + std::to_string(I), paths), ...);
+}
+
+/**
+* Appends the path of a field then the paths of its subfields and array element, in depth-first order
+*/
+template <class FieldType>
+void appendFieldPaths(const std::string& path, std::vector<std::string>& paths)
+{
+    paths.push_back(path);
+    if constexpr (FieldType::typeId == FieldTypeId::MultiField)
+    {
+        using FieldsType = typename FieldType::FieldsType;
+        appendTuplePaths<FieldsType>(path + ".", paths, std::make_index_sequence<std::tuple_size_v<FieldsType>>());
+    }
+    else if constexpr (FieldType::typeId == FieldTypeId::DynamicFieldArray || FieldType::typeId == FieldTypeId::StaticFieldArray)
+    {
+        appendFieldPaths<typename FieldType::ArrayFieldType>(path + "[]", paths);
+    }
+}
+
+// =============================================================================
+// Utilities
+// =============================================================================
+
+/**
+* @return Measures of every field of the parser type, added up over all threads
+*/
+template <class... Fields>
+FieldProfile snapshotFieldProfile(const BasicPacketParser<FieldInstrumentation, Fields...>&)
+{
+    using ParserType = BasicPacketParser<FieldInstrumentation, Fields...>;
+    using FieldsType = typename ParserType::FieldsType;
+
+    FieldProfile profile;
+    appendTuplePaths<FieldsType>("", profile.paths, std::make_index_sequence<sizeof...(Fields)>());
+    profile.counters = FieldCounterRegistry<ParserType>::snapshot();
+    return profile;
+}
+
+/**
+* Clears the measures of the parser type on all threads
+*/
+template <class... Fields>
+void resetFieldProfile(const BasicPacketParser<FieldInstrumentation, Fields...>&)
+{
+    FieldCounterRegistry<BasicPacketParser<FieldInstrumentation, Fields...>>::reset();
+}
+
+} // namespace GenericPacketParser
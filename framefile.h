@@ -0,0 +1,364 @@
+#pragma once
+
+#include "genericpacketparser.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace GenericPacketParser
+{
+
+// =============================================================================
+// Frame files
+// =============================================================================
+
+/**
+* Frame files start with this magic, followed by records made of a 64-bit timestamp
+* in nanoseconds, a 32-bit length and the frame bytes, all in host order
+*/
+constexpr char frameFileMagic[8] = {'G', 'P', 'P', 'F', 'R', 'A', 'M', 'E'};
+
+/**
+* Frame located in memory with its capture timestamp
+*/
+struct TimedFrame
+{
+    uint64_t timestamp;
+    Frame frame;
+};
+
+/**
+* Class appending frames to a frame file
+*/
+class FrameFileWriter
+{
+public:
+    FrameFileWriter()
+        : _file(nullptr)
+    {
+    }
+
+    FrameFileWriter(const FrameFileWriter&) = delete;
+    FrameFileWriter& operator=(const FrameFileWriter&) = delete;
+
+    ~FrameFileWriter()
+    {
+        close();
+    }
+
+    /**
+    * @param path Path of the created file
+    * @return False if the file could not be created
+    */
+    bool open(const char* path)
+    {
+        close();
+        _file = std::fopen(path, "wb");
+        if (_file == nullptr)
+            return false;
+
+        std::setvbuf(_file, nullptr, _IOFBF, 1 << 20);
+        return std::fwrite(frameFileMagic, sizeof(frameFileMagic), 1, _file) == 1;
+    }
+
+    /**
+    * @param timestamp Capture time of the frame in nanoseconds
+    * @param data Pointer to the frame bytes
+    * @param length Length of the frame
+    * @return False if the frame could not be written
+    */
+    bool write(uint64_t timestamp, const unsigned char* data, size_t length)
+    {
+        const uint32_t recordLength = static_cast<uint32_t>(length);
+        return _file != nullptr
+            && length <= UINT32_MAX
+            && std::fwrite(&timestamp, sizeof(timestamp), 1, _file) == 1
+            && std::fwrite(&recordLength, sizeof(recordLength), 1, _file) == 1
+            && (length == 0 || std::fwrite(data, length, 1, _file) == 1);
+    }
+
+    void close()
+    {
+        if (_file != nullptr)
+            std::fclose(_file);
+        _file = nullptr;
+    }
+
+private:
+    std::FILE* _file;
+};
+
+/**
+* Reads a whole file in memory, frames pointing into it
+*
+* @return False if the file could not be opened
+*/
+inline bool readWholeFile(const char* path, std::vector<unsigned char>& contents)
+{
+    contents.clear();
+
+    std::FILE* file = std::fopen(path, "rb");
+    if (file == nullptr)
+        return false;
+
+    std::fseek(file, 0, SEEK_END);
+    const long fileLength = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    if (fileLength > 0)
+    {
+        contents.resize(static_cast<size_t>(fileLength));
+        contents.resize(std::fread(contents.data(), 1, contents.size(), file));
+    }
+    std::fclose(file);
+    return true;
+}
+
+/**
+* Loads a whole frame file in memory
+*
+* @param path Path of the frame file
+* @param contents Receives the file contents, the frames point into it
+* @param frames Receives the frames of the file
+* @return False if the file could not be read or is not a valid frame file
+*/
+inline bool readFrameFile(const char* path, std::vector<unsigned char>& contents, std::vector<TimedFrame>& frames)
+{
+    frames.clear();
+    if (!readWholeFile(path, contents))
+        return false;
+
+    if (contents.size() < sizeof(frameFileMagic) || std::memcmp(contents.data(), frameFileMagic, sizeof(frameFileMagic)) != 0)
+        return false;
+
+    const size_t recordHeaderLength = sizeof(uint64_t) + sizeof(uint32_t);
+    size_t offset = sizeof(frameFileMagic);
+    while (offset < contents.size())
+    {
+        if (contents.size() - offset < recordHeaderLength)
+            return false;
+
+        const uint64_t timestamp = loadUnaligned<uint64_t>(&contents[offset]);
+        const size_t length = loadUnaligned<uint32_t>(&contents[offset + sizeof(uint64_t)]);
+        offset += recordHeaderLength;
+        if (contents.size() - offset < length)
+            return false;
+
+        frames.push_back({timestamp, {&contents[offset], length}});
+        offset += length;
+    }
+    return true;
+}
+
+// =============================================================================
+// Pcap files
+// =============================================================================
+
+/**
+* Part of the captured packets kept as frames
+*/
+enum class CapturePayload
+{
+    // Whole captured packets, link-layer header included
+    LinkLayer,
+
+    // UDP datagram or TCP segment payloads, other packets and empty segments skipped
+    Transport
+};
+
+/**
+* @return 16-bit value in network order
+*/
+inline uint16_t loadNetworkOrder16(const unsigned char* data)
+{
+    return static_cast<uint16_t>((data[0] << 8) | data[1]);
+}
+
+/**
+* Locates the UDP or TCP payload of a captured packet
+*
+* @param linkType Link type of the capture: null/loopback, Ethernet, raw IP or Linux cooked
+* @param packet Captured packet, updated to its payload
+* @return False if the packet does not carry a UDP or TCP payload
+* @note IPv6 extension headers and IPv4 fragments past the first are not followed
+*/
+inline bool locateTransportPayload(uint32_t linkType, Frame& packet)
+{
+    const unsigned char* data = packet.data;
+    size_t length = packet.length;
+
+    // Link layer
+    uint16_t etherType = 0;
+    size_t linkHeaderLength = 0;
+    switch (linkType)
+    {
+    case 0: // Null/loopback, the address family being in the capturing host order the IP version is used instead
+        linkHeaderLength = 4;
+        if (length <= linkHeaderLength)
+            return false;
+        etherType = (data[linkHeaderLength] >> 4) == 4 ? 0x0800 : 0x86DD;
+        break;
+    case 1: // Ethernet, possibly VLAN tagged
+        linkHeaderLength = 14;
+        if (length < linkHeaderLength)
+            return false;
+        etherType = loadNetworkOrder16(&data[12]);
+        while ((etherType == 0x8100 || etherType == 0x88A8) && length >= linkHeaderLength + 4)
+        {
+            etherType = loadNetworkOrder16(&data[linkHeaderLength + 2]);
+            linkHeaderLength += 4;
+        }
+        break;
+    case 101: // Raw IP
+    case 228:
+    case 229:
+        if (length < 1)
+            return false;
+        etherType = (data[0] >> 4) == 4 ? 0x0800 : 0x86DD;
+        break;
+    case 113: // Linux cooked
+        linkHeaderLength = 16;
+        if (length < linkHeaderLength)
+            return false;
+        etherType = loadNetworkOrder16(&data[14]);
+        break;
+    default:
+        return false;
+    }
+    data += linkHeaderLength;
+    length -= linkHeaderLength;
+
+    // Network layer, trimmed to its own length to drop the link-layer padding
+    uint8_t protocol = 0;
+    if (etherType == 0x0800)
+    {
+        if (length < 20 || (data[0] >> 4) != 4)
+            return false;
+        const size_t headerLength = static_cast<size_t>(data[0] & 0x0f) * 4;
+        const size_t totalLength = loadNetworkOrder16(&data[2]);
+        if (headerLength < 20 || totalLength < headerLength || totalLength > length || (loadNetworkOrder16(&data[6]) & 0x1fff) != 0)
+            return false;
+        protocol = data[9];
+        data += headerLength;
+        length = totalLength - headerLength;
+    }
+    else if (etherType == 0x86DD)
+    {
+        if (length < 40 || (data[0] >> 4) != 6)
+            return false;
+        const size_t payloadLength = loadNetworkOrder16(&data[4]);
+        if (payloadLength > length - 40)
+            return false;
+        protocol = data[6];
+        data += 40;
+        length = payloadLength;
+    }
+    else
+    {
+        return false;
+    }
+
+    // Transport layer
+    size_t headerLength = 0;
+    if (protocol == 17)
+    {
+        if (length < 8)
+            return false;
+        const size_t datagramLength = loadNetworkOrder16(&data[4]);
+        if (datagramLength < 8 || datagramLength > length)
+            return false;
+        headerLength = 8;
+        length = datagramLength;
+    }
+    else if (protocol == 6)
+    {
+        if (length < 20)
+            return false;
+        headerLength = static_cast<size_t>(data[12] >> 4) * 4;
+        if (headerLength < 20 || headerLength > length)
+            return false;
+    }
+    else
+    {
+        return false;
+    }
+
+    if (length == headerLength)
+        return false;
+
+    packet = {data + headerLength, length - headerLength};
+    return true;
+}
+
+/**
+* Loads a whole pcap file in memory, microsecond and nanosecond captures of either byte order
+*
+* @param path Path of the pcap file
+* @param contents Receives the file contents, the frames point into it
+* @param frames Receives the frames of the file, timestamps in nanoseconds
+* @param payload Part of the captured packets kept as frames
+* @return False if the file could not be read or is not a valid pcap file
+* @note TCP segments are kept one frame each, without stream reassembly
+*/
+inline bool readPcapFile(const char* path, std::vector<unsigned char>& contents, std::vector<TimedFrame>& frames,
+    CapturePayload payload = CapturePayload::Transport)
+{
+    frames.clear();
+    if (!readWholeFile(path, contents))
+        return false;
+
+    const size_t fileHeaderLength = 24;
+    const size_t recordHeaderLength = 16;
+    if (contents.size() < fileHeaderLength)
+        return false;
+
+    const uint32_t magic = loadUnaligned<uint32_t>(&contents[0]);
+    const bool swapped = magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1;
+    const bool nanoseconds = magic == 0xa1b23c4d || magic == 0x4d3cb2a1;
+    if (!swapped && magic != 0xa1b2c3d4 && magic != 0xa1b23c4d)
+        return false;
+
+    auto load32 = [&](size_t offset)
+    {
+        const uint32_t value = loadUnaligned<uint32_t>(&contents[offset]);
+        return swapped ? EndiannessInverter<uint32_t>::call(value) : value;
+    };
+
+    const uint32_t linkType = load32(20);
+    size_t offset = fileHeaderLength;
+    while (offset < contents.size())
+    {
+        if (contents.size() - offset < recordHeaderLength)
+            return false;
+
+        const uint64_t seconds = load32(offset);
+        const uint64_t fraction = load32(offset + 4);
+        const size_t length = load32(offset + 8);
+        offset += recordHeaderLength;
+        if (contents.size() - offset < length)
+            return false;
+
+        Frame packet{&contents[offset], length};
+        offset += length;
+        if (payload == CapturePayload::Transport && !locateTransportPayload(linkType, packet))
+            continue;
+
+        frames.push_back({seconds * 1000000000 + (nanoseconds ? fraction : fraction * 1000), packet});
+    }
+    return true;
+}
+
+/**
+* Loads a frame file or a pcap file, recognized by their magic
+*
+* @see GenericPacketParser::readFrameFile
+* @see GenericPacketParser::readPcapFile
+*/
+inline bool readCaptureFile(const char* path, std::vector<unsigned char>& contents, std::vector<TimedFrame>& frames,
+    CapturePayload payload = CapturePayload::Transport)
+{
+    if (readFrameFile(path, contents, frames))
+        return true;
+    return readPcapFile(path, contents, frames, payload);
+}
+
+} // namespace GenericPacketParser
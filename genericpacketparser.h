@@ -4,6 +4,18 @@
 #include <tuple>
 #include <type_traits>
 #include <cassert>
+#include <cstring>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
 
 namespace GenericPacketParser
 {
@@ -21,6 +33,7 @@ enum class PacketParserErrorId
     EmptyTextNotAllowed,
     ExceededDataRange,
     UnhandledFieldType,
+    WorkBudgetExceeded,
     Unknown
 };
 
@@ -36,6 +49,7 @@ std::ostream& operator<<(std::ostream& out, PacketParserErrorId error)
         ERROR_TO_STREAM(EmptyTextNotAllowed);
         ERROR_TO_STREAM(ExceededDataRange);
         ERROR_TO_STREAM(UnhandledFieldType);
+        ERROR_TO_STREAM(WorkBudgetExceeded);
         ERROR_TO_STREAM(Unknown);
 #undef ERROR_TO_STREAM
     default:
@@ -51,11 +65,20 @@ std::ostream& operator<<(std::ostream& out, PacketParserErrorId error)
 /**
 * Template class used to reverse the endianness of a value.
 *
-* @note Implemented for primitives of size 2, 4 and 8. Other sizes will generate compilation errors
+* @note Implemented for primitives of size 1, 2, 4 and 8. Other sizes will generate compilation errors
 */
 template <class T, size_t TypeSize = sizeof(T)>
 struct EndiannessInverter;
 
+template <class T>
+struct EndiannessInverter<T, 1>
+{
+    static T call(const T value)
+    {
+        return value;
+    }
+};
+
 template <class T>
 struct EndiannessInverter<T, 2>
 {
@@ -94,6 +117,201 @@ struct EndiannessInverter<T, 8>
     }
 };
 
+/**
+* Applies the byte-order policy of a value field to a value, in either direction
+*/
+template <class FieldType, class ValueType = typename FieldType::ValueType>
+ValueType applyEndianness(const ValueType value)
+{
+    if constexpr (FieldType::invertEndianness)
+        return EndiannessInverter<ValueType>::call(value);
+    else
+        return value;
+}
+
+// =============================================================================
+// Unaligned access
+// =============================================================================
+
+/**
+* Reads a value of type T from a possibly unaligned position
+*
+* @note Compiles down to a single load on targets supporting unaligned accesses
+*/
+template <class T>
+T loadUnaligned(const unsigned char* data)
+{
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+/**
+* Writes a value of type T to a possibly unaligned position
+*
+* @note Compiles down to a single store on targets supporting unaligned accesses
+*/
+template <class T>
+void storeUnaligned(unsigned char* data, const T value)
+{
+    std::memcpy(data, &value, sizeof(T));
+}
+
+// =============================================================================
+// Lane byte swap
+// =============================================================================
+
+/**
+* Inverts the byte order of contiguous values, several values per instruction when SSSE3 or AVX2 is enabled
+*
+* @tparam T Value type, of size 1, 2, 4 or 8
+* @param values Pointer to the first value
+* @param count Number of values
+*/
+template <class T>
+void swapLanes(T* values, size_t count)
+{
+    if constexpr (sizeof(T) == 1)
+    {
+        return;
+    }
+    else
+    {
+        size_t offset = 0;
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+        const size_t blockSize = sizeof(T) * count;
+        unsigned char* const bytes = reinterpret_cast<unsigned char*>(values);
+
+        // Shuffle masks reversing each group of 2, 4 or 8 bytes within a 16-byte vector
+        alignas(16) static constexpr unsigned char masks[3][16] = {
+            {1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14},
+            {3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12},
+            {7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8}};
+        constexpr size_t maskIndex = sizeof(T) == 2 ? 0 : sizeof(T) == 4 ? 1 : 2;
+        const __m128i shuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(masks[maskIndex]));
+
+#if defined(__AVX2__)
+        const __m256i wideShuffle = _mm256_broadcastsi128_si256(shuffle);
+        for (; offset + 32 <= blockSize; offset += 32)
+        {
+            __m256i* const vector = reinterpret_cast<__m256i*>(bytes + offset);
+            _mm256_storeu_si256(vector, _mm256_shuffle_epi8(_mm256_loadu_si256(vector), wideShuffle));
+        }
+#endif
+        for (; offset + 16 <= blockSize; offset += 16)
+        {
+            __m128i* const vector = reinterpret_cast<__m128i*>(bytes + offset);
+            _mm_storeu_si128(vector, _mm_shuffle_epi8(_mm_loadu_si128(vector), shuffle));
+        }
+#endif
+
+        for (size_t i = offset / sizeof(T); i < count; ++i)
+            values[i] = EndiannessInverter<T>::call(values[i]);
+    }
+}
+
+// =============================================================================
+// Text hashing
+// =============================================================================
+
+/**
+* Mixes a word of up to 8 characters into the hash of a text
+*/
+inline uint64_t mixTextWord(uint64_t hash, uint64_t word)
+{
+    hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+    return hash ^ (hash >> 32);
+}
+
+/**
+* Finalizes the hash of a text, spreading every character over every bit
+*/
+inline uint64_t finishTextHash(uint64_t hash, size_t length)
+{
+    hash = (hash ^ length) * 0xFF51AFD7ED558CCDull;
+    return hash ^ (hash >> 33);
+}
+
+/**
+* @return Hash of a text of known length, equal to the one computed by scanText
+*/
+inline uint64_t hashText(const char* text, size_t length)
+{
+    const unsigned char* const bytes = reinterpret_cast<const unsigned char*>(text);
+    uint64_t hash = 0;
+    size_t offset = 0;
+    for (; offset + 8 <= length; offset += 8)
+        hash = mixTextWord(hash, loadUnaligned<uint64_t>(bytes + offset));
+
+    if (offset < length)
+    {
+        uint64_t word = 0;
+        std::memcpy(&word, bytes + offset, length - offset);
+        hash = mixTextWord(hash, word);
+    }
+    return finishTextHash(hash, length);
+}
+
+/**
+* Looks for the terminator of a text, hashing its characters a word at a time on the way
+*
+* @param text First character of the text
+* @param maxLength Number of bytes that can be read, terminator included
+* @param length Receives the length of the text, without terminator
+* @param hash Receives the hash of the text, equal to the one computed by hashText
+* @return False if no terminator is found within maxLength bytes
+*/
+inline bool scanText(const unsigned char* text, size_t maxLength, size_t& length, uint64_t& hash)
+{
+    constexpr uint64_t lowBits = 0x0101010101010101ull;
+    constexpr uint64_t highBits = 0x8080808080808080ull;
+
+    // Whole words are mixed until one holds a zero byte
+    uint64_t state = 0;
+    size_t offset = 0;
+    size_t tailLength = 8;
+    for (; offset + 8 <= maxLength; offset += 8)
+    {
+        const uint64_t word = loadUnaligned<uint64_t>(text + offset);
+        const uint64_t zeroBytes = (word - lowBits) & ~word & highBits;
+        if (zeroBytes != 0)
+        {
+            // The lowest flagged byte is always a zero byte, the ones above it may not be
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            tailLength = static_cast<size_t>(__builtin_ctzll(zeroBytes)) / 8;
+#else
+            tailLength = 0;
+            while (text[offset + tailLength] != 0)
+                ++tailLength;
+#endif
+            break;
+        }
+        state = mixTextWord(state, word);
+    }
+
+    // Fewer than 8 bytes left without a terminator so far
+    if (tailLength == 8)
+    {
+        tailLength = 0;
+        while (offset + tailLength < maxLength && text[offset + tailLength] != 0)
+            ++tailLength;
+        if (offset + tailLength == maxLength)
+            return false;
+    }
+
+    if (tailLength != 0)
+    {
+        uint64_t word = 0;
+        std::memcpy(&word, text + offset, tailLength);
+        state = mixTextWord(state, word);
+    }
+
+    length = offset + tailLength;
+    hash = finishTextHash(state, length);
+    return true;
+}
+
 // =============================================================================
 // CountParameters
 // =============================================================================
@@ -249,6 +467,7 @@ struct MultiField
 {
     using ValueType = OutputType;
     using SetterType = SetterSignature;
+    using FieldsType = std::tuple<Fields...>;
     static constexpr size_t fieldCount = sizeof...(Fields);
     static constexpr FieldTypeId typeId = FieldTypeId::MultiField;
 
@@ -330,143 +549,1666 @@ struct StaticFieldArray
 };
 
 // =============================================================================
-// PacketParser
+// FieldWithGetter
 // =============================================================================
 
 /**
-* Class containing the parsing logic for the provided fields.
+* Struct used to attach a getter to a field so that the same layout can be used for serialization
 *
-* @tparam Fields Field types to parse
+* @tparam FieldType Type of the decorated field
+* @tparam GetterSignature Type of the getter returning the value to serialize
+* @note The getter is invoked with std::invoke, so a pointer to data member is a valid getter
+* @note Inside an array, the getter of the element field returns the whole range of elements
 */
-template<class... Fields>
-class PacketParser
+template <class FieldType, class GetterSignature>
+struct FieldWithGetter : FieldType
 {
-public:
-    using Data = const unsigned char*;
+    using GetterType = GetterSignature;
 
     /**
-    * @tparam Fields Field types to parse
-    * @param fields Fields to parse
-    * @see GenericPackerParser::makePacketParser
+    * @param field Field to decorate
+    * @param getter Getter used to retrieve the value to serialize
+    * @see GenericPackerParser::makeFieldWithGetter
     */
-    template<class... Fields>
-    PacketParser(Fields... fields)
-        : _fields(fields...)
-        , _data(nullptr)
-        , _length(0)
-        , _offset(0)
+    FieldWithGetter(FieldType field, GetterSignature getter)
+        : FieldType(field)
+        , getter(getter)
     {
     }
 
+    GetterSignature getter;
+};
+
+// =============================================================================
+// InternedTextField
+// =============================================================================
+
+/**
+* Struct used to intern the texts of a text field: its setter receives what the interner returns for each text,
+* e.g. an InternedText, instead of a pointer into the packet
+*
+* @tparam TextFieldType Type of the decorated text field
+* @tparam Interner Type of the interner, with a member intern(const char* text, size_t length, uint64_t hash)
+* @note The text is hashed while its terminator is looked for, see scanText
+* @note Parsers copied for other threads share the interner, which must then be thread-safe
+*/
+template <class TextFieldType, class Interner>
+struct InternedTextField : TextFieldType
+{
+    static_assert(TextFieldType::typeId == FieldTypeId::TextField, "Only text fields can be interned");
+    using InternerType = Interner;
+
     /**
-    * @tparam OutputType Receiving output struct/class type
-    * @param data Pointer to binary data to parse
-    * @param length Length of binary data to parse
-    * @param output Reference to output struct/class
+    * @param field Text field to decorate
+    * @param interner Interner receiving the texts, which must outlive the parser
+    * @see GenericPackerParser::makeInternedTextField
     */
-    template <class OutputType>
-    PacketParserErrorId parse(Data data, size_t length, OutputType& output)
+    InternedTextField(TextFieldType field, Interner& interner)
+        : TextFieldType(field)
+        , interner(&interner)
     {
-        // Reset working values
-        _offset = 0;
-        _data = data;
-        _length = length;
-        return processAllFields(output, std::make_index_sequence<_fieldCount>());
     }
 
-private:
-    const static size_t _fieldCount = sizeof...(Fields);
-    std::tuple<Fields...> _fields;
-    Data _data;
-    size_t _length;
-    size_t _offset;
+    Interner* interner;
+};
 
-    template <class OutputType, size_t... I>
-    PacketParserErrorId processAllFields(OutputType& output, std::index_sequence<I...>)
+template <class FieldType, class = void>
+struct HasInterner : std::false_type
+{
+};
+
+template <class FieldType>
+struct HasInterner<FieldType, std::void_t<typename FieldType::InternerType>> : std::true_type
+{
+};
+
+// =============================================================================
+// Wire size traits
+// =============================================================================
+
+/**
+* Metafunction giving the wire size of a field when it does not depend on the parsed data
+*
+* @note isFixed is false for text, binary and array fields
+*/
+template <class FieldType, FieldTypeId TypeId = FieldType::typeId>
+struct FieldWireSize
+{
+    static constexpr bool isFixed = false;
+    static constexpr size_t value = 0;
+};
+
+template <class... Fields>
+struct FieldsWireSize
+{
+    static constexpr bool isFixed = (FieldWireSize<Fields>::isFixed && ...);
+    static constexpr size_t value = (FieldWireSize<Fields>::value + ... + 0);
+};
+
+template <class Tuple>
+struct TupleWireSize;
+
+template <class... Fields>
+struct TupleWireSize<std::tuple<Fields...>> : FieldsWireSize<Fields...>
+{
+};
+
+template <class FieldType>
+struct FieldWireSize<FieldType, FieldTypeId::ValueField>
+{
+    static constexpr bool isFixed = true;
+    static constexpr size_t value = sizeof(typename FieldType::ValueType);
+};
+
+template <class FieldType>
+struct FieldWireSize<FieldType, FieldTypeId::MultiField> : TupleWireSize<typename FieldType::FieldsType>
+{
+};
+
+/**
+* Metafunction locating the leading fields of a layout, whose offsets are known at compile time
+*/
+template <class... Fields>
+struct FixedLayout
+{
+    /**
+    * Number of leading fields with a fixed wire size
+    */
+    static constexpr size_t fixedFieldCount()
     {
-        // Process all fields
-        PacketParserErrorId error = PacketParserErrorId::NoError;
-        (processField(output, std::get<I>(_fields), error), ...);
-        return error;
+        constexpr bool isFixed[] = {FieldWireSize<Fields>::isFixed..., false};
+        size_t count = 0;
+        while (isFixed[count])
+            ++count;
+        return count;
     }
 
-    template <class OutputType, class FieldType>
-    void processField(OutputType& output, FieldType& field, PacketParserErrorId& error)
+    /**
+    * Offset of a field, valid up to the first field with a variable wire size (included)
+    */
+    static constexpr size_t offset(size_t index)
     {
-        // Keep processing fields as long as they are valid
-        if (error != PacketParserErrorId::NoError)
-            return;
-
-        processBinary(output, field, error);
+        constexpr size_t sizes[] = {FieldWireSize<Fields>::value..., 0};
+        size_t offset = 0;
+        for (size_t i = 0; i < index; ++i)
+            offset += sizes[i];
+        return offset;
     }
+};
 
-    template <class OutputType, class FieldType>
-    void processBinary(OutputType& output, FieldType& field, PacketParserErrorId& error)
-    {
-        using ValueType = FieldType:: template ValueType;
+// =============================================================================
+// Record transposition
+// =============================================================================
 
-        // ValueField parsing
-        if constexpr (FieldType::typeId == FieldTypeId::ValueField)
-        {
-            // Call the output setter depending on endianness
-            if(FieldType::invertEndianness)
-                (output.*(field.setter))(EndiannessInverter<ValueType>::call(*(reinterpret_cast<const ValueType*>(&_data[_offset]))));
-            else
-                (output.*(field.setter))(*(reinterpret_cast<const ValueType*>(&_data[_offset])));
+/**
+* Metafunction telling whether a field is a record of value fields, i.e. a multi field
+* made only of value fields, whose elements are contiguous fixed-size records when in an array
+*/
+template <class FieldType, FieldTypeId TypeId = FieldType::typeId>
+struct IsValueRecord : std::false_type
+{
+};
 
-            _offset += field.length;
-            if (_offset > _length)
-                error = PacketParserErrorId::ExceededDataRange;
+template <class Tuple>
+struct IsValueRecordTuple;
 
-            return;
-        }
+template <class... Fields>
+struct IsValueRecordTuple<std::tuple<Fields...>>
+    : std::bool_constant<sizeof...(Fields) != 0 && ((Fields::typeId == FieldTypeId::ValueField) && ...)>
+{
+};
 
-        // TextField parsing
-        else if constexpr (FieldType::typeId == FieldTypeId::TextField)
-        {
-            size_t nullTerminatorDistance = 0;
-            if (!rangeContainsNullTerminator(_offset, _offset + field.length, nullTerminatorDistance, error))
-            {
-                // Avoid potentially overwriting an error set by the rangeContainsNullTerminator call
-                error = error == PacketParserErrorId::NoError
-                    ? PacketParserErrorId::MissingNullTerminator
-                    : error;
-                return;
-            }
+template <class FieldType>
+struct IsValueRecord<FieldType, FieldTypeId::MultiField> : IsValueRecordTuple<typename FieldType::FieldsType>
+{
+};
 
-            if (!field.allowEmpty && nullTerminatorDistance == 1)
-            {
-                error = PacketParserErrorId::EmptyTextNotAllowed;
-                return;
-            }
+template <class Tuple>
+struct RecordTransposer;
 
-            // Call the output setter
-            (output.*(field.setter))((const ValueType)(&_data[_offset]));
+/**
+* Struct transposing blocks of records of value fields into one array per member
+*
+* @tparam Fields Value fields of the record
+*/
+template <class... Fields>
+struct RecordTransposer<std::tuple<Fields...>>
+{
+    static constexpr size_t stride = FieldsWireSize<Fields...>::value;
 
-            // Update field length to increment _offset correctly
-            _offset += nullTerminatorDistance;
+    /**
+    * Number of records transposed member after member, small enough for their bytes to stay in the L1 cache
+    */
+    static constexpr size_t chunkRecordCount = 16384 / stride != 0 ? 16384 / stride : 1;
 
-            return;
-        }
+    template <class... T>
+    static void transpose(const unsigned char* records, size_t count, T*... members)
+    {
+        static_assert((std::is_same_v<typename Fields::ValueType, T> && ...), "Member arrays must have the value types of the record fields");
 
-        // Binary parsing
-        else if constexpr (FieldType::typeId == FieldTypeId::BinaryField)
+        // The block is read from memory once, each chunk being transposed while it is cached
+        for (size_t first = 0; first < count; first += chunkRecordCount)
         {
-            // Decode binary data size
-            using SizeType = FieldType:: template PayloadSizeType;
-            SizeType payloadSize = (*(reinterpret_cast<const SizeType*>(&_data[_offset])));
+            const size_t chunkCount = count - first < chunkRecordCount ? count - first : chunkRecordCount;
+            transposeChunk(records + first * stride, chunkCount, std::index_sequence_for<Fields...>(), (members + first)...);
+        }
+    }
 
-            _offset += sizeof(SizeType);
-            if ((_offset + payloadSize) > _length)
-            {
-                error = PacketParserErrorId::ExceededDataRange;
-                return;
-            }
+private:
+    template <size_t... I, class... T>
+    static void transposeChunk(const unsigned char* records, size_t count, std::index_sequence<I...>, T*... members)
+    {
+        (gatherMember<Fields, FixedLayout<Fields...>::offset(I)>(records, count, members), ...);
+    }
 
-            // Call the output setter
-            (output.*(field.setter))((const ValueType)(&_data[_offset]), payloadSize);
+    struct ShuffleMask
+    {
+        unsigned char bytes[16];
+    };
 
-            // Update field length to increment _offset correctly
+    /**
+    * Mask moving the member bytes found in input vector Vector to their place in an output vector,
+    * in reverse order for members whose endianness is inverted, zeroing the others
+    */
+    template <class FieldType, size_t Offset, size_t Vector>
+    static constexpr ShuffleMask makeShuffleMask()
+    {
+        constexpr size_t size = sizeof(typename FieldType::ValueType);
+        ShuffleMask mask{};
+        for (size_t i = 0; i < 16; ++i)
+        {
+            const size_t byte = FieldType::invertEndianness ? size - 1 - i % size : i % size;
+            const size_t source = i / size * stride + Offset + byte;
+            mask.bytes[i] = static_cast<unsigned char>(source / 16 == Vector ? source % 16 : 0x80);
+        }
+        return mask;
+    }
+
+    template <class FieldType, size_t Offset>
+    static void gatherMember(const unsigned char* records, size_t count, typename FieldType::ValueType* values)
+    {
+        using ValueType = typename FieldType::ValueType;
+        size_t i = 0;
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+        // An output vector holds the member of valuesPerVector records, gathered from the inputVectorCount input
+        // vectors spanning them. It beats scalar loads while there are no more shuffles than values
+        constexpr size_t valuesPerVector = 16 / sizeof(ValueType);
+        constexpr size_t inputVectorCount = ((valuesPerVector - 1) * stride + Offset + sizeof(ValueType) - 1) / 16 + 1;
+        if constexpr (inputVectorCount <= valuesPerVector)
+        {
+            const size_t inputRecords = (inputVectorCount * 16 + stride - 1) / stride;
+            const size_t lastRecords = inputRecords > valuesPerVector ? inputRecords : valuesPerVector;
+            for (; i + lastRecords <= count; i += valuesPerVector)
+            {
+                const __m128i vector = gatherVector<FieldType, Offset>(records + i * stride, std::make_index_sequence<inputVectorCount>());
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), vector);
+            }
+        }
+#endif
+
+        for (; i < count; ++i)
+            values[i] = applyEndianness<FieldType>(loadUnaligned<ValueType>(records + i * stride + Offset));
+    }
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+    template <class FieldType, size_t Offset, size_t... Vector>
+    static __m128i gatherVector(const unsigned char* records, std::index_sequence<Vector...>)
+    {
+        alignas(16) static constexpr ShuffleMask masks[] = {makeShuffleMask<FieldType, Offset, Vector>()...};
+        __m128i vector = _mm_setzero_si128();
+        ((vector = _mm_or_si128(vector, _mm_shuffle_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(records + Vector * 16)),
+            _mm_load_si128(reinterpret_cast<const __m128i*>(masks[Vector].bytes))))), ...);
+        return vector;
+    }
+#endif
+};
+
+/**
+* Transposes contiguous records of value fields into one array per member, in host order,
+* shuffling and byte swapping several records per instruction when SSSE3 or AVX2 is enabled
+*
+* @tparam RecordFieldType Multi field made only of value fields
+* @param records First byte of the first record
+* @param count Number of records
+* @param members One array per member, in field order, receiving count values each
+*/
+template <class RecordFieldType, class... T>
+void transposeRecords(const unsigned char* records, size_t count, T*... members)
+{
+    static_assert(IsValueRecord<RecordFieldType>::value, "Only records made only of value fields can be transposed");
+    static_assert(sizeof...(T) == RecordFieldType::fieldCount, "One member array is needed per record field");
+    RecordTransposer<typename RecordFieldType::FieldsType>::transpose(records, count, members...);
+}
+
+// =============================================================================
+// Wire size bounds
+// =============================================================================
+
+/**
+* Metafunction giving the smallest wire size of a field known from its type alone
+*
+* @note Static arrays are counted with a single element, their size being set at run time
+*/
+template <class FieldType, FieldTypeId TypeId = FieldType::typeId>
+struct FieldMinWireSize : std::integral_constant<size_t, sizeof(typename FieldType::ValueType)>
+{
+};
+
+template <class Tuple>
+struct TupleMinWireSize;
+
+template <class... Fields>
+struct TupleMinWireSize<std::tuple<Fields...>> : std::integral_constant<size_t, (FieldMinWireSize<Fields>::value + ... + 0)>
+{
+};
+
+// Terminator alone, or with a character when the text cannot be empty
+template <class FieldType>
+struct FieldMinWireSize<FieldType, FieldTypeId::TextField> : std::integral_constant<size_t, FieldType::allowEmpty ? 1 : 2>
+{
+};
+
+template <class FieldType>
+struct FieldMinWireSize<FieldType, FieldTypeId::BinaryField> : std::integral_constant<size_t, sizeof(typename FieldType::PayloadSizeType)>
+{
+};
+
+template <class FieldType>
+struct FieldMinWireSize<FieldType, FieldTypeId::MultiField> : TupleMinWireSize<typename FieldType::FieldsType>
+{
+};
+
+template <class FieldType>
+struct FieldMinWireSize<FieldType, FieldTypeId::DynamicFieldArray> : std::integral_constant<size_t, sizeof(typename FieldType::ArraySizeType)>
+{
+};
+
+template <class FieldType>
+struct FieldMinWireSize<FieldType, FieldTypeId::StaticFieldArray> : FieldMinWireSize<typename FieldType::ArrayFieldType>
+{
+};
+
+/**
+* @return a + b, or SIZE_MAX if it overflows
+*/
+constexpr size_t saturatingAdd(size_t a, size_t b)
+{
+    return a > SIZE_MAX - b ? SIZE_MAX : a + b;
+}
+
+/**
+* @return a * b, or SIZE_MAX if it overflows
+*/
+constexpr size_t saturatingMultiply(size_t a, size_t b)
+{
+    return a != 0 && b > SIZE_MAX / a ? SIZE_MAX : a * b;
+}
+
+/**
+* @return Largest value of a size prefix, or SIZE_MAX if it does not fit a size_t
+*/
+template <class SizeType>
+constexpr size_t largestSize()
+{
+    return std::numeric_limits<SizeType>::max() > SIZE_MAX ? SIZE_MAX : static_cast<size_t>(std::numeric_limits<SizeType>::max());
+}
+
+template <class FieldType>
+size_t fieldMinWireSize(const FieldType& field);
+
+template <class FieldType>
+size_t fieldMaxWireSize(const FieldType& field);
+
+/**
+* @return Smallest wire size of a tuple of fields
+*/
+template <class... Fields>
+size_t tupleMinWireSize(const std::tuple<Fields...>& fields)
+{
+    return std::apply([](const Fields&... field) { return (size_t(0) + ... + fieldMinWireSize(field)); }, fields);
+}
+
+/**
+* @return Largest wire size of a tuple of fields, SIZE_MAX when it is unbounded
+*/
+template <class... Fields>
+size_t tupleMaxWireSize(const std::tuple<Fields...>& fields)
+{
+    return std::apply([](const Fields&... field)
+    {
+        size_t size = 0;
+        ((size = saturatingAdd(size, fieldMaxWireSize(field))), ...);
+        return size;
+    }, fields);
+}
+
+/**
+* @return Smallest wire size of a field, static arrays counted with their size
+*/
+template <class FieldType>
+size_t fieldMinWireSize(const FieldType& field)
+{
+    if constexpr (FieldType::typeId == FieldTypeId::MultiField)
+        return tupleMinWireSize(field.fields);
+    else if constexpr (FieldType::typeId == FieldTypeId::StaticFieldArray)
+        return saturatingMultiply(field.size, fieldMinWireSize(field.field));
+    else
+        return FieldMinWireSize<FieldType>::value;
+}
+
+/**
+* @return Largest wire size of a field, SIZE_MAX when it is unbounded
+* @note Binary fields and dynamic arrays are bounded by the largest value of their size prefix
+*/
+template <class FieldType>
+size_t fieldMaxWireSize(const FieldType& field)
+{
+    if constexpr (FieldType::typeId == FieldTypeId::ValueField || FieldType::typeId == FieldTypeId::TextField)
+    {
+        return field.length;
+    }
+    else if constexpr (FieldType::typeId == FieldTypeId::BinaryField)
+    {
+        using SizeType = typename FieldType::PayloadSizeType;
+        return saturatingAdd(sizeof(SizeType), largestSize<SizeType>());
+    }
+    else if constexpr (FieldType::typeId == FieldTypeId::MultiField)
+    {
+        return tupleMaxWireSize(field.fields);
+    }
+    else if constexpr (FieldType::typeId == FieldTypeId::DynamicFieldArray)
+    {
+        using SizeType = typename FieldType::ArraySizeType;
+        return saturatingAdd(sizeof(SizeType), saturatingMultiply(largestSize<SizeType>(), fieldMaxWireSize(field.field)));
+    }
+    else
+    {
+        return saturatingMultiply(field.size, fieldMaxWireSize(field.field));
+    }
+}
+
+// =============================================================================
+// Field nodes
+// =============================================================================
+
+/**
+* Metafunction counting the fields of a field tree: the field itself, its subfields and its array element
+*/
+template <class FieldType, FieldTypeId TypeId = FieldType::typeId>
+struct FieldNodeCount : std::integral_constant<size_t, 1>
+{
+};
+
+template <class Tuple>
+struct TupleNodeCount;
+
+template <class... Fields>
+struct TupleNodeCount<std::tuple<Fields...>> : std::integral_constant<size_t, (FieldNodeCount<Fields>::value + ... + 0)>
+{
+};
+
+template <class FieldType>
+struct FieldNodeCount<FieldType, FieldTypeId::MultiField>
+    : std::integral_constant<size_t, 1 + TupleNodeCount<typename FieldType::FieldsType>::value>
+{
+};
+
+template <class FieldType>
+struct FieldNodeCount<FieldType, FieldTypeId::DynamicFieldArray>
+    : std::integral_constant<size_t, 1 + FieldNodeCount<typename FieldType::ArrayFieldType>::value>
+{
+};
+
+template <class FieldType>
+struct FieldNodeCount<FieldType, FieldTypeId::StaticFieldArray>
+    : std::integral_constant<size_t, 1 + FieldNodeCount<typename FieldType::ArrayFieldType>::value>
+{
+};
+
+/**
+* Depth-first index of the field I of a tuple of fields, the first one having index First
+*/
+template <class Tuple, size_t I, size_t First, size_t... J>
+constexpr size_t tupleFieldNode(std::index_sequence<J...>)
+{
+    return First + (FieldNodeCount<std::tuple_element_t<J, Tuple>>::value + ... + 0);
+}
+
+template <class Tuple, size_t I, size_t First>
+constexpr size_t tupleFieldNode()
+{
+    return tupleFieldNode<Tuple, I, First>(std::make_index_sequence<I>());
+}
+
+// =============================================================================
+// Instrumentation
+// =============================================================================
+
+/**
+* Default instrumentation policy of PacketParser, compiling out every hook.
+*
+* An enabled policy provides:
+*   static constexpr bool enabled = true;
+*   static uint64_t begin();
+*   template <class ParserType> static void end(size_t node, size_t bytes, uint64_t begin);
+* begin is called before a field is parsed, end after, with the depth-first index of the field
+* and the bytes it consumed. Nested fields are included in the measure of their parent.
+*
+* @see fieldinstrumentation.h
+*/
+struct NoInstrumentation
+{
+    static constexpr bool enabled = false;
+};
+
+// =============================================================================
+// Work budget
+// =============================================================================
+
+/**
+* Metafunction counting the setter calls made by a field, excluding the elements of arrays
+*/
+template <class FieldType, FieldTypeId TypeId = FieldType::typeId>
+struct FieldSetterCount : std::integral_constant<size_t, 1>
+{
+};
+
+template <class Tuple>
+struct TupleSetterCount;
+
+template <class... Fields>
+struct TupleSetterCount<std::tuple<Fields...>> : std::integral_constant<size_t, (FieldSetterCount<Fields>::value + ... + 0)>
+{
+};
+
+template <class FieldType>
+struct FieldSetterCount<FieldType, FieldTypeId::MultiField>
+    : std::integral_constant<size_t, 1 + TupleSetterCount<typename FieldType::FieldsType>::value>
+{
+};
+
+template <class FieldType>
+struct FieldSetterCount<FieldType, FieldTypeId::DynamicFieldArray> : std::integral_constant<size_t, 0>
+{
+};
+
+template <class FieldType>
+struct FieldSetterCount<FieldType, FieldTypeId::StaticFieldArray> : std::integral_constant<size_t, 0>
+{
+};
+
+/**
+* Metafunction giving the nesting depth of a field, 1 for a field without subfields or elements
+*/
+template <class FieldType, FieldTypeId TypeId = FieldType::typeId>
+struct FieldDepth : std::integral_constant<size_t, 1>
+{
+};
+
+template <class Tuple>
+struct TupleDepth;
+
+template <class... Fields>
+struct TupleDepth<std::tuple<Fields...>>
+{
+    static constexpr size_t value()
+    {
+        constexpr size_t depths[] = {FieldDepth<Fields>::value..., 0};
+        size_t depth = 0;
+        for (const size_t fieldDepth : depths)
+            depth = fieldDepth > depth ? fieldDepth : depth;
+        return depth;
+    }
+};
+
+template <class FieldType>
+struct FieldDepth<FieldType, FieldTypeId::MultiField>
+    : std::integral_constant<size_t, 1 + TupleDepth<typename FieldType::FieldsType>::value()>
+{
+};
+
+template <class FieldType>
+struct FieldDepth<FieldType, FieldTypeId::DynamicFieldArray>
+    : std::integral_constant<size_t, 1 + FieldDepth<typename FieldType::ArrayFieldType>::value>
+{
+};
+
+template <class FieldType>
+struct FieldDepth<FieldType, FieldTypeId::StaticFieldArray>
+    : std::integral_constant<size_t, 1 + FieldDepth<typename FieldType::ArrayFieldType>::value>
+{
+};
+
+/**
+* Struct used to limit the work of a parse, so packets forging array sizes cannot make it run for long.
+* A parse going over a limit fails with WorkBudgetExceeded.
+*/
+struct WorkBudget
+{
+    // Nesting depth of the layout, fixed by its fields and checked once per parse
+    size_t maxDepth = SIZE_MAX;
+
+    // Array elements parsed by a parse, elements of nested arrays included
+    size_t maxElements = SIZE_MAX;
+
+    // Setter calls made by a parse
+    size_t maxSetterCalls = SIZE_MAX;
+};
+
+// =============================================================================
+// Internet checksum
+// =============================================================================
+
+/**
+* Ones' complement sum of data viewed as 16-bit words, as used by the internet checksum (RFC 1071)
+*
+* @param data Pointer to the summed bytes
+* @param length Number of summed bytes
+* @param oddOffset True when the first byte sits at an odd offset of the checksummed packet
+* @note Words are loaded in host order, so the sum can be compared to a checksum loaded the same way
+*/
+inline uint16_t onesComplementSum(const unsigned char* data, size_t length, bool oddOffset = false)
+{
+    uint64_t sum = 0;
+    size_t i = 0;
+
+    if (oddOffset && length > 0)
+    {
+        const unsigned char word[2] = {0, data[0]};
+        sum += loadUnaligned<uint16_t>(word);
+        i = 1;
+    }
+
+    for (; i + 1 < length; i += 2)
+        sum += loadUnaligned<uint16_t>(&data[i]);
+
+    if (i < length)
+    {
+        const unsigned char word[2] = {data[i], 0};
+        sum += loadUnaligned<uint16_t>(word);
+    }
+
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+
+    return static_cast<uint16_t>(sum);
+}
+
+/**
+* Computes the internet checksum of the data, to be stored in host order at an even offset
+*/
+inline uint16_t internetChecksum(const unsigned char* data, size_t length)
+{
+    return static_cast<uint16_t>(~onesComplementSum(data, length));
+}
+
+// =============================================================================
+// Frame
+// =============================================================================
+
+/**
+* Struct locating a packet in memory
+*/
+struct Frame
+{
+    const unsigned char* data;
+    size_t length;
+};
+
+/**
+* Struct holding the outcome of the parsing of a frame
+*/
+struct ParseResult
+{
+    PacketParserErrorId error;
+
+    // Number of bytes consumed by the parser, up to the failing field on error
+    size_t length;
+};
+
+/**
+* Struct locating the field that failed to parse, built only once a packet is known to be invalid
+*/
+struct ParseDiagnostics
+{
+    PacketParserErrorId error;
+
+    // Offset of the failing field, or of the whole packet length without error
+    size_t offset;
+
+    // Indices leading to the failing field: "2" for the third field, "2[17]" for the 18th element of its array,
+    // "2[17].0" for the first subfield of that element
+    std::string fieldPath;
+
+    // For ExceededDataRange, bytes the failing field needs from its offset and bytes left there, 0 otherwise
+    size_t neededBytes;
+    size_t availableBytes;
+};
+
+/**
+* Non-owning view over contiguous objects, standing in for std::span until C++20
+*/
+template <class T>
+class Span
+{
+public:
+    Span()
+        : _data(nullptr)
+        , _size(0)
+    {
+    }
+
+    Span(T* data, size_t size)
+        : _data(data)
+        , _size(size)
+    {
+    }
+
+    /**
+    * @param container Contiguous container (std::vector, std::array, C array...)
+    */
+    template <class Container, class = std::enable_if_t<!std::is_same_v<std::decay_t<Container>, Span>>>
+    Span(Container& container)
+        : _data(std::data(container))
+        , _size(std::size(container))
+    {
+    }
+
+    T* data() const { return _data; }
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    T* begin() const { return _data; }
+    T* end() const { return _data + _size; }
+    T& operator[](size_t index) const { return _data[index]; }
+
+    Span subspan(size_t offset, size_t count) const
+    {
+        return {_data + offset, count};
+    }
+
+private:
+    T* _data;
+    size_t _size;
+};
+
+/**
+* Hints the processor to load the cache line containing the address
+*/
+inline void prefetch(const void* address)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+    (void)address;
+#endif
+}
+
+// =============================================================================
+// ArrayExecutor
+// =============================================================================
+
+/**
+* Struct plugging a thread pool into a parser, so large arrays of fixed-size elements are decoded in parallel
+*
+* @note The parser calls run from the thread calling parse. Parser copies share the hook, so run may be called
+* from several threads at once, or from one of its own tasks when the parse itself runs on the pool
+* @see GenericPacketParser::makeArrayExecutor
+*/
+struct ArrayExecutor
+{
+    // Runs task(context, index) for every index in [0, taskCount) and returns once they are all done,
+    // arrays are decoded serially while it is null
+    void (*run)(void* executor, size_t taskCount, void (*task)(void* context, size_t index), void* context) = nullptr;
+    void* executor = nullptr;
+
+    // Minimum element count of an array decoded in parallel
+    size_t threshold = 65536;
+
+    // Number of ranges an array is split in, usually a few per thread so idle threads can steal
+    size_t rangeCount = 1;
+};
+
+// =============================================================================
+// FieldScanner
+// =============================================================================
+
+/**
+* Struct containing the validation logic of PacketParser without the setter calls,
+* used to locate fields in a packet without decoding them
+*/
+struct FieldScanner
+{
+    using Data = const unsigned char*;
+
+    /**
+    * Moves the offset past the field, or sets the error PacketParser::parse would report
+    *
+    * @param field Field to skip
+    * @param data Pointer to binary data
+    * @param length Length of binary data
+    * @param offset Offset of the field, receives the offset following it
+    * @param error Receives the error, scanning stops while it is set
+    */
+    template <class FieldType>
+    static void scanField(const FieldType& field, Data data, size_t length, size_t& offset, PacketParserErrorId& error)
+    {
+        if (error != PacketParserErrorId::NoError)
+            return;
+
+        // ValueField and fixed-size MultiField scanning
+        if constexpr (FieldWireSize<FieldType>::isFixed)
+        {
+            if (FieldWireSize<FieldType>::value > length - offset)
+            {
+                error = PacketParserErrorId::ExceededDataRange;
+                return;
+            }
+            offset += FieldWireSize<FieldType>::value;
+        }
+
+        // TextField scanning
+        else if constexpr (FieldType::typeId == FieldTypeId::TextField)
+        {
+            const size_t searchedLength = field.length < length - offset ? field.length : length - offset;
+            const void* nullTerminator = std::memchr(&data[offset], 0, searchedLength);
+            if (nullTerminator == nullptr)
+            {
+                error = searchedLength < field.length
+                    ? PacketParserErrorId::ExceededDataRange
+                    : PacketParserErrorId::MissingNullTerminator;
+                return;
+            }
+
+            const size_t nullTerminatorDistance = static_cast<Data>(nullTerminator) - &data[offset] + 1;
+            if (!FieldType::allowEmpty && nullTerminatorDistance == 1)
+            {
+                error = PacketParserErrorId::EmptyTextNotAllowed;
+                return;
+            }
+            offset += nullTerminatorDistance;
+        }
+
+        // BinaryField scanning
+        else if constexpr (FieldType::typeId == FieldTypeId::BinaryField)
+        {
+            using SizeType = typename FieldType::PayloadSizeType;
+            if (sizeof(SizeType) > length - offset)
+            {
+                error = PacketParserErrorId::ExceededDataRange;
+                return;
+            }
+
+            const size_t payloadSize = loadUnaligned<SizeType>(&data[offset]);
+            offset += sizeof(SizeType);
+            if (payloadSize > length - offset)
+            {
+                error = PacketParserErrorId::ExceededDataRange;
+                return;
+            }
+            offset += payloadSize;
+        }
+
+        // MultiField scanning
+        else if constexpr (FieldType::typeId == FieldTypeId::MultiField)
+        {
+            scanMultiField(field, data, length, offset, error, std::make_index_sequence<FieldType::fieldCount>());
+        }
+
+        // DynamicFieldArray scanning
+        else if constexpr (FieldType::typeId == FieldTypeId::DynamicFieldArray)
+        {
+            using SizeType = typename FieldType::ArraySizeType;
+            if (sizeof(SizeType) > length - offset)
+            {
+                error = PacketParserErrorId::ExceededDataRange;
+                return;
+            }
+
+            const size_t arraySize = loadUnaligned<SizeType>(&data[offset]);
+            offset += sizeof(SizeType);
+            scanElements(field.field, arraySize, data, length, offset, error);
+        }
+
+        // StaticFieldArray scanning
+        else if constexpr (FieldType::typeId == FieldTypeId::StaticFieldArray)
+        {
+            scanElements(field.field, field.size, data, length, offset, error);
+        }
+
+        else
+        {
+            error = PacketParserErrorId::UnhandledFieldType;
+        }
+    }
+
+    /**
+    * Moves the offset past a sequence of elements of the same field
+    */
+    template <class FieldType>
+    static void scanElements(const FieldType& field, size_t count, Data data, size_t length, size_t& offset, PacketParserErrorId& error)
+    {
+        // Fixed-size elements are skipped at once
+        if constexpr (FieldWireSize<FieldType>::isFixed)
+        {
+            if (FieldWireSize<FieldType>::value > 0 && count > (length - offset) / FieldWireSize<FieldType>::value)
+            {
+                error = PacketParserErrorId::ExceededDataRange;
+                return;
+            }
+            offset += count * FieldWireSize<FieldType>::value;
+        }
+        else
+        {
+            for (size_t i = 0; i < count && error == PacketParserErrorId::NoError; ++i)
+                scanField(field, data, length, offset, error);
+        }
+    }
+
+private:
+    template <class MultiFieldType, size_t... I>
+    static void scanMultiField(const MultiFieldType& multiField, Data data, size_t length, size_t& offset, PacketParserErrorId& error, std::index_sequence<I...>)
+    {
+        (scanField(std::get<I>(multiField.fields), data, length, offset, error), ...);
+    }
+};
+
+// =============================================================================
+// FieldDiagnoser
+// =============================================================================
+
+/**
+* Struct walking a packet like FieldScanner, stopping on the first invalid field to describe it.
+* The field path is built while unwinding from the failing field, so valid fields cost no more than a scan.
+*/
+struct FieldDiagnoser
+{
+    using Data = const unsigned char*;
+
+    /**
+    * @param fields Fields of the layout
+    * @param data Pointer to binary data
+    * @param length Length of binary data
+    * @param diagnostics Receives the first invalid field, or NoError and the offset reached
+    */
+    template <class... Fields>
+    static void diagnose(const std::tuple<Fields...>& fields, Data data, size_t length, ParseDiagnostics& diagnostics)
+    {
+        diagnostics = {PacketParserErrorId::NoError, 0, std::string(), 0, 0};
+        size_t offset = 0;
+        if (diagnoseFields(fields, data, length, offset, diagnostics, "", std::index_sequence_for<Fields...>()))
+            diagnostics.offset = offset;
+    }
+
+private:
+    template <class Tuple, size_t... I>
+    static bool diagnoseFields(const Tuple& fields, Data data, size_t length, size_t& offset, ParseDiagnostics& diagnostics, const char* separator, std::index_sequence<I...>)
+    {
+        return (diagnoseFieldAt<I>(std::get<I>(fields), data, length, offset, diagnostics, separator) && ...);
+    }
+
+    template <size_t I, class FieldType>
+    static bool diagnoseFieldAt(const FieldType& field, Data data, size_t length, size_t& offset, ParseDiagnostics& diagnostics, const char* separator)
+    {
+        if (diagnoseField(field, data, length, offset, diagnostics))
+            return true;
+
+        diagnostics.fieldPath.insert(0, separator + std::to_string(I));
+        return false;
+    }
+
+    template <class FieldType>
+    static bool diagnoseField(const FieldType& field, Data data, size_t length, size_t& offset, ParseDiagnostics& diagnostics)
+    {
+        const size_t available = length - offset;
+
+        // ValueField diagnosis
+        if constexpr (FieldType::typeId == FieldTypeId::ValueField)
+        {
+            if (sizeof(typename FieldType::ValueType) > available)
+                return fail(diagnostics, PacketParserErrorId::ExceededDataRange, offset, sizeof(typename FieldType::ValueType), available);
+            offset += sizeof(typename FieldType::ValueType);
+            return true;
+        }
+
+        // TextField diagnosis
+        else if constexpr (FieldType::typeId == FieldTypeId::TextField)
+        {
+            const size_t searchedLength = field.length < available ? field.length : available;
+            const void* nullTerminator = std::memchr(&data[offset], 0, searchedLength);
+            if (nullTerminator == nullptr)
+            {
+                return searchedLength < field.length
+                    ? fail(diagnostics, PacketParserErrorId::ExceededDataRange, offset, available + 1, available)
+                    : fail(diagnostics, PacketParserErrorId::MissingNullTerminator, offset, 0, 0);
+            }
+
+            const size_t nullTerminatorDistance = static_cast<Data>(nullTerminator) - &data[offset] + 1;
+            if (!FieldType::allowEmpty && nullTerminatorDistance == 1)
+                return fail(diagnostics, PacketParserErrorId::EmptyTextNotAllowed, offset, 0, 0);
+
+            offset += nullTerminatorDistance;
+            return true;
+        }
+
+        // BinaryField diagnosis
+        else if constexpr (FieldType::typeId == FieldTypeId::BinaryField)
+        {
+            using SizeType = typename FieldType::PayloadSizeType;
+            if (sizeof(SizeType) > available)
+                return fail(diagnostics, PacketParserErrorId::ExceededDataRange, offset, sizeof(SizeType), available);
+
+            const size_t needed = sizeof(SizeType) + loadUnaligned<SizeType>(&data[offset]);
+            if (needed > available)
+                return fail(diagnostics, PacketParserErrorId::ExceededDataRange, offset, needed, available);
+
+            offset += needed;
+            return true;
+        }
+
+        // MultiField diagnosis
+        else if constexpr (FieldType::typeId == FieldTypeId::MultiField)
+        {
+            return diagnoseFields(field.fields, data, length, offset, diagnostics, ".", std::make_index_sequence<FieldType::fieldCount>());
+        }
+
+        // DynamicFieldArray diagnosis
+        else if constexpr (FieldType::typeId == FieldTypeId::DynamicFieldArray)
+        {
+            using SizeType = typename FieldType::ArraySizeType;
+            if (sizeof(SizeType) > available)
+                return fail(diagnostics, PacketParserErrorId::ExceededDataRange, offset, sizeof(SizeType), available);
+
+            const size_t arraySize = loadUnaligned<SizeType>(&data[offset]);
+            offset += sizeof(SizeType);
+            return diagnoseElements(field.field, arraySize, data, length, offset, diagnostics);
+        }
+
+        // StaticFieldArray diagnosis
+        else if constexpr (FieldType::typeId == FieldTypeId::StaticFieldArray)
+        {
+            return diagnoseElements(field.field, field.size, data, length, offset, diagnostics);
+        }
+
+        else
+        {
+            return fail(diagnostics, PacketParserErrorId::UnhandledFieldType, offset, 0, 0);
+        }
+    }
+
+    template <class FieldType>
+    static bool diagnoseElements(const FieldType& field, size_t count, Data data, size_t length, size_t& offset, ParseDiagnostics& diagnostics)
+    {
+        size_t first = 0;
+
+        // Fixed-size elements in range are skipped at once, a forged count does not walk every element
+        if constexpr (FieldWireSize<FieldType>::isFixed && FieldWireSize<FieldType>::value > 0)
+        {
+            const size_t inRange = (length - offset) / FieldWireSize<FieldType>::value;
+            first = count < inRange ? count : inRange;
+            offset += first * FieldWireSize<FieldType>::value;
+        }
+
+        for (size_t i = first; i < count; ++i)
+        {
+            if (!diagnoseField(field, data, length, offset, diagnostics))
+            {
+                diagnostics.fieldPath.insert(0, "[" + std::to_string(i) + "]");
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool fail(ParseDiagnostics& diagnostics, PacketParserErrorId error, size_t offset, size_t needed, size_t available)
+    {
+        diagnostics.error = error;
+        diagnostics.offset = offset;
+        diagnostics.neededBytes = needed;
+        diagnostics.availableBytes = available;
+        return false;
+    }
+};
+
+// =============================================================================
+// PacketParser
+// =============================================================================
+
+/**
+* Class containing the parsing logic for the provided fields.
+*
+* @tparam Instrumentation Policy receiving per-field measures, NoInstrumentation compiles them out
+* @tparam Fields Field types to parse
+*/
+template<class Instrumentation, class... Fields>
+class BasicPacketParser
+{
+public:
+    using Data = const unsigned char*;
+    using FieldsType = std::tuple<Fields...>;
+
+    /**
+    * Number of fields in the field trees of the layout, the range of the field indices given to the instrumentation
+    */
+    static constexpr size_t fieldNodeCount = TupleNodeCount<FieldsType>::value;
+
+    /**
+    * Number of top-level fields of the layout
+    */
+    static constexpr size_t fieldCount = sizeof...(Fields);
+
+    /**
+    * Smallest wire size of the layout known from its type alone, static arrays counted with a single element
+    */
+    static constexpr size_t minWireSizeBound = TupleMinWireSize<FieldsType>::value;
+
+    /**
+    * @return Kind of a top-level field
+    */
+    static constexpr FieldTypeId fieldTypeId(size_t index)
+    {
+        constexpr FieldTypeId typeIds[] = {Fields::typeId..., FieldTypeId::ValueField};
+        return typeIds[index];
+    }
+
+    /**
+    * @tparam Fields Field types to parse
+    * @param fields Fields to parse
+    * @see GenericPackerParser::makePacketParser
+    */
+    template<class... Fields>
+    BasicPacketParser(Fields... fields)
+        : _fields(fields...)
+        , _data(nullptr)
+        , _length(0)
+        , _offset(0)
+        , _arrayExecutor()
+        , _budget()
+        , _elementCount(0)
+        , _setterCallCount(0)
+        , _minWireSize(tupleMinWireSize(_fields))
+        , _maxWireSize(tupleMaxWireSize(_fields))
+    {
+    }
+
+    /**
+    * Limits the work of each parse. Arrays are charged for all their elements before parsing them,
+    * so a forged array size fails at once.
+    *
+    * @param budget Limits, a default constructed budget removes them
+    * @note Elements decoded in parallel by the array executor charge nested arrays to their range,
+    * each range being held to the budget left when the array started
+    */
+    void setWorkBudget(WorkBudget budget)
+    {
+        _budget = budget;
+    }
+
+    /**
+    * Decodes dynamic arrays of fixed-size elements in parallel once they reach the executor threshold.
+    * Elements are decoded in per-range slots, then passed to the setter in order by the thread calling parse.
+    *
+    * @param executor Thread pool hook, a default constructed executor restores serial decoding
+    */
+    void setArrayExecutor(ArrayExecutor executor)
+    {
+        _arrayExecutor = executor;
+    }
+
+    /**
+    * @tparam OutputType Receiving output struct/class type
+    * @param data Pointer to binary data to parse
+    * @param length Length of binary data to parse
+    * @param output Reference to output struct/class
+    */
+    template <class OutputType>
+    PacketParserErrorId parse(Data data, size_t length, OutputType& output)
+    {
+        // Reset working values
+        _offset = 0;
+        _data = data;
+        _length = length;
+        _elementCount = 0;
+        _setterCallCount = TupleSetterCount<FieldsType>::value;
+        const PacketParserErrorId error = rejectUpFront(length);
+        if (error != PacketParserErrorId::NoError)
+            return error;
+
+        return processAllFields(output, std::make_index_sequence<_fieldCount>());
+    }
+
+    /**
+    * Parses a packet and, only when it is invalid, locates the failing field
+    *
+    * @tparam OutputType Receiving output struct/class type
+    * @param data Pointer to binary data to parse
+    * @param length Length of binary data to parse
+    * @param output Reference to output struct/class
+    * @param diagnostics Receives the error, the failing field and its offset
+    */
+    template <class OutputType>
+    PacketParserErrorId parse(Data data, size_t length, OutputType& output, ParseDiagnostics& diagnostics)
+    {
+        const PacketParserErrorId error = parse(data, length, output);
+        if (error == PacketParserErrorId::NoError)
+        {
+            diagnostics = {error, _offset, std::string(), 0, 0};
+            return error;
+        }
+
+        // A packet rejected before its fields are walked is described by the rejection itself
+        if (rejectUpFront(length) != PacketParserErrorId::NoError)
+        {
+            diagnostics = {error, 0, std::string(), _minWireSize, length};
+            return error;
+        }
+
+        diagnose(data, length, diagnostics);
+        diagnostics.error = error;
+        return error;
+    }
+
+    /**
+    * Locates the first invalid field of a packet without calling any setter,
+    * e.g. for a frame reported as failed by parseBatch
+    *
+    * @param data Pointer to binary data
+    * @param length Length of binary data
+    * @param diagnostics Receives the first invalid field, or NoError
+    */
+    void diagnose(Data data, size_t length, ParseDiagnostics& diagnostics) const
+    {
+        FieldDiagnoser::diagnose(_fields, data, length, diagnostics);
+    }
+
+    /**
+    * Parses a batch of frames, prefetching the frames ahead of the one being parsed
+    *
+    * @tparam PrefetchDistance Number of frames between the prefetched frame and the parsed one
+    * @tparam OutputType Receiving output struct/class type
+    * @param frames Frames to parse
+    * @param outputs Output of each frame
+    * @param results Receives the outcome of each frame, an error does not stop the batch
+    * @return Number of frames parsed without error
+    */
+    template <size_t PrefetchDistance = 4, class OutputType>
+    size_t parseBatch(Span<const Frame> frames, Span<OutputType> outputs, Span<ParseResult> results)
+    {
+        assert(((void)"Each frame needs an output and a result.", outputs.size() >= frames.size() && results.size() >= frames.size()));
+
+        size_t parsedCount = 0;
+        for (size_t i = 0; i < frames.size(); ++i)
+        {
+            if (i + PrefetchDistance < frames.size())
+            {
+                const Frame& next = frames[i + PrefetchDistance];
+                prefetch(next.data);
+                if (next.length > cacheLineSize)
+                    prefetch(next.data + cacheLineSize);
+                prefetch(&outputs[i + PrefetchDistance]);
+            }
+
+            const PacketParserErrorId error = parse(frames[i].data, frames[i].length, outputs[i]);
+            // On error, the offset may point past the frame end
+            results[i] = {error, _offset < frames[i].length ? _offset : frames[i].length};
+            parsedCount += error == PacketParserErrorId::NoError ? 1 : 0;
+        }
+        return parsedCount;
+    }
+
+    /**
+    * Number of packets decoded together by parseFixedBatch
+    */
+    static constexpr size_t fixedBatchLanes = 16;
+
+    /**
+    * Parses a batch of packets made only of value fields, one field at a time across packets:
+    * the field is gathered from every packet, byte swapped in SIMD lanes and passed to the setters.
+    *
+    * @tparam OutputType Receiving output struct/class type
+    * @param frames Frames to parse
+    * @param outputs Output of each frame
+    * @param results Receives the outcome of each frame, an error does not stop the batch
+    * @return Number of frames parsed without error
+    * @note Setters are called field by field over groups of fixedBatchLanes packets rather than packet by packet.
+    * Frames shorter than the layout are reported as ExceededDataRange and their outputs left untouched.
+    */
+    template <class OutputType>
+    size_t parseFixedBatch(Span<const Frame> frames, Span<OutputType> outputs, Span<ParseResult> results)
+    {
+        static_assert(((Fields::typeId == FieldTypeId::ValueField) && ...), "Only layouts made of value fields can be parsed in lanes");
+        assert(((void)"Each frame needs an output and a result.", outputs.size() >= frames.size() && results.size() >= frames.size()));
+
+        size_t parsedCount = 0;
+        for (size_t first = 0; first < frames.size(); first += fixedBatchLanes)
+        {
+            const size_t last = first + fixedBatchLanes < frames.size() ? first + fixedBatchLanes : frames.size();
+
+            // Lanes of the valid frames of the group
+            size_t lanes[fixedBatchLanes];
+            size_t laneCount = 0;
+            for (size_t i = first; i < last; ++i)
+            {
+                const bool valid = frames[i].length >= fixedPrefixLength;
+                results[i] = valid
+                    ? ParseResult{PacketParserErrorId::NoError, fixedPrefixLength}
+                    : ParseResult{PacketParserErrorId::ExceededDataRange, frames[i].length};
+                lanes[laneCount] = i;
+                laneCount += valid ? 1 : 0;
+            }
+
+            processFieldLanes(frames, outputs, lanes, laneCount, std::make_index_sequence<_fieldCount>());
+            parsedCount += laneCount;
+        }
+        return parsedCount;
+    }
+
+    /**
+    * Number of leading fields located at a compile-time offset
+    */
+    static constexpr size_t fixedFieldCount = FixedLayout<Fields...>::fixedFieldCount();
+
+    /**
+    * Length of the leading fields located at a compile-time offset
+    */
+    static constexpr size_t fixedPrefixLength = FixedLayout<Fields...>::offset(fixedFieldCount);
+
+    /**
+    * Offset of a field preceded only by fixed-size fields
+    */
+    template <size_t FieldIndex>
+    static constexpr size_t fieldOffset()
+    {
+        static_assert(FieldIndex <= fixedFieldCount, "Field is preceded by a field of variable size");
+        return FixedLayout<Fields...>::offset(FieldIndex);
+    }
+
+    template <size_t FieldIndex>
+    using FieldValueType = typename std::tuple_element_t<FieldIndex, std::tuple<Fields...>>::ValueType;
+
+    /**
+    * Reads a value field located at a compile-time offset with a single load
+    *
+    * @tparam FieldIndex Index of a value field preceded only by fixed-size fields
+    * @param data Pointer to a packet of at least fixedPrefixLength bytes
+    */
+    template <size_t FieldIndex>
+    static FieldValueType<FieldIndex> peek(Data data)
+    {
+        using FieldType = std::tuple_element_t<FieldIndex, std::tuple<Fields...>>;
+        static_assert(FieldType::typeId == FieldTypeId::ValueField, "Only value fields can be peeked");
+        return applyEndianness<FieldType>(loadUnaligned<FieldValueType<FieldIndex>>(&data[fieldOffset<FieldIndex>()]));
+    }
+
+    /**
+    * Decodes a value field of many packets into a contiguous column, byte swapped in SIMD lanes
+    *
+    * @tparam FieldIndex Index of a value field preceded only by fixed-size fields
+    * @param frames Frames of at least fixedPrefixLength bytes
+    * @param column Receives the value of each frame, in host order
+    */
+    template <size_t FieldIndex>
+    static void gatherField(Span<const Frame> frames, FieldValueType<FieldIndex>* column)
+    {
+        using FieldType = std::tuple_element_t<FieldIndex, std::tuple<Fields...>>;
+        static_assert(FieldType::typeId == FieldTypeId::ValueField, "Only value fields can be gathered");
+        constexpr size_t offset = fieldOffset<FieldIndex>();
+
+        for (size_t i = 0; i < frames.size(); ++i)
+            column[i] = loadUnaligned<FieldValueType<FieldIndex>>(&frames[i].data[offset]);
+
+        if constexpr (FieldType::invertEndianness)
+            swapLanes(column, frames.size());
+    }
+
+    /**
+    * Overwrites a value field located at a compile-time offset with a single store
+    *
+    * @tparam FieldIndex Index of a value field preceded only by fixed-size fields
+    * @param data Pointer to a packet of at least fixedPrefixLength bytes
+    * @param value New value of the field, in host order
+    */
+    template <size_t FieldIndex>
+    static void patch(unsigned char* data, const FieldValueType<FieldIndex> value)
+    {
+        using FieldType = std::tuple_element_t<FieldIndex, std::tuple<Fields...>>;
+        static_assert(FieldType::typeId == FieldTypeId::ValueField, "Only value fields can be patched");
+        storeUnaligned(&data[fieldOffset<FieldIndex>()], applyEndianness<FieldType>(value));
+    }
+
+    /**
+    * Overwrites a value field and incrementally updates an internet checksum covering it (RFC 1624)
+    *
+    * @tparam FieldIndex Index of a value field preceded only by fixed-size fields
+    * @tparam ChecksumFieldIndex Index of a 16-bit value field at an even compile-time offset
+    * @param data Pointer to a packet of at least fixedPrefixLength bytes
+    * @param value New value of the field, in host order
+    */
+    template <size_t FieldIndex, size_t ChecksumFieldIndex>
+    static void patchWithChecksum(unsigned char* data, const FieldValueType<FieldIndex> value)
+    {
+        static_assert(FieldIndex != ChecksumFieldIndex, "The checksum field cannot be patched with itself");
+        static_assert(sizeof(FieldValueType<ChecksumFieldIndex>) == 2, "Checksum field must be 16 bits wide");
+        static_assert(fieldOffset<ChecksumFieldIndex>() % 2 == 0, "Checksum field must be at an even offset");
+
+        constexpr size_t offset = fieldOffset<FieldIndex>();
+        constexpr size_t length = sizeof(FieldValueType<FieldIndex>);
+        unsigned char* const field = &data[offset];
+        unsigned char* const checksum = &data[fieldOffset<ChecksumFieldIndex>()];
+
+        // HC' = ~(~HC + ~m + m')
+        const uint16_t oldSum = onesComplementSum(field, length, offset % 2 != 0);
+        patch<FieldIndex>(data, value);
+        const uint16_t newSum = onesComplementSum(field, length, offset % 2 != 0);
+
+        uint32_t sum = static_cast<uint16_t>(~loadUnaligned<uint16_t>(checksum));
+        sum += static_cast<uint16_t>(~oldSum);
+        sum += newSum;
+        while (sum >> 16)
+            sum = (sum & 0xffff) + (sum >> 16);
+
+        storeUnaligned(checksum, static_cast<uint16_t>(~sum));
+    }
+
+    /**
+    * @return Fields parsed by this parser
+    * @see GenericPackerParser::makePacketWriter
+    */
+    const std::tuple<Fields...>& fields() const
+    {
+        return _fields;
+    }
+
+    /**
+    * @return Limits of each parse
+    * @see setWorkBudget
+    */
+    const WorkBudget& workBudget() const
+    {
+        return _budget;
+    }
+
+    /**
+    * Checks what is known of a packet before walking its fields: its length and the fixed part of the work budget
+    *
+    * @param length Length of binary data
+    * @return Error a parse rejects the packet with before any field is parsed, or NoError
+    */
+    PacketParserErrorId rejectUpFront(size_t length) const
+    {
+        if (length < _minWireSize)
+            return PacketParserErrorId::ExceededDataRange;
+
+        if (TupleDepth<FieldsType>::value() > _budget.maxDepth || TupleSetterCount<FieldsType>::value > _budget.maxSetterCalls)
+            return PacketParserErrorId::WorkBudgetExceeded;
+
+        return PacketParserErrorId::NoError;
+    }
+
+    /**
+    * @return Smallest wire size of a valid packet, shorter packets being rejected before any field is parsed
+    */
+    size_t minWireSize() const
+    {
+        return _minWireSize;
+    }
+
+    /**
+    * @return Largest wire size of a valid packet, e.g. to size receive buffers, SIZE_MAX when it is unbounded
+    * @note Binary fields and dynamic arrays are bounded by the largest value of their size prefix
+    */
+    size_t maxWireSize() const
+    {
+        return _maxWireSize;
+    }
+
+private:
+    const static size_t _fieldCount = sizeof...(Fields);
+    const static size_t cacheLineSize = 64;
+    std::tuple<Fields...> _fields;
+    Data _data;
+    size_t _length;
+    size_t _offset;
+    ArrayExecutor _arrayExecutor;
+    WorkBudget _budget;
+    size_t _elementCount;
+    size_t _setterCallCount;
+    size_t _minWireSize;
+    size_t _maxWireSize;
+
+    template <class OutputType, size_t... I>
+    void processFieldLanes(Span<const Frame> frames, Span<OutputType> outputs, const size_t* lanes, size_t laneCount, std::index_sequence<I...>)
+    {
+        (processFieldLane<I>(frames, outputs, lanes, laneCount), ...);
+    }
+
+    template <size_t FieldIndex, class OutputType>
+    void processFieldLane(Span<const Frame> frames, Span<OutputType> outputs, const size_t* lanes, size_t laneCount)
+    {
+        using FieldType = std::tuple_element_t<FieldIndex, std::tuple<Fields...>>;
+        using ValueType = FieldValueType<FieldIndex>;
+        constexpr size_t offset = fieldOffset<FieldIndex>();
+
+        // Gather the field of every packet
+        ValueType values[fixedBatchLanes];
+        for (size_t k = 0; k < laneCount; ++k)
+            values[k] = loadUnaligned<ValueType>(&frames[lanes[k]].data[offset]);
+
+        if constexpr (FieldType::invertEndianness)
+            swapLanes(values, laneCount);
+
+        // Scatter to the outputs
+        const auto setter = std::get<FieldIndex>(_fields).setter;
+        for (size_t k = 0; k < laneCount; ++k)
+            (outputs[lanes[k]].*setter)(values[k]);
+    }
+
+    template <class OutputType, size_t... I>
+    PacketParserErrorId processAllFields(OutputType& output, std::index_sequence<I...>)
+    {
+        // Process all fields
+        PacketParserErrorId error = PacketParserErrorId::NoError;
+        (processField<nodeOf<FieldsType, I, 0>()>(output, std::get<I>(_fields), error), ...);
+        return error;
+    }
+
+    /**
+    * Depth-first index of the field I of a tuple of fields, always 0 when instrumentation is disabled
+    * so that fields of the same type share their instantiations as without instrumentation
+    */
+    template <class Tuple, size_t I, size_t First>
+    static constexpr size_t nodeOf()
+    {
+        if constexpr (Instrumentation::enabled)
+            return tupleFieldNode<Tuple, I, First>();
+        else
+            return 0;
+    }
+
+    template <size_t Node, class OutputType, class FieldType>
+    void processField(OutputType& output, FieldType& field, PacketParserErrorId& error)
+    {
+        // Keep processing fields as long as they are valid
+        if (error != PacketParserErrorId::NoError)
+            return;
+
+        if constexpr (Instrumentation::enabled)
+        {
+            const size_t offset = _offset;
+            const uint64_t begin = Instrumentation::begin();
+            processBinary<Node>(output, field, error);
+            Instrumentation::template end<BasicPacketParser>(Node, _offset - offset, begin);
+        }
+        else
+        {
+            processBinary<Node>(output, field, error);
+        }
+    }
+
+    template <size_t Node, class OutputType, class FieldType>
+    void processBinary(OutputType& output, FieldType& field, PacketParserErrorId& error)
+    {
+        using ValueType = FieldType:: template ValueType;
+
+        // ValueField parsing
+        if constexpr (FieldType::typeId == FieldTypeId::ValueField)
+        {
+            // Checked before reading, a truncated packet must not be read past its end
+            if (field.length > _length - _offset)
+            {
+                error = PacketParserErrorId::ExceededDataRange;
+                return;
+            }
+
+            // Call the output setter depending on endianness
+            if(FieldType::invertEndianness)
+                (output.*(field.setter))(EndiannessInverter<ValueType>::call(loadUnaligned<ValueType>(&_data[_offset])));
+            else
+                (output.*(field.setter))(loadUnaligned<ValueType>(&_data[_offset]));
+
+            _offset += field.length;
+            return;
+        }
+
+        // TextField parsing
+        else if constexpr (FieldType::typeId == FieldTypeId::TextField && HasInterner<FieldType>::value)
+        {
+            // Hashed while looking for the terminator, then interned
+            const size_t available = field.length < _length - _offset ? field.length : _length - _offset;
+            size_t textLength = 0;
+            uint64_t hash = 0;
+            if (!scanText(&_data[_offset], available, textLength, hash))
+            {
+                error = available < field.length
+                    ? PacketParserErrorId::ExceededDataRange
+                    : PacketParserErrorId::MissingNullTerminator;
+                return;
+            }
+
+            if (!field.allowEmpty && textLength == 0)
+            {
+                error = PacketParserErrorId::EmptyTextNotAllowed;
+                return;
+            }
+
+            (output.*(field.setter))(field.interner->intern(reinterpret_cast<const char*>(&_data[_offset]), textLength, hash));
+            _offset += textLength + 1;
+            return;
+        }
+        else if constexpr (FieldType::typeId == FieldTypeId::TextField)
+        {
+            size_t nullTerminatorDistance = 0;
+            if (!rangeContainsNullTerminator(_offset, _offset + field.length, nullTerminatorDistance, error))
+            {
+                // Avoid potentially overwriting an error set by the rangeContainsNullTerminator call
+                error = error == PacketParserErrorId::NoError
+                    ? PacketParserErrorId::MissingNullTerminator
+                    : error;
+                return;
+            }
+
+            if (!field.allowEmpty && nullTerminatorDistance == 1)
+            {
+                error = PacketParserErrorId::EmptyTextNotAllowed;
+                return;
+            }
+
+            // Call the output setter
+            (output.*(field.setter))((const ValueType)(&_data[_offset]));
+
+            // Update field length to increment _offset correctly
+            _offset += nullTerminatorDistance;
+
+            return;
+        }
+
+        // Binary parsing
+        else if constexpr (FieldType::typeId == FieldTypeId::BinaryField)
+        {
+            // Decode binary data size
+            using SizeType = FieldType:: template PayloadSizeType;
+            if (sizeof(SizeType) > _length - _offset)
+            {
+                error = PacketParserErrorId::ExceededDataRange;
+                return;
+            }
+
+            SizeType payloadSize = loadUnaligned<SizeType>(&_data[_offset]);
+
+            _offset += sizeof(SizeType);
+            if ((_offset + payloadSize) > _length)
+            {
+                error = PacketParserErrorId::ExceededDataRange;
+                return;
+            }
+
+            // Call the output setter
+            (output.*(field.setter))((const ValueType)(&_data[_offset]), payloadSize);
+
+            // Update field length to increment _offset correctly
             _offset += payloadSize;
 
             return;
@@ -475,8 +2217,12 @@ private:
         // MultiField parsing
         else if constexpr (FieldType::typeId == FieldTypeId::MultiField)
         {
-            ValueType intermediaryOutput;
-            PacketParserErrorId intermediaryError = processMultiField(intermediaryOutput, field, std::make_index_sequence<field.fieldCount>());
+            // Trivially copyable outputs are zeroed with their padding, which the compiler otherwise
+            // sees as read when a setter is called through a member function pointer
+            ValueType intermediaryOutput{};
+            if constexpr (std::is_trivially_copyable_v<ValueType>)
+                std::memset(static_cast<void*>(&intermediaryOutput), 0, sizeof(ValueType));
+            PacketParserErrorId intermediaryError = processMultiField<Node>(intermediaryOutput, field, std::make_index_sequence<field.fieldCount>());
 
             if (intermediaryError != PacketParserErrorId::NoError)
             {
@@ -494,18 +2240,43 @@ private:
         {
             // Decode array size
             using SizeType = FieldType:: template ArraySizeType;
-            SizeType arraySize = (*(reinterpret_cast<const SizeType*>(&_data[_offset])));
+            if (sizeof(SizeType) > _length - _offset)
+            {
+                error = PacketParserErrorId::ExceededDataRange;
+                return;
+            }
 
+            SizeType arraySize = loadUnaligned<SizeType>(&_data[_offset]);
             _offset += sizeof(SizeType);
-            if (_offset > _length)
+
+            using ElementFieldType = typename FieldType::ArrayFieldType;
+            if (!chargeElements<ElementFieldType>(arraySize))
             {
-                error = PacketParserErrorId::ExceededDataRange;
+                error = PacketParserErrorId::WorkBudgetExceeded;
                 return;
             }
 
-            // Process whole array
-            for (size_t i = 0; i < arraySize; ++i)
-                processField(output, field.field, error);
+            // Process whole array, in parallel past the executor threshold
+            if (_arrayExecutor.run != nullptr && arraySize >= _arrayExecutor.threshold)
+            {
+                // Fixed-size elements are located by their index, once they are known to be in range
+                if constexpr (FieldWireSize<ElementFieldType>::isFixed)
+                {
+                    if (FieldWireSize<ElementFieldType>::value > 0 && arraySize <= (_length - _offset) / FieldWireSize<ElementFieldType>::value
+                        && processArrayInParallel<nodeOf<std::tuple<ElementFieldType>, 0, Node + 1>()>(output, field.field, arraySize, nullptr))
+                        return;
+                }
+
+                // Records of variable size are located by a scan first
+                else if constexpr (ElementFieldType::typeId == FieldTypeId::MultiField)
+                {
+                    if (processRecordsInParallel<nodeOf<std::tuple<ElementFieldType>, 0, Node + 1>()>(output, field.field, arraySize))
+                        return;
+                }
+            }
+
+            for (size_t i = 0; i < arraySize && error == PacketParserErrorId::NoError; ++i)
+                processField<nodeOf<std::tuple<ElementFieldType>, 0, Node + 1>()>(output, field.field, error);
 
             return;
         }
@@ -519,9 +2290,16 @@ private:
                 return;
             }
 
+            using ElementFieldType = typename FieldType::ArrayFieldType;
+            if (!chargeElements<ElementFieldType>(field.size))
+            {
+                error = PacketParserErrorId::WorkBudgetExceeded;
+                return;
+            }
+
             // Process whole array
-            for (size_t i = 0; i < field.size; ++i)
-                processField(output, field.field, error);
+            for (size_t i = 0; i < field.size && error == PacketParserErrorId::NoError; ++i)
+                processField<nodeOf<std::tuple<ElementFieldType>, 0, Node + 1>()>(output, field.field, error);
 
             return;
         }
@@ -529,11 +2307,153 @@ private:
         error = PacketParserErrorId::UnhandledFieldType;
     }
 
-    template <class IntermediaryOutputType, class MultiFieldType, size_t... I>
+    /**
+    * Charges the elements of an array and their setter calls to the work budget
+    *
+    * @return False if the budget is exceeded
+    */
+    template <class ElementFieldType>
+    bool chargeElements(size_t count)
+    {
+        if (count > _budget.maxElements - _elementCount)
+            return false;
+        _elementCount += count;
+
+        constexpr size_t setterCalls = FieldSetterCount<ElementFieldType>::value;
+        if (setterCalls > 0 && count > (_budget.maxSetterCalls - _setterCallCount) / setterCalls)
+            return false;
+        _setterCallCount += count * setterCalls;
+        return true;
+    }
+
+    /**
+    * Decodes ranges of an array on the executor, then stitches the elements to the output in order
+    *
+    * @param offsets Offset of each element followed by the end of the array, null for fixed-size elements
+    * @return False, before any setter call, if an element fails to decode
+    */
+    template <size_t Node, class OutputType, class ElementFieldType>
+    bool processArrayInParallel(OutputType& output, ElementFieldType& element, size_t arraySize, const size_t* offsets)
+    {
+        using SlotType = typename ElementFieldType::ValueType;
+
+        struct Job
+        {
+            const BasicPacketParser* parser;
+            ElementFieldType* element;
+            SlotType* slots;
+            PacketParserErrorId* errors;
+            const size_t* offsets;
+            size_t arraySize;
+            size_t rangeCount;
+        };
+
+        const size_t rangeCount = _arrayExecutor.rangeCount < arraySize ? _arrayExecutor.rangeCount : arraySize;
+        std::vector<SlotType> slots(arraySize);
+        std::vector<PacketParserErrorId> errors(rangeCount > 0 ? rangeCount : 1, PacketParserErrorId::NoError);
+        Job job{this, &element, slots.data(), errors.data(), offsets, arraySize, errors.size()};
+
+        _arrayExecutor.run(_arrayExecutor.executor, job.rangeCount, [](void* context, size_t range)
+        {
+            const Job& job = *static_cast<const Job*>(context);
+            const size_t first = job.arraySize * range / job.rangeCount;
+            const size_t last = job.arraySize * (range + 1) / job.rangeCount;
+
+            // Each range works on its own copy of the working values, nested arrays are decoded serially
+            BasicPacketParser parser(*job.parser);
+            parser._arrayExecutor = ArrayExecutor();
+            if constexpr (FieldWireSize<ElementFieldType>::isFixed)
+                parser._offset += first * FieldWireSize<ElementFieldType>::value;
+            else
+                parser._offset = job.offsets[first];
+
+            for (size_t i = first; i < last && job.errors[range] == PacketParserErrorId::NoError; ++i)
+                parser.template decodeElement<Node>(*job.element, job.slots[i], job.errors[range]);
+        }, &job);
+
+        for (PacketParserErrorId error : errors)
+        {
+            if (error != PacketParserErrorId::NoError)
+                return false;
+        }
+
+        for (SlotType& slot : slots)
+            (output.*(element.setter))(slot);
+
+        if constexpr (FieldWireSize<ElementFieldType>::isFixed)
+            _offset += arraySize * FieldWireSize<ElementFieldType>::value;
+        else
+            _offset = offsets[arraySize];
+
+        return true;
+    }
+
+    /**
+    * Two-phase decoding of records of variable size: a sequential scan locates them, then they are decoded in parallel
+    *
+    * @return False, before any setter call, if a record is invalid
+    */
+    template <size_t Node, class OutputType, class ElementFieldType>
+    bool processRecordsInParallel(OutputType& output, ElementFieldType& element, size_t arraySize)
+    {
+        // Records of variable size take at least one byte, larger counts cannot be valid
+        if (arraySize > _length - _offset)
+            return false;
+
+        // Phase one, text terminators are searched with memchr which is vectorized by the C library
+        std::vector<size_t> offsets(arraySize + 1);
+        PacketParserErrorId error = PacketParserErrorId::NoError;
+        size_t offset = _offset;
+        for (size_t i = 0; i < arraySize && error == PacketParserErrorId::NoError; ++i)
+        {
+            offsets[i] = offset;
+            FieldScanner::scanField(element, _data, _length, offset, error);
+        }
+
+        if (error != PacketParserErrorId::NoError)
+            return false;
+        offsets[arraySize] = offset;
+
+        // Phase two
+        return processArrayInParallel<Node>(output, element, arraySize, offsets.data());
+    }
+
+    template <size_t Node, class ElementFieldType>
+    void decodeElement(ElementFieldType& element, typename ElementFieldType::ValueType& slot, PacketParserErrorId& error)
+    {
+        if constexpr (Instrumentation::enabled)
+        {
+            const size_t offset = _offset;
+            const uint64_t begin = Instrumentation::begin();
+            decodeElementData<Node>(element, slot, error);
+            Instrumentation::template end<BasicPacketParser>(Node, _offset - offset, begin);
+        }
+        else
+        {
+            decodeElementData<Node>(element, slot, error);
+        }
+    }
+
+    template <size_t Node, class ElementFieldType>
+    void decodeElementData(ElementFieldType& element, typename ElementFieldType::ValueType& slot, PacketParserErrorId& error)
+    {
+        if constexpr (ElementFieldType::typeId == FieldTypeId::ValueField)
+        {
+            using ValueType = typename ElementFieldType::ValueType;
+            slot = applyEndianness<ElementFieldType>(loadUnaligned<ValueType>(&_data[_offset]));
+            _offset += sizeof(ValueType);
+        }
+        else
+        {
+            error = processMultiField<Node>(slot, element, std::make_index_sequence<ElementFieldType::fieldCount>());
+        }
+    }
+
+    template <size_t Node, class IntermediaryOutputType, class MultiFieldType, size_t... I>
     PacketParserErrorId processMultiField(IntermediaryOutputType& intermediaryOutput, MultiFieldType& MultiField, std::index_sequence<I...>)
     {
         PacketParserErrorId error = PacketParserErrorId::NoError;
-        (processField(intermediaryOutput, std::get<I>(MultiField.fields), error), ...);
+        (processField<nodeOf<typename MultiFieldType::FieldsType, I, Node + 1>()>(intermediaryOutput, std::get<I>(MultiField.fields), error), ...);
         return error;
     }
 
@@ -542,7 +2462,7 @@ private:
         nullTerminatorDistance = 0;
         for (size_t i = beginOffset; i < endOffset; ++i)
         {
-            if (i > _length)
+            if (i >= _length)
             {
                 error = PacketParserErrorId::ExceededDataRange;
                 return false;
@@ -556,6 +2476,14 @@ private:
     }
 };
 
+/**
+* Parser of the provided fields without instrumentation
+*
+* @tparam Fields Field types to parse
+*/
+template<class... Fields>
+using PacketParser = BasicPacketParser<NoInstrumentation, Fields...>;
+
 // =============================================================================
 // Utilities
 // =============================================================================
@@ -624,10 +2552,38 @@ StaticFieldArray<FieldType> makeStaticFieldArray(size_t length, FieldType field)
 
 #define STATIC_ARRAY(size, field) makeStaticFieldArray(size, field)
 
+template <class FieldType, class GetterSignature>
+FieldWithGetter<FieldType, GetterSignature> makeFieldWithGetter(FieldType field, GetterSignature getter)
+{
+    return {field, getter};
+}
+
+#define WITH_GETTER(field, getter) makeFieldWithGetter(field, getter)
+
+template <class TextFieldType, class Interner>
+InternedTextField<TextFieldType, Interner> makeInternedTextField(TextFieldType field, Interner& interner)
+{
+    return {field, interner};
+}
+
+#define INTERNED_TEXT(field, interner) makeInternedTextField(field, interner)
+
 template <class... Fields>
 PacketParser<Fields...> makePacketParser(Fields... fields)
 {
     return {fields...};
 }
 
+/**
+* Builds a parser reporting per-field measures to an instrumentation policy
+*
+* @tparam Instrumentation Policy receiving the measures, e.g. makeBasicPacketParser<FieldInstrumentation>(fields...)
+* @param fields Fields to parse
+*/
+template <class Instrumentation, class... Fields>
+BasicPacketParser<Instrumentation, Fields...> makeBasicPacketParser(Fields... fields)
+{
+    return {fields...};
+}
+
 } // namespace GenericPacketParser
@@ -0,0 +1,337 @@
+#pragma once
+
+#include "fieldinstrumentation.h"
+#include "perthread.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace GenericPacketParser
+{
+
+// =============================================================================
+// TscClock
+// =============================================================================
+
+/**
+* Clock reading the time stamp counter, calibrated once against the steady clock.
+*
+* Ticks are converted to nanoseconds only when reporting, so timing a packet costs two counter reads.
+* Without an x86 time stamp counter, ticks are steady clock nanoseconds.
+*/
+class TscClock
+{
+public:
+    static uint64_t now()
+    {
+        return readCycles();
+    }
+
+    /**
+    * @return Nanoseconds per tick, measured on the first call
+    */
+    static double nanosecondsPerTick()
+    {
+        static const double ratio = calibrate();
+        return ratio;
+    }
+
+    /**
+    * @return True if the counter runs at a constant rate across frequency changes and sleep states,
+    * without which ticks are not comparable over time
+    */
+    static bool invariant()
+    {
+#if defined(_MSC_VER)
+        int registers[4];
+        __cpuid(registers, 0x80000000);
+        if (static_cast<unsigned>(registers[0]) < 0x80000007)
+            return false;
+        __cpuid(registers, 0x80000007);
+        return (registers[3] & (1 << 8)) != 0;
+#elif defined(__x86_64__) || defined(__i386__)
+        unsigned eax, ebx, ecx, edx;
+        if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0)
+            return false;
+        return (edx & (1u << 8)) != 0;
+#else
+        return true;
+#endif
+    }
+
+private:
+    static double calibrate()
+    {
+        using namespace std::chrono;
+        const steady_clock::time_point start = steady_clock::now();
+        const uint64_t startTicks = now();
+        std::this_thread::sleep_for(milliseconds(20));
+        const uint64_t endTicks = now();
+        const steady_clock::time_point end = steady_clock::now();
+
+        const double nanoseconds = static_cast<double>(duration_cast<std::chrono::nanoseconds>(end - start).count());
+        return endTicks > startTicks ? nanoseconds / static_cast<double>(endTicks - startTicks) : 1.0;
+    }
+};
+
+// =============================================================================
+// LatencySnapshot
+// =============================================================================
+
+/**
+* Histogram of latencies in ticks, added up over all threads.
+*
+* Buckets are log-linear: values below 2^subBucketBits have their own bucket, larger values share a bucket
+* with the values of the same 1 + subBucketBits most significant bits, so any value is known within 1/64.
+*/
+struct LatencySnapshot
+{
+    static constexpr size_t subBucketBits = 6;
+    static constexpr size_t subBucketCount = size_t(1) << subBucketBits;
+    static constexpr size_t bucketCount = (65 - subBucketBits) * subBucketCount;
+
+    std::vector<uint64_t> counts;
+
+    // Sum of the latencies, in ticks
+    uint64_t ticks = 0;
+
+    // Largest latency, in ticks
+    uint64_t maxTicks = 0;
+
+    double nanosecondsPerTick = 1.0;
+
+    LatencySnapshot()
+        : counts(bucketCount, 0)
+    {
+    }
+
+    uint64_t count() const
+    {
+        uint64_t count = 0;
+        for (const uint64_t bucket : counts)
+            count += bucket;
+        return count;
+    }
+
+    /**
+    * @param percentile e.g. 99.9
+    * @return Latency in nanoseconds below which the given percentage of the samples fall,
+    * as the upper bound of its bucket
+    */
+    double percentile(double percentile) const
+    {
+        const uint64_t total = count();
+        if (total == 0)
+            return 0.0;
+
+        const double clamped = std::min(std::max(percentile, 0.0), 100.0);
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(clamped / 100.0 * static_cast<double>(total) + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucketCount; ++i)
+        {
+            seen += counts[i];
+            if (seen >= rank)
+                return static_cast<double>(std::min(bucketHighest(i), maxTicks)) * nanosecondsPerTick;
+        }
+        return max();
+    }
+
+    /**
+    * @return Largest latency in nanoseconds
+    */
+    double max() const
+    {
+        return static_cast<double>(maxTicks) * nanosecondsPerTick;
+    }
+
+    /**
+    * @return Mean latency in nanoseconds
+    */
+    double mean() const
+    {
+        const uint64_t total = count();
+        return total == 0 ? 0.0 : static_cast<double>(ticks) / static_cast<double>(total) * nanosecondsPerTick;
+    }
+
+    /**
+    * Adds the samples of another snapshot, e.g. of another parser or process
+    */
+    void merge(const LatencySnapshot& other)
+    {
+        for (size_t i = 0; i < bucketCount; ++i)
+            counts[i] += other.counts[i];
+        ticks += other.ticks;
+        maxTicks = std::max(maxTicks, other.maxTicks);
+    }
+
+    /**
+    * @return Bucket of a latency in counts
+    */
+    static size_t bucketIndex(uint64_t value)
+    {
+        if (value < subBucketCount)
+            return static_cast<size_t>(value);
+
+#if defined(__GNUC__)
+        const size_t magnitude = 63 - __builtin_clzll(value);
+#else
+        size_t magnitude = 0;
+        for (uint64_t bits = value >> 1; bits != 0; bits >>= 1)
+            ++magnitude;
+#endif
+        const size_t shift = magnitude - subBucketBits;
+        return shift * subBucketCount + static_cast<size_t>(value >> shift);
+    }
+
+    /**
+    * @return Smallest latency of a bucket
+    */
+    static uint64_t bucketLowest(size_t index)
+    {
+        if (index < 2 * subBucketCount)
+            return index;
+
+        const size_t shift = index / subBucketCount - 1;
+        return static_cast<uint64_t>(index % subBucketCount + subBucketCount) << shift;
+    }
+
+    /**
+    * @return Largest latency of a bucket
+    */
+    static uint64_t bucketHighest(size_t index)
+    {
+        return index + 1 == bucketCount ? UINT64_MAX : bucketLowest(index + 1) - 1;
+    }
+};
+
+// =============================================================================
+// LatencyRecorder
+// =============================================================================
+
+/**
+* Class recording latencies into a histogram per thread, without locks nor atomic read-modify-writes.
+*
+* Snapshots add up the histograms of every thread while they keep recording. Interval snapshots
+* subtract the previous interval instead of clearing the threads' histograms, so no sample is lost.
+*/
+class LatencyRecorder
+{
+public:
+    LatencyRecorder() = default;
+    LatencyRecorder(const LatencyRecorder&) = delete;
+    LatencyRecorder& operator=(const LatencyRecorder&) = delete;
+
+    /**
+    * Records samples of the same latency
+    *
+    * @param ticks Latency in TscClock ticks
+    * @param count Number of samples
+    */
+    void record(uint64_t ticks, uint64_t count = 1)
+    {
+        Histogram& histogram = _histograms.local();
+        addOwned(histogram.counts[LatencySnapshot::bucketIndex(ticks)], count);
+        addOwned(histogram.ticks, ticks * count);
+        if (ticks > histogram.maxTicks.load(std::memory_order_relaxed))
+            histogram.maxTicks.store(ticks, std::memory_order_relaxed);
+    }
+
+    /**
+    * @return Samples recorded since the recorder was created
+    */
+    LatencySnapshot snapshot() const
+    {
+        LatencySnapshot snapshot;
+        snapshot.nanosecondsPerTick = TscClock::nanosecondsPerTick();
+        _histograms.forEach([&](const Histogram& histogram)
+        {
+            for (size_t i = 0; i < LatencySnapshot::bucketCount; ++i)
+                snapshot.counts[i] += histogram.counts[i].load(std::memory_order_relaxed);
+            snapshot.ticks += histogram.ticks.load(std::memory_order_relaxed);
+            snapshot.maxTicks = std::max(snapshot.maxTicks, histogram.maxTicks.load(std::memory_order_relaxed));
+        });
+        return snapshot;
+    }
+
+    /**
+    * @return Samples recorded since the previous call
+    * @note The maximum of an interval is the upper bound of its highest bucket, unless it is the overall maximum
+    */
+    LatencySnapshot intervalSnapshot()
+    {
+        LatencySnapshot total = snapshot();
+
+        std::lock_guard<std::mutex> lock(_intervalMutex);
+        LatencySnapshot interval = total;
+        interval.maxTicks = 0;
+        for (size_t i = 0; i < LatencySnapshot::bucketCount; ++i)
+            interval.counts[i] -= _previous.counts[i];
+        interval.ticks -= _previous.ticks;
+        for (size_t i = LatencySnapshot::bucketCount; i-- > 0;)
+        {
+            if (interval.counts[i] != 0)
+            {
+                interval.maxTicks = std::min(LatencySnapshot::bucketHighest(i), total.maxTicks);
+                break;
+            }
+        }
+
+        _previous = std::move(total);
+        return interval;
+    }
+
+private:
+    struct alignas(64) Histogram
+    {
+        std::atomic<uint64_t> counts[LatencySnapshot::bucketCount] = {};
+        std::atomic<uint64_t> ticks{0};
+        std::atomic<uint64_t> maxTicks{0};
+    };
+
+    PerThread<Histogram> _histograms;
+    std::mutex _intervalMutex;
+    LatencySnapshot _previous;
+};
+
+// =============================================================================
+// Utilities
+// =============================================================================
+
+/**
+* Parses a packet and records its latency
+*/
+template <class ParserType, class OutputType>
+PacketParserErrorId parseTimed(ParserType& parser, LatencyRecorder& recorder, const unsigned char* data, size_t length, OutputType& output)
+{
+    const uint64_t begin = TscClock::now();
+    const PacketParserErrorId error = parser.parse(data, length, output);
+    recorder.record(TscClock::now() - begin);
+    return error;
+}
+
+/**
+* Parses a batch and records the latency of each frame, as the batch latency shared out among its frames
+*
+* @return Number of frames parsed successfully
+*/
+template <class ParserType, class OutputType>
+size_t parseBatchTimed(ParserType& parser, LatencyRecorder& recorder, Span<const Frame> frames, Span<OutputType> outputs, Span<ParseResult> results)
+{
+    const uint64_t begin = TscClock::now();
+    const size_t parsed = parser.parseBatch(frames, outputs, results);
+    if (!frames.empty())
+        recorder.record((TscClock::now() - begin) / frames.size(), frames.size());
+    return parsed;
+}
+
+} // namespace GenericPacketParser
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace GenericPacketParser
+{
+
+// =============================================================================
+// MpmcQueue
+// =============================================================================
+
+/**
+* Bounded lock-free queue between any number of producer and consumer threads (Vyukov's design).
+*
+* Each cell carries a sequence number telling whether it is ready to be written or read for the
+* current lap, so producers and consumers only contend on their own position counter.
+*
+* @tparam T Copyable element type
+*/
+template <class T>
+class MpmcQueue
+{
+public:
+    /**
+    * @param capacity Minimum number of elements, rounded up to a power of two
+    */
+    explicit MpmcQueue(size_t capacity)
+        : _mask(roundUpToPowerOfTwo(capacity > 1 ? capacity : 2) - 1)
+        , _cells(new Cell[_mask + 1])
+        , _enqueuePosition(0)
+        , _dequeuePosition(0)
+    {
+        for (size_t i = 0; i <= _mask; ++i)
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    size_t capacity() const
+    {
+        return _mask + 1;
+    }
+
+    /**
+    * @return False if the queue is full
+    */
+    bool push(const T& value)
+    {
+        size_t position = _enqueuePosition.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = _cells[position & _mask];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0)
+            {
+                if (_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.value = value;
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = _enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+    * @return False if the queue is empty
+    */
+    bool pop(T& value)
+    {
+        size_t position = _dequeuePosition.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = _cells[position & _mask];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+            if (difference == 0)
+            {
+                if (_dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    value = cell.value;
+                    cell.sequence.store(position + _mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = _dequeuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    const size_t _mask;
+    const std::unique_ptr<Cell[]> _cells;
+
+    alignas(64) std::atomic<size_t> _enqueuePosition;
+    alignas(64) std::atomic<size_t> _dequeuePosition;
+
+    static size_t roundUpToPowerOfTwo(size_t value)
+    {
+        size_t power = 1;
+        while (power < value)
+            power <<= 1;
+        return power;
+    }
+};
+
+} // namespace GenericPacketParser
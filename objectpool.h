@@ -0,0 +1,147 @@
+#pragma once
+
+#include "genericpacketparser.h"
+#include "mpmcqueue.h"
+
+#include <memory>
+#include <type_traits>
+
+namespace GenericPacketParser
+{
+
+// =============================================================================
+// Reset protocol
+// =============================================================================
+
+template <class T, class = void>
+struct HasReset : std::false_type {};
+
+template <class T>
+struct HasReset<T, std::void_t<decltype(std::declval<T&>().reset())>> : std::true_type {};
+
+template <class T, class = void>
+struct HasClear : std::false_type {};
+
+template <class T>
+struct HasClear<T, std::void_t<decltype(std::declval<T&>().clear())>> : std::true_type {};
+
+/**
+* Empties an object before it is reused, keeping the capacity of its strings and vectors.
+*
+* Output classes opt in with a reset() member clearing their members, e.g. name.clear(); array.clear();
+* Classes with a clear() member, like the standard containers, are cleared. Other types are reassigned,
+* which releases their capacity.
+*/
+template <class T>
+void resetObject(T& object)
+{
+    if constexpr (HasReset<T>::value)
+        object.reset();
+    else if constexpr (HasClear<T>::value)
+        object.clear();
+    else
+        object = T();
+}
+
+// =============================================================================
+// ObjectPool
+// =============================================================================
+
+/**
+* Lock-free pool of reusable objects, reset on release.
+*
+* Objects come from a preallocated set while it lasts, then from the heap. Released objects return
+* to the pool until it holds its capacity, so once the capacity covers the objects in flight,
+* acquiring and releasing objects does not allocate.
+*
+* @tparam T Pooled type, default constructible
+*/
+template <class T>
+class ObjectPool
+{
+public:
+    /**
+    * Deleter of the pointers returned by acquire, releasing the object to its pool
+    */
+    struct Releaser
+    {
+        ObjectPool* pool;
+
+        void operator()(T* object) const
+        {
+            pool->release(object);
+        }
+    };
+
+    using Pointer = std::unique_ptr<T, Releaser>;
+
+    /**
+    * @param capacity Objects preallocated and kept by the pool
+    */
+    explicit ObjectPool(size_t capacity)
+        : _free(capacity)
+    {
+        for (size_t i = 0; i < capacity; ++i)
+            _free.push(new T());
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    /**
+    * @note Objects still acquired must be released before the pool is destroyed
+    */
+    ~ObjectPool()
+    {
+        T* object = nullptr;
+        while (_free.pop(object))
+            delete object;
+    }
+
+    /**
+    * @return An empty object, released to the pool when the pointer is destroyed
+    */
+    Pointer acquire()
+    {
+        T* object = nullptr;
+        if (!_free.pop(object))
+            object = new T();
+        return Pointer(object, Releaser{this});
+    }
+
+    /**
+    * Resets an object and returns it to the pool, or deletes it if the pool is full
+    */
+    void release(T* object)
+    {
+        resetObject(*object);
+        if (!_free.push(object))
+            delete object;
+    }
+
+private:
+    MpmcQueue<T*> _free;
+};
+
+// =============================================================================
+// Utilities
+// =============================================================================
+
+/**
+* Parses a packet into an output pulled from a pool
+*
+* @param parser Parser used
+* @param pool Pool providing the output, which goes back to it when the returned pointer is destroyed
+* @param data Pointer to binary data to parse
+* @param length Length of binary data to parse
+* @param error Receives the result of the parsing
+*/
+template <class ParserType, class OutputType>
+typename ObjectPool<OutputType>::Pointer parsePooled(ParserType& parser, ObjectPool<OutputType>& pool, const unsigned char* data, size_t length, PacketParserErrorId& error)
+{
+    typename ObjectPool<OutputType>::Pointer output = pool.acquire();
+    error = parser.parse(data, length, *output);
+    return output;
+}
+
+} // namespace GenericPacketParser
@@ -0,0 +1,204 @@
+#pragma once
+
+#include "packetwriter.h"
+
+#include <chrono>
+#include <limits>
+#include <vector>
+
+namespace GenericPacketParser
+{
+
+// =============================================================================
+// PacketBatcher
+// =============================================================================
+
+/**
+* Struct used to configure when a PacketBatcher closes a batch
+*/
+struct BatchingOptions
+{
+    // Largest datagram produced, defaults to an ethernet MTU minus the IPv4 and UDP headers
+    size_t maxBatchSize = 1472;
+
+    // Largest delay between the first message of a batch and its flush
+    std::chrono::steady_clock::duration maxDelay = std::chrono::microseconds(100);
+};
+
+/**
+* Class coalescing messages serialized by a PacketWriter into datagrams.
+*
+* A batch is laid out as the outer header, the message count and the messages,
+* so it can be parsed with the header fields followed by DYNAMIC_ARRAY(CountType, MULTI_FIELD(...)).
+*
+* @tparam WriterType PacketWriter type serializing the messages
+* @tparam CountType Type of the message count following the outer header
+*/
+template <class WriterType, class CountType = uint16_t>
+class PacketBatcher
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+    * @param writer Writer serializing the messages
+    * @param header Outer header starting every batch
+    * @param options Flush conditions
+    */
+    PacketBatcher(WriterType writer, std::vector<unsigned char> header, BatchingOptions options = {})
+        : _writer(writer)
+        , _header(std::move(header))
+        , _options(options)
+        , _used(0)
+        , _messageCount(0)
+        , _firstMessageTime()
+    {
+        assert(((void)"Batch size must fit the header, the count and a message.", _options.maxBatchSize > _header.size() + sizeof(CountType)));
+        startBatch();
+    }
+
+    /**
+    * Serializes a message at the end of the current batch, flushing it first if the message does not fit
+    *
+    * @param message Object to serialize
+    * @param now Current time, used for the delay flush condition
+    * @return ExceededDataRange if the message does not fit in an empty batch
+    */
+    template <class InputType>
+    PacketParserErrorId append(const InputType& message, Clock::time_point now = Clock::now())
+    {
+        poll(now);
+
+        size_t written = 0;
+        PacketParserErrorId error = _writer.write(message, freeSpace(), freeLength(), written);
+        if (error == PacketParserErrorId::ExceededDataRange && _messageCount > 0)
+        {
+            flush();
+            error = _writer.write(message, freeSpace(), freeLength(), written);
+        }
+
+        if (error != PacketParserErrorId::NoError)
+            return error;
+
+        if (_messageCount++ == 0)
+            _firstMessageTime = now;
+        _used += written;
+
+        if (_messageCount == std::numeric_limits<CountType>::max())
+            flush();
+
+        return PacketParserErrorId::NoError;
+    }
+
+    /**
+    * Flushes the current batch if its first message has waited for the maximum delay
+    */
+    void poll(Clock::time_point now = Clock::now())
+    {
+        if (_messageCount > 0 && now - _firstMessageTime >= _options.maxDelay)
+            flush();
+    }
+
+    /**
+    * Closes the current batch, if it holds messages, and makes it available in readyBatches
+    */
+    void flush()
+    {
+        if (_messageCount == 0)
+            return;
+
+        storeUnaligned(&_current[_header.size()], static_cast<CountType>(_messageCount));
+        _current.resize(_used);
+        _ready.push_back(std::move(_current));
+        _readySegments.push_back(makeIoVec(_ready.back().data(), _ready.back().size()));
+        startBatch();
+    }
+
+    /**
+    * @return One segment per closed batch, e.g. to fill the mmsghdr array of sendmmsg
+    * @note Segments are valid until releaseBatches is called
+    */
+    const std::vector<IoVec>& readyBatches() const
+    {
+        return _readySegments;
+    }
+
+    /**
+    * Recycles the buffers of the first closed batches once they have been sent
+    *
+    * @param count Number of sent batches, all of them by default
+    */
+    void releaseBatches(size_t count = std::numeric_limits<size_t>::max())
+    {
+        if (count > _ready.size())
+            count = _ready.size();
+
+        for (size_t i = 0; i < count; ++i)
+            _free.push_back(std::move(_ready[i]));
+
+        _ready.erase(_ready.begin(), _ready.begin() + count);
+        _readySegments.erase(_readySegments.begin(), _readySegments.begin() + count);
+    }
+
+    /**
+    * @return Number of messages in the current batch
+    */
+    size_t pendingMessages() const
+    {
+        return _messageCount;
+    }
+
+private:
+    WriterType _writer;
+    std::vector<unsigned char> _header;
+    BatchingOptions _options;
+
+    // Current batch
+    std::vector<unsigned char> _current;
+    size_t _used;
+    size_t _messageCount;
+    Clock::time_point _firstMessageTime;
+
+    // Closed and recycled batches
+    std::vector<std::vector<unsigned char>> _ready;
+    std::vector<IoVec> _readySegments;
+    std::vector<std::vector<unsigned char>> _free;
+
+    void startBatch()
+    {
+        if (!_free.empty())
+        {
+            _current = std::move(_free.back());
+            _free.pop_back();
+        }
+
+        // Recycled buffers keep their capacity, so this only allocates until enough buffers circulate
+        _current.resize(_options.maxBatchSize);
+        if (!_header.empty())
+            std::memcpy(_current.data(), _header.data(), _header.size());
+        _used = _header.size() + sizeof(CountType);
+        _messageCount = 0;
+    }
+
+    unsigned char* freeSpace()
+    {
+        return _current.data() + _used;
+    }
+
+    size_t freeLength() const
+    {
+        return _options.maxBatchSize - _used;
+    }
+};
+
+// =============================================================================
+// Utilities
+// =============================================================================
+
+template <class CountType = uint16_t, class WriterType>
+PacketBatcher<WriterType, CountType> makePacketBatcher(WriterType writer, std::vector<unsigned char> header, BatchingOptions options = {})
+{
+    return {writer, std::move(header), options};
+}
+
+} // namespace GenericPacketParser
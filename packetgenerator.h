@@ -0,0 +1,412 @@
+#pragma once
+
+#include "framefile.h"
+#include "genericpacketparser.h"
+
+#include <limits>
+#include <vector>
+
+namespace GenericPacketParser
+{
+
+// =============================================================================
+// Random numbers
+// =============================================================================
+
+/**
+* SplitMix64 generator, fast enough to produce several GB/s of random bytes
+*/
+class FastRandom
+{
+public:
+    explicit FastRandom(uint64_t seed)
+        : _state(seed)
+    {
+    }
+
+    uint64_t next()
+    {
+        uint64_t z = (_state += 0x9E3779B97F4A7C15);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+        return z ^ (z >> 31);
+    }
+
+    /**
+    * @return Uniform value in [0, 1)
+    */
+    double nextUnit()
+    {
+        return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    /**
+    * @return True with the given probability
+    */
+    bool nextBool(double probability)
+    {
+        return probability > 0 && nextUnit() < probability;
+    }
+
+    /**
+    * @return Uniform value in [min, max]
+    * @note Ranges below 2^32 use a multiplication instead of a division (Lemire's reduction)
+    */
+    size_t nextInRange(size_t min, size_t max)
+    {
+        if (max <= min)
+            return min;
+
+        const uint64_t range = static_cast<uint64_t>(max - min) + 1;
+        if (range <= UINT32_MAX)
+            return min + static_cast<size_t>(((next() >> 32) * range) >> 32);
+
+        return min + static_cast<size_t>(next() % range);
+    }
+
+private:
+    uint64_t _state;
+};
+
+// =============================================================================
+// PacketGenerator
+// =============================================================================
+
+/**
+* Struct describing the distribution of generated sizes
+*/
+struct SizeDistribution
+{
+    enum class Shape
+    {
+        // Every size in [min, max] is equally likely
+        Uniform,
+        // Sizes close to min are more likely, a few reach max
+        Skewed
+    };
+
+    size_t min;
+    size_t max;
+    Shape shape = Shape::Uniform;
+};
+
+/**
+* Struct used to configure a PacketGenerator
+*
+* @note Generated sizes are clamped to what the fields can hold
+*/
+struct GeneratorOptions
+{
+    SizeDistribution arraySize{0, 8};
+    SizeDistribution textLength{0, 32};
+    SizeDistribution binaryLength{0, 64};
+
+    // Probability of a value being written in the opposite byte order of its field
+    double swappedByteOrderRate = 0.0;
+
+    // Probability of a packet being truncated, bit flipped, stripped of a null terminator or given a forged size
+    double corruptionRate = 0.0;
+
+    uint64_t seed = 0x5EED;
+};
+
+/**
+* Class generating random packets that are structurally valid for the provided fields.
+*
+* Value magnitudes are log-uniform, so byte order matters as it does in real traffic.
+*
+* @tparam Fields Field types of the generated layout
+*/
+template <class... Fields>
+class PacketGenerator
+{
+public:
+    /**
+    * @param fields Fields of the generated layout
+    * @param options Size distributions and corruption rates
+    * @see GenericPackerParser::makePacketGenerator
+    */
+    PacketGenerator(std::tuple<Fields...> fields, GeneratorOptions options = {})
+        : _fields(fields)
+        , _options(options)
+        , _random(options.seed)
+        , _buffer(nullptr)
+        , _begin(0)
+        , _offset(0)
+    {
+    }
+
+    /**
+    * Generates one packet
+    *
+    * @param packet Receives the packet
+    * @return True if the packet was corrupted
+    */
+    bool generate(std::vector<unsigned char>& packet)
+    {
+        const bool corrupted = generatePacket(packet, 0);
+        packet.resize(_offset);
+        return corrupted;
+    }
+
+    /**
+    * Generates packets back to back in memory
+    *
+    * @param count Number of packets to generate
+    * @param data Receives the packets
+    * @param frames Receives the location of each packet in data
+    * @return Number of corrupted packets
+    */
+    size_t generateCorpus(size_t count, std::vector<unsigned char>& data, std::vector<Frame>& frames)
+    {
+        _frameOffsets.clear();
+        _frameOffsets.reserve(count + 1);
+
+        // Packets are generated back to back, the buffer is shrunk to the generated data at the end
+        size_t corrupted = 0;
+        size_t end = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            _frameOffsets.push_back(end);
+            corrupted += generatePacket(data, end) ? 1 : 0;
+            end = _offset;
+        }
+        _frameOffsets.push_back(end);
+        data.resize(end);
+
+        // Data is final, frames can point into it
+        frames.resize(count);
+        for (size_t i = 0; i < count; ++i)
+            frames[i] = {data.data() + _frameOffsets[i], _frameOffsets[i + 1] - _frameOffsets[i]};
+
+        return corrupted;
+    }
+
+    /**
+    * Generates packets to a frame file
+    *
+    * @param path Path of the created frame file
+    * @param count Number of packets to generate
+    * @param frameInterval Nanoseconds between the timestamps of consecutive frames
+    * @return False if the file could not be written
+    */
+    bool generateFrameFile(const char* path, size_t count, uint64_t frameInterval = 1000)
+    {
+        FrameFileWriter file;
+        if (!file.open(path))
+            return false;
+
+        std::vector<unsigned char> packet;
+        for (size_t i = 0; i < count; ++i)
+        {
+            generate(packet);
+            if (!file.write(i * frameInterval, packet.data(), packet.size()))
+                return false;
+        }
+        return true;
+    }
+
+private:
+    std::tuple<Fields...> _fields;
+    GeneratorOptions _options;
+    FastRandom _random;
+
+    // Working values
+    std::vector<unsigned char>* _buffer;
+    size_t _begin;
+    size_t _offset;
+    std::vector<size_t> _frameOffsets;
+
+    // Corruption targets of the current packet
+    std::vector<size_t> _nullTerminators;
+    std::vector<std::pair<size_t, size_t>> _sizePrefixes;
+
+    bool generatePacket(std::vector<unsigned char>& buffer, size_t begin)
+    {
+        // Reset working values
+        _buffer = &buffer;
+        _begin = begin;
+        _offset = begin;
+        _nullTerminators.clear();
+        _sizePrefixes.clear();
+
+        generateFields(std::make_index_sequence<sizeof...(Fields)>());
+
+        if (!_random.nextBool(_options.corruptionRate))
+            return false;
+
+        corrupt();
+        return true;
+    }
+
+    template <size_t... I>
+    void generateFields(std::index_sequence<I...>)
+    {
+        (generateField(std::get<I>(_fields)), ...);
+    }
+
+    template <class FieldType>
+    void generateField(const FieldType& field)
+    {
+        // ValueField generation
+        if constexpr (FieldType::typeId == FieldTypeId::ValueField)
+        {
+            using ValueType = typename FieldType::ValueType;
+            const uint64_t bits = _random.next();
+            ValueType value = static_cast<ValueType>(bits >> (bits & 63));
+            value = _random.nextBool(_options.swappedByteOrderRate)
+                ? EndiannessInverter<ValueType>::call(applyEndianness<FieldType>(value))
+                : applyEndianness<FieldType>(value);
+            storeUnaligned(reserve(sizeof(ValueType)), value);
+        }
+
+        // TextField generation
+        else if constexpr (FieldType::typeId == FieldTypeId::TextField)
+        {
+            size_t textLength = drawSize(_options.textLength, field.length - 1);
+            if (!FieldType::allowEmpty && textLength == 0)
+                textLength = 1;
+
+            unsigned char* text = reserve(textLength + 1);
+            fillBytes(text, textLength, 0x40);
+            text[textLength] = 0;
+            _nullTerminators.push_back(_offset - 1);
+        }
+
+        // BinaryField generation
+        else if constexpr (FieldType::typeId == FieldTypeId::BinaryField)
+        {
+            using SizeType = typename FieldType::PayloadSizeType;
+            const size_t payloadSize = drawSize(_options.binaryLength, std::numeric_limits<SizeType>::max());
+            _sizePrefixes.emplace_back(_offset, sizeof(SizeType));
+            storeUnaligned(reserve(sizeof(SizeType)), static_cast<SizeType>(payloadSize));
+            fillBytes(reserve(payloadSize), payloadSize, 0);
+        }
+
+        // MultiField generation
+        else if constexpr (FieldType::typeId == FieldTypeId::MultiField)
+        {
+            generateMultiField(field, std::make_index_sequence<FieldType::fieldCount>());
+        }
+
+        // DynamicFieldArray generation
+        else if constexpr (FieldType::typeId == FieldTypeId::DynamicFieldArray)
+        {
+            using SizeType = typename FieldType::ArraySizeType;
+            const size_t arraySize = drawSize(_options.arraySize, std::numeric_limits<SizeType>::max());
+            _sizePrefixes.emplace_back(_offset, sizeof(SizeType));
+            storeUnaligned(reserve(sizeof(SizeType)), static_cast<SizeType>(arraySize));
+            for (size_t i = 0; i < arraySize; ++i)
+                generateField(field.field);
+        }
+
+        // StaticFieldArray generation
+        else if constexpr (FieldType::typeId == FieldTypeId::StaticFieldArray)
+        {
+            for (size_t i = 0; i < field.size; ++i)
+                generateField(field.field);
+        }
+    }
+
+    template <class MultiFieldType, size_t... I>
+    void generateMultiField(const MultiFieldType& multiField, std::index_sequence<I...>)
+    {
+        (generateField(std::get<I>(multiField.fields)), ...);
+    }
+
+    size_t drawSize(const SizeDistribution& distribution, size_t limit)
+    {
+        const size_t max = distribution.max < limit ? distribution.max : limit;
+        const size_t min = distribution.min < max ? distribution.min : max;
+        if (distribution.shape == SizeDistribution::Shape::Skewed)
+        {
+            const double unit = _random.nextUnit();
+            return min + static_cast<size_t>((max - min) * unit * unit * unit + 0.5);
+        }
+        return _random.nextInRange(min, max);
+    }
+
+    /**
+    * Grows the buffer geometrically and returns the next length bytes
+    *
+    * @note The buffer is larger than the generated data until the caller shrinks it to _offset,
+    * and always has 8 bytes of slack for the word stores of fillBytes
+    */
+    unsigned char* reserve(size_t length)
+    {
+        const size_t required = _offset + length + sizeof(uint64_t);
+        if (required > _buffer->size())
+            _buffer->resize(required > 2 * _buffer->size() ? required : 2 * _buffer->size());
+
+        unsigned char* position = _buffer->data() + _offset;
+        _offset += length;
+        return position;
+    }
+
+    /**
+    * Fills random bytes, 8 at a time, with the mask bits set (0x40 gives non-null text)
+    *
+    * @note The last store may spill up to 7 bytes in the slack kept by reserve
+    */
+    void fillBytes(unsigned char* data, size_t length, unsigned char mask)
+    {
+        const uint64_t wideMask = 0x0101010101010101ull * mask;
+        for (size_t i = 0; i < length; i += 8)
+            storeUnaligned(&data[i], _random.next() | wideMask);
+    }
+
+    void corrupt()
+    {
+        const size_t length = _offset - _begin;
+        unsigned char* packet = _buffer->data() + _begin;
+
+        switch (_random.next() % 4)
+        {
+        case 0:
+            // Null terminator replaced by text
+            if (!_nullTerminators.empty())
+            {
+                (*_buffer)[_nullTerminators[_random.nextInRange(0, _nullTerminators.size() - 1)]] = 'X';
+                break;
+            }
+            [[fallthrough]];
+        case 1:
+            // Size prefix forged to its maximum
+            if (!_sizePrefixes.empty())
+            {
+                const auto& prefix = _sizePrefixes[_random.nextInRange(0, _sizePrefixes.size() - 1)];
+                std::memset(&(*_buffer)[prefix.first], 0xff, prefix.second);
+                break;
+            }
+            [[fallthrough]];
+        case 2:
+            // Random bits flipped in a random byte
+            if (length > 0)
+            {
+                packet[_random.nextInRange(0, length - 1)] ^= static_cast<unsigned char>(_random.nextInRange(1, 255));
+                break;
+            }
+            [[fallthrough]];
+        default:
+            // Packet truncated
+            if (length > 0)
+                _offset = _begin + _random.nextInRange(0, length - 1);
+            break;
+        }
+    }
+};
+
+// =============================================================================
+// Utilities
+// =============================================================================
+
+/**
+* Builds a generator from the fields of an existing parser
+*/
+template <class Instrumentation, class... Fields>
+PacketGenerator<Fields...> makePacketGenerator(const BasicPacketParser<Instrumentation, Fields...>& parser, GeneratorOptions options = {})
+{
+    return {parser.fields(), options};
+}
+
+} // namespace GenericPacketParser
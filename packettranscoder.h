@@ -0,0 +1,435 @@
+#pragma once
+
+#include "genericpacketparser.h"
+
+#include <array>
+#include <limits>
+#include <vector>
+
+namespace GenericPacketParser
+{
+
+// =============================================================================
+// Wire format comparison
+// =============================================================================
+
+template <class SourceTuple, class TargetTuple>
+struct SameWireFormatTuple;
+
+/**
+* Metafunction indicating if two fields have the same encoding, so that the bytes of
+* the first are a valid encoding of the second as long as its runtime constraints hold
+*
+* @note Text maximum lengths and static array sizes are runtime constraints
+*/
+template <class SourceFieldType, class TargetFieldType>
+constexpr bool sameWireFormat()
+{
+    if constexpr (SourceFieldType::typeId != TargetFieldType::typeId)
+        return false;
+    else if constexpr (SourceFieldType::typeId == FieldTypeId::ValueField)
+        return sizeof(typename SourceFieldType::ValueType) == sizeof(typename TargetFieldType::ValueType)
+            && (sizeof(typename SourceFieldType::ValueType) == 1 || SourceFieldType::invertEndianness == TargetFieldType::invertEndianness);
+    else if constexpr (SourceFieldType::typeId == FieldTypeId::TextField)
+        return true;
+    else if constexpr (SourceFieldType::typeId == FieldTypeId::BinaryField)
+        return sizeof(typename SourceFieldType::PayloadSizeType) == sizeof(typename TargetFieldType::PayloadSizeType);
+    else if constexpr (SourceFieldType::typeId == FieldTypeId::MultiField)
+        return SameWireFormatTuple<typename SourceFieldType::FieldsType, typename TargetFieldType::FieldsType>::value;
+    else if constexpr (SourceFieldType::typeId == FieldTypeId::DynamicFieldArray)
+        return sizeof(typename SourceFieldType::ArraySizeType) == sizeof(typename TargetFieldType::ArraySizeType)
+            && sameWireFormat<typename SourceFieldType::ArrayFieldType, typename TargetFieldType::ArrayFieldType>();
+    else if constexpr (SourceFieldType::typeId == FieldTypeId::StaticFieldArray)
+        return sameWireFormat<typename SourceFieldType::ArrayFieldType, typename TargetFieldType::ArrayFieldType>();
+    else
+        return false;
+}
+
+template <class... SourceFields, class... TargetFields>
+struct SameWireFormatTuple<std::tuple<SourceFields...>, std::tuple<TargetFields...>>
+{
+    static constexpr bool value = []
+    {
+        if constexpr (sizeof...(SourceFields) != sizeof...(TargetFields))
+            return false;
+        else
+            return (sameWireFormat<SourceFields, TargetFields>() && ...);
+    }();
+};
+
+/**
+* Metafunction giving the type of the size prefix of binary fields and dynamic arrays
+*/
+template <class FieldType, FieldTypeId TypeId = FieldType::typeId>
+struct SizePrefix;
+
+template <class FieldType>
+struct SizePrefix<FieldType, FieldTypeId::BinaryField>
+{
+    using Type = typename FieldType::PayloadSizeType;
+};
+
+template <class FieldType>
+struct SizePrefix<FieldType, FieldTypeId::DynamicFieldArray>
+{
+    using Type = typename FieldType::ArraySizeType;
+};
+
+// =============================================================================
+// PacketTranscoder
+// =============================================================================
+
+template <class SourceFields, class TargetFields, class Mapping>
+class PacketTranscoder;
+
+/**
+* Class converting packets from a source layout to a target layout without decoding them to structs.
+*
+* Each target field is encoded from the source field selected by the mapping:
+* - fields with the same encoding are copied, consecutive ones with a single copy
+* - value fields are converted between sizes and byte orders
+* - binary fields and dynamic arrays of the same elements are converted between size types
+*
+* @tparam SourceFields Field types of the source layout
+* @tparam TargetFields Field types of the target layout
+* @tparam Mapping Index of the source field of each target field
+*/
+template <class... SourceFields, class... TargetFields, size_t... Mapping>
+class PacketTranscoder<std::tuple<SourceFields...>, std::tuple<TargetFields...>, std::index_sequence<Mapping...>>
+{
+public:
+    using Data = const unsigned char*;
+
+    static_assert(sizeof...(Mapping) == sizeof...(TargetFields), "Mapping must give a source field for each target field");
+    static_assert(((Mapping < sizeof...(SourceFields)) && ...), "Mapping refers to a source field that does not exist");
+
+    /**
+    * @param sourceFields Fields of the source layout
+    * @param targetFields Fields of the target layout
+    * @see GenericPackerParser::makePacketTranscoder
+    */
+    PacketTranscoder(std::tuple<SourceFields...> sourceFields, std::tuple<TargetFields...> targetFields)
+        : _sourceFields(sourceFields)
+        , _targetFields(targetFields)
+        , _data(nullptr)
+        , _length(0)
+        , _sourceOffsets()
+        , _output(nullptr)
+        , _outputOffset(0)
+        , _copyBegin(0)
+        , _copyEnd(0)
+    {
+    }
+
+    /**
+    * @param data Pointer to the source packet
+    * @param length Length of the source packet
+    * @param output Buffer receiving the target packet, it is resized exactly once
+    */
+    PacketParserErrorId transcode(Data data, size_t length, std::vector<unsigned char>& output)
+    {
+        size_t size = 0;
+        PacketParserErrorId error = prepare(data, length, size);
+        if (error != PacketParserErrorId::NoError)
+            return error;
+
+        output.resize(size);
+        writeAllFields(output.data());
+        return PacketParserErrorId::NoError;
+    }
+
+    /**
+    * @param data Pointer to the source packet
+    * @param length Length of the source packet
+    * @param output Pointer to the buffer receiving the target packet
+    * @param capacity Length of the receiving buffer
+    * @param written Receives the length of the target packet
+    */
+    PacketParserErrorId transcode(Data data, size_t length, unsigned char* output, size_t capacity, size_t& written)
+    {
+        written = 0;
+        size_t size = 0;
+        PacketParserErrorId error = prepare(data, length, size);
+        if (error != PacketParserErrorId::NoError)
+            return error;
+
+        if (size > capacity)
+            return PacketParserErrorId::ExceededDataRange;
+
+        writeAllFields(output);
+        written = size;
+        return PacketParserErrorId::NoError;
+    }
+
+private:
+    const static size_t _sourceFieldCount = sizeof...(SourceFields);
+    const static size_t _targetFieldCount = sizeof...(TargetFields);
+    std::tuple<SourceFields...> _sourceFields;
+    std::tuple<TargetFields...> _targetFields;
+
+    // Source cursor
+    Data _data;
+    size_t _length;
+    std::array<size_t, _sourceFieldCount + 1> _sourceOffsets;
+
+    // Target writer
+    unsigned char* _output;
+    size_t _outputOffset;
+
+    // Pending bulk copy of source bytes
+    size_t _copyBegin;
+    size_t _copyEnd;
+
+    template <size_t TargetIndex>
+    using TargetFieldType = std::tuple_element_t<TargetIndex, std::tuple<TargetFields...>>;
+
+    template <size_t TargetIndex>
+    static constexpr size_t sourceIndex()
+    {
+        constexpr size_t mapping[] = {Mapping...};
+        return mapping[TargetIndex];
+    }
+
+    template <size_t TargetIndex>
+    using SourceFieldType = std::tuple_element_t<sourceIndex<TargetIndex>(), std::tuple<SourceFields...>>;
+
+    PacketParserErrorId prepare(Data data, size_t length, size_t& size)
+    {
+        // Reset working values
+        _data = data;
+        _length = length;
+
+        PacketParserErrorId error = PacketParserErrorId::NoError;
+        locateSourceFields(error, std::make_index_sequence<_sourceFieldCount>());
+        if (error != PacketParserErrorId::NoError)
+            return error;
+
+        measureAllFields(size, error, std::make_index_sequence<_targetFieldCount>());
+        return error;
+    }
+
+    // -------------------------------------------------------------------------
+    // Source cursor
+    // -------------------------------------------------------------------------
+
+    template <size_t... I>
+    void locateSourceFields(PacketParserErrorId& error, std::index_sequence<I...>)
+    {
+        size_t offset = 0;
+        ((_sourceOffsets[I] = offset, FieldScanner::scanField(std::get<I>(_sourceFields), _data, _length, offset, error)), ...);
+        _sourceOffsets[_sourceFieldCount] = offset;
+    }
+
+    // -------------------------------------------------------------------------
+    // Target size computation and validation
+    // -------------------------------------------------------------------------
+
+    template <size_t... J>
+    void measureAllFields(size_t& size, PacketParserErrorId& error, std::index_sequence<J...>)
+    {
+        (measureField<J>(size, error), ...);
+    }
+
+    template <size_t J>
+    void measureField(size_t& size, PacketParserErrorId& error)
+    {
+        using SourceType = SourceFieldType<J>;
+        using TargetType = TargetFieldType<J>;
+        constexpr size_t I = sourceIndex<J>();
+
+        if (error != PacketParserErrorId::NoError)
+            return;
+
+        const size_t begin = _sourceOffsets[I];
+        const size_t end = _sourceOffsets[I + 1];
+
+        // Same encoding, the source bytes must satisfy the target constraints
+        if constexpr (sameWireFormat<SourceType, TargetType>())
+        {
+            if constexpr (!FieldWireSize<TargetType>::isFixed)
+                validateCopy(std::get<J>(_targetFields), begin, end, error);
+
+            size += end - begin;
+        }
+
+        // ValueField conversion
+        else if constexpr (SourceType::typeId == FieldTypeId::ValueField && TargetType::typeId == FieldTypeId::ValueField)
+        {
+            if (!isRepresentable<J>(readSourceValue<J>()))
+            {
+                error = PacketParserErrorId::InvalidValue;
+                return;
+            }
+            size += sizeof(typename TargetType::ValueType);
+        }
+
+        // BinaryField size type conversion
+        else if constexpr (SourceType::typeId == FieldTypeId::BinaryField && TargetType::typeId == FieldTypeId::BinaryField)
+        {
+            using SourceSizeType = typename SourceType::PayloadSizeType;
+            using TargetSizeType = typename TargetType::PayloadSizeType;
+            const size_t payloadSize = end - begin - sizeof(SourceSizeType);
+            if (payloadSize > static_cast<size_t>(std::numeric_limits<TargetSizeType>::max()))
+            {
+                error = PacketParserErrorId::InvalidValue;
+                return;
+            }
+            size += sizeof(TargetSizeType) + payloadSize;
+        }
+
+        // DynamicFieldArray size type conversion
+        else if constexpr (SourceType::typeId == FieldTypeId::DynamicFieldArray && TargetType::typeId == FieldTypeId::DynamicFieldArray)
+        {
+            static_assert(sameWireFormat<typename SourceType::ArrayFieldType, typename TargetType::ArrayFieldType>(),
+                "Only the size type of transcoded dynamic arrays can change");
+
+            using SourceSizeType = typename SourceType::ArraySizeType;
+            using TargetSizeType = typename TargetType::ArraySizeType;
+            const size_t arraySize = loadUnaligned<SourceSizeType>(&_data[begin]);
+            if (arraySize > static_cast<size_t>(std::numeric_limits<TargetSizeType>::max()))
+            {
+                error = PacketParserErrorId::InvalidValue;
+                return;
+            }
+
+            if constexpr (!FieldWireSize<typename TargetType::ArrayFieldType>::isFixed)
+            {
+                size_t offset = begin + sizeof(SourceSizeType);
+                FieldScanner::scanElements(std::get<J>(_targetFields).field, arraySize, _data, end, offset, error);
+                if (error != PacketParserErrorId::NoError)
+                    return;
+            }
+            size += sizeof(TargetSizeType) + end - begin - sizeof(SourceSizeType);
+        }
+
+        else
+        {
+            static_assert(sameWireFormat<SourceType, TargetType>(), "Unsupported field conversion");
+        }
+    }
+
+    template <class TargetType>
+    void validateCopy(const TargetType& field, size_t begin, size_t end, PacketParserErrorId& error)
+    {
+        size_t offset = begin;
+        FieldScanner::scanField(field, _data, end, offset, error);
+        if (error == PacketParserErrorId::NoError && offset != end)
+            error = PacketParserErrorId::InvalidValue;
+    }
+
+    template <size_t J>
+    auto readSourceValue() const
+    {
+        using SourceType = SourceFieldType<J>;
+        using ValueType = typename SourceType::ValueType;
+        return applyEndianness<SourceType>(loadUnaligned<ValueType>(&_data[_sourceOffsets[sourceIndex<J>()]]));
+    }
+
+    template <size_t J, class SourceValueType>
+    static bool isRepresentable(const SourceValueType value)
+    {
+        using TargetValueType = typename TargetFieldType<J>::ValueType;
+        const TargetValueType converted = static_cast<TargetValueType>(value);
+        if constexpr (std::is_integral_v<SourceValueType> && std::is_integral_v<TargetValueType>)
+            return static_cast<SourceValueType>(converted) == value && ((value < SourceValueType{}) == (converted < TargetValueType{}));
+        else
+            return true;
+    }
+
+    // -------------------------------------------------------------------------
+    // Target serialization, the source has been validated by the size computation
+    // -------------------------------------------------------------------------
+
+    void writeAllFields(unsigned char* output)
+    {
+        // Reset working values
+        _output = output;
+        _outputOffset = 0;
+        _copyBegin = 0;
+        _copyEnd = 0;
+        writeFields(std::make_index_sequence<_targetFieldCount>());
+        flushCopy();
+    }
+
+    template <size_t... J>
+    void writeFields(std::index_sequence<J...>)
+    {
+        (writeField<J>(), ...);
+    }
+
+    template <size_t J>
+    void writeField()
+    {
+        using SourceType = SourceFieldType<J>;
+        using TargetType = TargetFieldType<J>;
+        constexpr size_t I = sourceIndex<J>();
+
+        const size_t begin = _sourceOffsets[I];
+        const size_t end = _sourceOffsets[I + 1];
+
+        // Same encoding, extend the pending copy when the source bytes follow it
+        if constexpr (sameWireFormat<SourceType, TargetType>())
+        {
+            if (_copyEnd != begin)
+            {
+                flushCopy();
+                _copyBegin = begin;
+            }
+            _copyEnd = end;
+        }
+
+        // ValueField conversion
+        else if constexpr (SourceType::typeId == FieldTypeId::ValueField)
+        {
+            using TargetValueType = typename TargetType::ValueType;
+            flushCopy();
+            storeUnaligned(&_output[_outputOffset], applyEndianness<TargetType>(static_cast<TargetValueType>(readSourceValue<J>())));
+            _outputOffset += sizeof(TargetValueType);
+        }
+
+        // BinaryField and DynamicFieldArray size conversion, followed by a copy of the content
+        else
+        {
+            using SourceSizeType = typename SizePrefix<SourceType>::Type;
+            using TargetSizeType = typename SizePrefix<TargetType>::Type;
+
+            flushCopy();
+            storeUnaligned(&_output[_outputOffset], static_cast<TargetSizeType>(loadUnaligned<SourceSizeType>(&_data[begin])));
+            _outputOffset += sizeof(TargetSizeType);
+            _copyBegin = begin + sizeof(SourceSizeType);
+            _copyEnd = end;
+        }
+    }
+
+    void flushCopy()
+    {
+        if (_copyEnd > _copyBegin)
+        {
+            std::memcpy(&_output[_outputOffset], &_data[_copyBegin], _copyEnd - _copyBegin);
+            _outputOffset += _copyEnd - _copyBegin;
+        }
+        _copyBegin = 0;
+        _copyEnd = 0;
+    }
+};
+
+// =============================================================================
+// Utilities
+// =============================================================================
+
+/**
+* Builds a transcoder from the fields of two parsers
+*
+* @tparam Mapping Index of the source field of each target field, identity when omitted
+*/
+template <size_t... Mapping, class SourceInstrumentation, class... SourceFields, class TargetInstrumentation, class... TargetFields>
+auto makePacketTranscoder(const BasicPacketParser<SourceInstrumentation, SourceFields...>& source, const BasicPacketParser<TargetInstrumentation, TargetFields...>& target)
+{
+    using MappingType = std::conditional_t<sizeof...(Mapping) == 0,
+        std::make_index_sequence<sizeof...(TargetFields)>,
+        std::index_sequence<Mapping...>>;
+
+    return PacketTranscoder<std::tuple<SourceFields...>, std::tuple<TargetFields...>, MappingType>(source.fields(), target.fields());
+}
+
+} // namespace GenericPacketParser
@@ -0,0 +1,565 @@
+#pragma once
+
+#include "genericpacketparser.h"
+
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/uio.h>
+#endif
+
+namespace GenericPacketParser
+{
+
+// =============================================================================
+// Gather segments
+// =============================================================================
+
+#if defined(_WIN32)
+/**
+* Segment of a gathering write, mirrors the POSIX iovec
+*/
+struct IoVec
+{
+    void* iov_base;
+    size_t iov_len;
+};
+#else
+using IoVec = iovec;
+#endif
+
+inline IoVec makeIoVec(const void* base, size_t length)
+{
+    IoVec segment;
+    segment.iov_base = const_cast<void*>(base);
+    segment.iov_len = length;
+    return segment;
+}
+
+/**
+* Payloads shorter than this are copied to the framing buffer by PacketWriter::writeGather
+*/
+constexpr size_t defaultGatherCopyThreshold = 256;
+
+// =============================================================================
+// Getter values
+// =============================================================================
+
+/**
+* View over the bytes returned by a binary field getter
+*/
+struct BinaryView
+{
+    const unsigned char* data;
+    size_t length;
+};
+
+/**
+* Converts the value returned by a binary field getter to a BinaryView
+*
+* @tparam T Contiguous byte container type (std::vector<unsigned char>, std::string, ...)
+*/
+template <class T>
+BinaryView toBinaryView(const T& bytes)
+{
+    static_assert(sizeof(*std::data(bytes)) == 1, "Binary field getters must return a contiguous range of bytes");
+    return {reinterpret_cast<const unsigned char*>(std::data(bytes)), std::size(bytes)};
+}
+
+inline BinaryView toBinaryView(const BinaryView& bytes)
+{
+    return bytes;
+}
+
+/**
+* Metafunction indicating if a field was decorated with a getter
+*
+* @see GenericPackerParser::FieldWithGetter
+*/
+template <class FieldType, class = void>
+struct HasGetter : std::false_type
+{
+};
+
+template <class FieldType>
+struct HasGetter<FieldType, std::void_t<typename FieldType::GetterType>> : std::true_type
+{
+};
+
+/**
+* Metafunction indicating if a getter result still refers to the input once the getter returned
+*
+* @note References, pointers and trivially copyable views are stable, returned containers are not
+*/
+template <class GetterSignature, class InputType>
+constexpr bool ReturnsStableValue = std::is_reference_v<std::invoke_result_t<GetterSignature, const InputType&>>
+    || std::is_trivially_copyable_v<std::invoke_result_t<GetterSignature, const InputType&>>;
+
+// =============================================================================
+// PacketWriter
+// =============================================================================
+
+/**
+* Class containing the serialization logic for the provided fields.
+*
+* Every field must be decorated with a getter mirroring its setter, so that the
+* output of the writer can be read back by a PacketParser built from the same fields.
+*
+* @tparam Fields Field types to serialize
+* @see GenericPackerParser::WITH_GETTER
+*/
+template<class... Fields>
+class PacketWriter
+{
+public:
+    using Data = unsigned char*;
+
+    /**
+    * True when the wire size of the layout does not depend on the serialized values
+    */
+    static constexpr bool hasConstantWireSize = FieldsWireSize<Fields...>::isFixed;
+
+    /**
+    * Wire size of the layout when hasConstantWireSize is true, 0 otherwise
+    */
+    static constexpr size_t constantWireSize = hasConstantWireSize ? FieldsWireSize<Fields...>::value : 0;
+
+    /**
+    * @param fields Fields to serialize
+    * @see GenericPackerParser::makePacketWriter
+    */
+    PacketWriter(Fields... fields)
+        : _fields(fields...)
+        , _data(nullptr)
+        , _offset(0)
+        , _segments(nullptr)
+        , _segmentBegin(0)
+        , _referenceThreshold(0)
+    {
+    }
+
+    /**
+    * Computes the exact number of bytes needed to serialize the input, validating it on the way
+    *
+    * @tparam InputType Serialized struct/class type
+    * @param input Reference to the object to serialize
+    * @param size Receives the wire size of the input
+    */
+    template <class InputType>
+    PacketParserErrorId wireSize(const InputType& input, size_t& size) const
+    {
+        size = 0;
+        if constexpr (hasConstantWireSize)
+        {
+            size = constantWireSize;
+            return PacketParserErrorId::NoError;
+        }
+        else
+        {
+            WireSize measure{0, 0, std::numeric_limits<size_t>::max()};
+            PacketParserErrorId error = PacketParserErrorId::NoError;
+            measureAllFields(input, measure, error, std::make_index_sequence<_fieldCount>());
+            size = measure.total;
+            return error;
+        }
+    }
+
+    /**
+    * Serializes the input to the provided buffer, which is resized exactly once
+    *
+    * @tparam InputType Serialized struct/class type
+    * @param input Reference to the object to serialize
+    * @param buffer Buffer receiving the serialized data, its capacity is reused between calls
+    */
+    template <class InputType>
+    PacketParserErrorId write(const InputType& input, std::vector<unsigned char>& buffer)
+    {
+        size_t size = 0;
+        PacketParserErrorId error = wireSize(input, size);
+        if (error != PacketParserErrorId::NoError)
+            return error;
+
+        buffer.resize(size);
+        writeAllFields(input, buffer.data());
+        return PacketParserErrorId::NoError;
+    }
+
+    /**
+    * Serializes the input to a caller-provided buffer
+    *
+    * @tparam InputType Serialized struct/class type
+    * @param input Reference to the object to serialize
+    * @param data Pointer to the receiving buffer
+    * @param capacity Length of the receiving buffer
+    * @param written Receives the number of bytes written
+    */
+    template <class InputType>
+    PacketParserErrorId write(const InputType& input, Data data, size_t capacity, size_t& written)
+    {
+        written = 0;
+        size_t size = 0;
+        PacketParserErrorId error = wireSize(input, size);
+        if (error != PacketParserErrorId::NoError)
+            return error;
+
+        if (size > capacity)
+            return PacketParserErrorId::ExceededDataRange;
+
+        writeAllFields(input, data);
+        written = size;
+        return PacketParserErrorId::NoError;
+    }
+
+    /**
+    * Serializes the input for a gathering send (writev, sendmsg, WSASend...)
+    *
+    * Only the framing is copied to the framing buffer: text and binary payloads of at
+    * least copyThreshold bytes are referenced in place by the segments.
+    *
+    * @tparam InputType Serialized struct/class type
+    * @param input Reference to the object to serialize, it must outlive the segments
+    * @param framing Buffer receiving the copied bytes, it is resized exactly once
+    * @param segments Receives the ordered segments covering the whole packet
+    * @param copyThreshold Payloads shorter than this are copied, as an extra segment would cost more
+    * @note Getters of referenced fields must return references or views, not temporaries
+    */
+    template <class InputType>
+    PacketParserErrorId writeGather(const InputType& input, std::vector<unsigned char>& framing, std::vector<IoVec>& segments, size_t copyThreshold = defaultGatherCopyThreshold)
+    {
+        segments.clear();
+
+        WireSize measure{0, 0, copyThreshold > 0 ? copyThreshold : 1};
+        PacketParserErrorId error = PacketParserErrorId::NoError;
+        if constexpr (!hasConstantWireSize)
+        {
+            measureAllFields(input, measure, error, std::make_index_sequence<_fieldCount>());
+            if (error != PacketParserErrorId::NoError)
+                return error;
+        }
+        else
+        {
+            measure.total = constantWireSize;
+        }
+
+        framing.resize(measure.total - measure.referenced);
+
+        // Reset working values
+        _data = framing.data();
+        _offset = 0;
+        _segments = &segments;
+        _segmentBegin = 0;
+        _referenceThreshold = measure.referenceThreshold;
+        writeFields<true>(input, std::make_index_sequence<_fieldCount>());
+        closeFramingSegment();
+        _segments = nullptr;
+
+        return PacketParserErrorId::NoError;
+    }
+
+private:
+    /**
+    * Wire size of a packet and part of it that can be referenced by gather segments
+    */
+    struct WireSize
+    {
+        size_t total;
+        size_t referenced;
+        size_t referenceThreshold;
+    };
+
+    const static size_t _fieldCount = sizeof...(Fields);
+    std::tuple<Fields...> _fields;
+    Data _data;
+    size_t _offset;
+
+    // Gather mode working values
+    std::vector<IoVec>* _segments;
+    size_t _segmentBegin;
+    size_t _referenceThreshold;
+
+    // -------------------------------------------------------------------------
+    // Size computation and validation
+    // -------------------------------------------------------------------------
+
+    template <class InputType, size_t... I>
+    void measureAllFields(const InputType& input, WireSize& size, PacketParserErrorId& error, std::index_sequence<I...>) const
+    {
+        (measureField(input, std::get<I>(_fields), size, error), ...);
+    }
+
+    template <class InputType, class FieldType>
+    void measureField(const InputType& input, const FieldType& field, WireSize& size, PacketParserErrorId& error) const
+    {
+        // Keep measuring fields as long as they are valid
+        if (error != PacketParserErrorId::NoError)
+            return;
+
+        if constexpr (FieldType::typeId == FieldTypeId::DynamicFieldArray
+            || FieldType::typeId == FieldTypeId::StaticFieldArray)
+        {
+            using ElementFieldType = typename FieldType::ArrayFieldType;
+            static_assert(HasGetter<ElementFieldType>::value, "Array element fields need a getter returning the range of elements, see WITH_GETTER");
+            static_assert(ElementFieldType::typeId != FieldTypeId::DynamicFieldArray
+                && ElementFieldType::typeId != FieldTypeId::StaticFieldArray,
+                "Arrays of arrays cannot be serialized, wrap the inner array in a MULTI_FIELD");
+
+            const auto& elements = std::invoke(field.field.getter, input);
+            const size_t count = std::size(elements);
+
+            if constexpr (FieldType::typeId == FieldTypeId::DynamicFieldArray)
+            {
+                using SizeType = typename FieldType::ArraySizeType;
+                if (count > static_cast<size_t>(std::numeric_limits<SizeType>::max()))
+                {
+                    error = PacketParserErrorId::InvalidValue;
+                    return;
+                }
+                size.total += sizeof(SizeType);
+            }
+            else if (count != field.size)
+            {
+                error = PacketParserErrorId::InvalidValue;
+                return;
+            }
+
+            // Fixed-size elements do not need to be visited
+            if constexpr (FieldWireSize<ElementFieldType>::isFixed)
+            {
+                size.total += count * FieldWireSize<ElementFieldType>::value;
+            }
+            else
+            {
+                for (const auto& element : elements)
+                    measureValue(field.field, element, size, error);
+            }
+        }
+        else
+        {
+            static_assert(HasGetter<FieldType>::value, "Serialized fields need a getter, see WITH_GETTER");
+            measureValue(field, std::invoke(field.getter, input), size, error);
+        }
+    }
+
+    template <class FieldType, class ValueType>
+    void measureValue(const FieldType& field, const ValueType& value, WireSize& size, PacketParserErrorId& error) const
+    {
+        if (error != PacketParserErrorId::NoError)
+            return;
+
+        // ValueField sizing
+        if constexpr (FieldType::typeId == FieldTypeId::ValueField)
+        {
+            size.total += sizeof(typename FieldType::ValueType);
+        }
+
+        // TextField validation and sizing
+        else if constexpr (FieldType::typeId == FieldTypeId::TextField)
+        {
+            const std::string_view text(value);
+
+            if (!FieldType::allowEmpty && text.empty())
+            {
+                error = PacketParserErrorId::EmptyTextNotAllowed;
+                return;
+            }
+
+            // The null terminator has to fit in the maximum length and must not appear in the text
+            if (text.size() + 1 > field.length || text.find('\0') != std::string_view::npos)
+            {
+                error = PacketParserErrorId::InvalidText;
+                return;
+            }
+
+            size.total += text.size() + 1;
+            if (text.size() >= size.referenceThreshold)
+                size.referenced += text.size();
+        }
+
+        // BinaryField validation and sizing
+        else if constexpr (FieldType::typeId == FieldTypeId::BinaryField)
+        {
+            using SizeType = typename FieldType::PayloadSizeType;
+            const BinaryView bytes = toBinaryView(value);
+
+            if (bytes.length > static_cast<size_t>(std::numeric_limits<SizeType>::max()))
+            {
+                error = PacketParserErrorId::InvalidValue;
+                return;
+            }
+
+            size.total += sizeof(SizeType) + bytes.length;
+            if (bytes.length >= size.referenceThreshold)
+                size.referenced += bytes.length;
+        }
+
+        // MultiField sizing
+        else if constexpr (FieldType::typeId == FieldTypeId::MultiField)
+        {
+            measureMultiField(value, field, size, error, std::make_index_sequence<FieldType::fieldCount>());
+        }
+
+        else
+        {
+            error = PacketParserErrorId::UnhandledFieldType;
+        }
+    }
+
+    template <class InputType, class MultiFieldType, size_t... I>
+    void measureMultiField(const InputType& input, const MultiFieldType& multiField, WireSize& size, PacketParserErrorId& error, std::index_sequence<I...>) const
+    {
+        (measureField(input, std::get<I>(multiField.fields), size, error), ...);
+    }
+
+    // -------------------------------------------------------------------------
+    // Serialization, the input has been validated by the size computation
+    // -------------------------------------------------------------------------
+
+    template <class InputType>
+    void writeAllFields(const InputType& input, Data data)
+    {
+        // Reset working values
+        _data = data;
+        _offset = 0;
+        writeFields<false>(input, std::make_index_sequence<_fieldCount>());
+    }
+
+    template <bool Gather, class InputType, size_t... I>
+    void writeFields(const InputType& input, std::index_sequence<I...>)
+    {
+        (writeField<Gather>(input, std::get<I>(_fields)), ...);
+    }
+
+    template <bool Gather, class InputType, class FieldType>
+    void writeField(const InputType& input, const FieldType& field)
+    {
+        if constexpr (FieldType::typeId == FieldTypeId::DynamicFieldArray
+            || FieldType::typeId == FieldTypeId::StaticFieldArray)
+        {
+            if constexpr (Gather)
+                static_assert(ReturnsStableValue<typename FieldType::ArrayFieldType::GetterType, InputType>,
+                    "Gathered array getters must not return temporaries");
+
+            const auto& elements = std::invoke(field.field.getter, input);
+
+            if constexpr (FieldType::typeId == FieldTypeId::DynamicFieldArray)
+            {
+                using SizeType = typename FieldType::ArraySizeType;
+                storeUnaligned(&_data[_offset], static_cast<SizeType>(std::size(elements)));
+                _offset += sizeof(SizeType);
+            }
+
+            for (const auto& element : elements)
+                writeValue<Gather>(field.field, element);
+        }
+        else
+        {
+            if constexpr (Gather && (FieldType::typeId == FieldTypeId::TextField || FieldType::typeId == FieldTypeId::BinaryField))
+                static_assert(ReturnsStableValue<typename FieldType::GetterType, InputType>,
+                    "Gathered text and binary getters must not return temporaries");
+
+            writeValue<Gather>(field, std::invoke(field.getter, input));
+        }
+    }
+
+    template <bool Gather, class FieldType, class ValueType>
+    void writeValue(const FieldType& field, const ValueType& value)
+    {
+        // ValueField serialization
+        if constexpr (FieldType::typeId == FieldTypeId::ValueField)
+        {
+            using WireType = typename FieldType::ValueType;
+            storeUnaligned(&_data[_offset], applyEndianness<FieldType>(static_cast<WireType>(value)));
+            _offset += sizeof(WireType);
+        }
+
+        // TextField serialization
+        else if constexpr (FieldType::typeId == FieldTypeId::TextField)
+        {
+            const std::string_view text(value);
+            if (Gather && text.size() >= _referenceThreshold)
+            {
+                referencePayload(text.data(), text.size());
+            }
+            else
+            {
+                std::memcpy(&_data[_offset], text.data(), text.size());
+                _offset += text.size();
+            }
+            _data[_offset++] = 0;
+        }
+
+        // BinaryField serialization
+        else if constexpr (FieldType::typeId == FieldTypeId::BinaryField)
+        {
+            using SizeType = typename FieldType::PayloadSizeType;
+            const BinaryView bytes = toBinaryView(value);
+            storeUnaligned(&_data[_offset], static_cast<SizeType>(bytes.length));
+            _offset += sizeof(SizeType);
+
+            if (Gather && bytes.length >= _referenceThreshold)
+            {
+                referencePayload(bytes.data, bytes.length);
+            }
+            else
+            {
+                if (bytes.length > 0)
+                    std::memcpy(&_data[_offset], bytes.data, bytes.length);
+                _offset += bytes.length;
+            }
+        }
+
+        // MultiField serialization
+        else if constexpr (FieldType::typeId == FieldTypeId::MultiField)
+        {
+            writeMultiField<Gather>(value, field, std::make_index_sequence<FieldType::fieldCount>());
+        }
+    }
+
+    template <bool Gather, class InputType, class MultiFieldType, size_t... I>
+    void writeMultiField(const InputType& input, const MultiFieldType& multiField, std::index_sequence<I...>)
+    {
+        (writeField<Gather>(input, std::get<I>(multiField.fields)), ...);
+    }
+
+    // -------------------------------------------------------------------------
+    // Gather segments
+    // -------------------------------------------------------------------------
+
+    void closeFramingSegment()
+    {
+        if (_offset > _segmentBegin)
+            _segments->push_back(makeIoVec(&_data[_segmentBegin], _offset - _segmentBegin));
+        _segmentBegin = _offset;
+    }
+
+    void referencePayload(const void* payload, size_t length)
+    {
+        closeFramingSegment();
+        _segments->push_back(makeIoVec(payload, length));
+    }
+};
+
+// =============================================================================
+// Utilities
+// =============================================================================
+
+template <class... Fields>
+PacketWriter<Fields...> makePacketWriter(Fields... fields)
+{
+    return {fields...};
+}
+
+/**
+* Builds a writer from the fields of an existing parser, so that a layout is only defined once
+*/
+template <class Instrumentation, class... Fields>
+PacketWriter<Fields...> makePacketWriter(const BasicPacketParser<Instrumentation, Fields...>& parser)
+{
+    return std::make_from_tuple<PacketWriter<Fields...>>(parser.fields());
+}
+
+} // namespace GenericPacketParser
@@ -0,0 +1,438 @@
+#pragma once
+
+#include "genericpacketparser.h"
+#include "objectpool.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace GenericPacketParser
+{
+
+// =============================================================================
+// WorkStealingPool
+// =============================================================================
+
+/**
+* Pool of threads running indexed tasks. Tasks are dealt in contiguous blocks to per-worker queues,
+* workers take from the front of their queue and steal from the back of the others when it is empty.
+*
+* @note The thread calling run works as worker 0, so a pool of one worker starts no thread.
+* Jobs run one at a time: run waits for the job of another thread, and runs its tasks inline when called from a task of the pool
+*/
+class WorkStealingPool
+{
+public:
+    /**
+    * @param workerCount Number of workers, including the thread calling run
+    */
+    explicit WorkStealingPool(size_t workerCount)
+        : _generation(0)
+        , _busyWorkers(0)
+        , _stopping(false)
+        , _task(nullptr)
+        , _context(nullptr)
+    {
+        workerCount = workerCount > 0 ? workerCount : 1;
+        for (size_t i = 0; i < workerCount; ++i)
+            _queues.emplace_back(new TaskQueue);
+
+        for (size_t i = 1; i < workerCount; ++i)
+            _threads.emplace_back(&WorkStealingPool::threadMain, this, i);
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _start.notify_all();
+
+        for (std::thread& thread : _threads)
+            thread.join();
+    }
+
+    size_t workerCount() const
+    {
+        return _queues.size();
+    }
+
+    /**
+    * Runs every task and returns once they are all done
+    *
+    * @param taskCount Number of tasks, identified by their index
+    * @param function Callable as function(task, worker), worker being in [0, workerCount)
+    */
+    template <class Function>
+    void run(size_t taskCount, Function&& function)
+    {
+        // The workers are all busy with the job of this task
+        if (currentWorker().pool == this)
+        {
+            const size_t worker = currentWorker().index;
+            for (size_t task = 0; task < taskCount; ++task)
+                function(task, worker);
+            return;
+        }
+
+        std::lock_guard<std::mutex> jobLock(_jobMutex);
+        const WorkerBinding outerWorker = currentWorker();
+        currentWorker() = {this, 0};
+
+        using FunctionType = std::remove_reference_t<Function>;
+        _task = [](void* context, size_t task, size_t worker)
+        {
+            (*static_cast<FunctionType*>(context))(task, worker);
+        };
+        _context = const_cast<void*>(static_cast<const void*>(&function));
+
+        const size_t workerCount = _queues.size();
+        for (size_t worker = 0; worker < workerCount; ++worker)
+        {
+            std::lock_guard<std::mutex> lock(_queues[worker]->mutex);
+            for (size_t task = taskCount * worker / workerCount; task < taskCount * (worker + 1) / workerCount; ++task)
+                _queues[worker]->tasks.push_back(task);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            ++_generation;
+            _busyWorkers = workerCount - 1;
+        }
+        _start.notify_all();
+
+        work(0);
+
+        // Other workers may still be running their last task
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [this] { return _busyWorkers == 0; });
+        currentWorker() = outerWorker;
+    }
+
+private:
+    struct alignas(64) TaskQueue
+    {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    // Pool and worker index of the calling thread while it runs tasks
+    struct WorkerBinding
+    {
+        const WorkStealingPool* pool;
+        size_t index;
+    };
+
+    static WorkerBinding& currentWorker()
+    {
+        static thread_local WorkerBinding binding{nullptr, 0};
+        return binding;
+    }
+
+    std::vector<std::unique_ptr<TaskQueue>> _queues;
+    std::vector<std::thread> _threads;
+
+    // Held by the thread running the current job
+    std::mutex _jobMutex;
+
+    // Job signaling
+    std::mutex _mutex;
+    std::condition_variable _start;
+    std::condition_variable _done;
+    uint64_t _generation;
+    size_t _busyWorkers;
+    bool _stopping;
+
+    // Current job
+    void (*_task)(void*, size_t, size_t);
+    void* _context;
+
+    void threadMain(size_t worker)
+    {
+        currentWorker() = {this, worker};
+        uint64_t generation = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _start.wait(lock, [&] { return _stopping || _generation != generation; });
+                if (_stopping)
+                    return;
+                generation = _generation;
+            }
+
+            work(worker);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (--_busyWorkers == 0)
+                _done.notify_one();
+        }
+    }
+
+    void work(size_t worker)
+    {
+        size_t task = 0;
+        while (popTask(worker, task))
+            _task(_context, task, worker);
+    }
+
+    bool popTask(size_t worker, size_t& task)
+    {
+        // Own queue first, in task order
+        {
+            TaskQueue& queue = *_queues[worker];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.tasks.empty())
+            {
+                task = queue.tasks.front();
+                queue.tasks.pop_front();
+                return true;
+            }
+        }
+
+        // Steal the last task of another worker, the farthest from what its owner works on
+        for (size_t i = 1; i < _queues.size(); ++i)
+        {
+            TaskQueue& queue = *_queues[(worker + i) % _queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.tasks.empty())
+            {
+                task = queue.tasks.back();
+                queue.tasks.pop_back();
+                return true;
+            }
+        }
+
+        return false;
+    }
+};
+
+// =============================================================================
+// ParallelParser
+// =============================================================================
+
+/**
+* Struct used to configure a ParallelParser
+*/
+struct ParallelOptions
+{
+    // Number of workers, including the calling thread
+    size_t threadCount = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+
+    // Number of frames per task
+    size_t chunkSize = 1024;
+
+    // Number of chunks per worker buffered by parseToSink before they are handed to the sink
+    size_t chunksInFlight = 4;
+};
+
+/**
+* Class parsing independent frames on a work-stealing pool, each worker with its own copy of the parser
+*
+* @tparam ParserType PacketParser type
+*/
+template <class ParserType>
+class ParallelParser
+{
+public:
+    /**
+    * @param parser Parser copied to every worker
+    * @param options Thread count and chunking
+    * @see GenericPackerParser::makeParallelParser
+    */
+    ParallelParser(const ParserType& parser, ParallelOptions options = {})
+        : _options(options)
+        , _pool(options.threadCount)
+    {
+        _options.chunkSize = _options.chunkSize > 0 ? _options.chunkSize : 1;
+        _options.chunksInFlight = _options.chunksInFlight > 0 ? _options.chunksInFlight : 1;
+
+        _workers.reserve(_pool.workerCount());
+        for (size_t i = 0; i < _pool.workerCount(); ++i)
+            _workers.emplace_back(parser);
+    }
+
+    size_t threadCount() const
+    {
+        return _pool.workerCount();
+    }
+
+    /**
+    * Parses frames into outputs at the same index, so results come back in input order
+    *
+    * @tparam OutputType Receiving output struct/class type
+    * @param frames Frames to parse
+    * @param outputs Output of each frame
+    * @param results Receives the outcome of each frame
+    * @return Number of frames parsed without error
+    */
+    template <class OutputType>
+    size_t parse(Span<const Frame> frames, Span<OutputType> outputs, Span<ParseResult> results)
+    {
+        assert(((void)"Each frame needs an output and a result.", outputs.size() >= frames.size() && results.size() >= frames.size()));
+
+        resetCounts();
+        const size_t chunkSize = _options.chunkSize;
+        _pool.run((frames.size() + chunkSize - 1) / chunkSize, [&](size_t chunk, size_t worker)
+        {
+            const size_t first = chunk * chunkSize;
+            const size_t count = std::min(chunkSize, frames.size() - first);
+            _workers[worker].parsedCount += _workers[worker].parser.parseBatch(
+                frames.subspan(first, count),
+                outputs.subspan(first, count),
+                results.subspan(first, count));
+        });
+        return parsedCount();
+    }
+
+    /**
+    * Parses frames and hands them to a sink in input order, buffering a bounded number of chunks
+    *
+    * @tparam OutputType Receiving output struct/class type, default constructible and reused through resetObject
+    * @param frames Frames to parse
+    * @param sink Callable as sink(index, output, result), calls are serialized but may come from any worker
+    * @return Number of frames parsed without error
+    * @note Outputs are recycled once the sink returns, it must copy or move what it keeps
+    */
+    template <class OutputType, class Sink>
+    size_t parseToSink(Span<const Frame> frames, Sink&& sink)
+    {
+        const size_t chunkSize = _options.chunkSize;
+        const size_t windowChunks = _options.chunksInFlight * threadCount();
+        const size_t windowSize = windowChunks * chunkSize;
+
+        // Outputs of a window are kept until they reach the sink, then reused by the next window
+        std::vector<OutputType> outputs(std::min(windowSize, frames.size()));
+        std::vector<ParseResult> results(outputs.size());
+        std::vector<char> parsedChunks(windowChunks);
+
+        resetCounts();
+        for (size_t windowFirst = 0; windowFirst < frames.size(); windowFirst += windowSize)
+        {
+            const Span<const Frame> window = frames.subspan(windowFirst, std::min(windowSize, frames.size() - windowFirst));
+            const size_t chunkCount = (window.size() + chunkSize - 1) / chunkSize;
+            std::fill(parsedChunks.begin(), parsedChunks.end(), 0);
+            size_t nextChunk = 0;
+            bool emitting = false;
+            std::mutex mutex;
+
+            _pool.run(chunkCount, [&](size_t chunk, size_t worker)
+            {
+                const size_t first = chunk * chunkSize;
+                const size_t count = std::min(chunkSize, window.size() - first);
+                for (size_t i = first; i < first + count; ++i)
+                    resetObject(outputs[i]);
+
+                _workers[worker].parsedCount += _workers[worker].parser.parseBatch(
+                    window.subspan(first, count),
+                    Span<OutputType>(&outputs[first], count),
+                    Span<ParseResult>(&results[first], count));
+
+                // The worker finding the next chunk in order parsed hands over every parsed chunk that follows it
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    parsedChunks[chunk] = 1;
+                    if (emitting)
+                        return;
+                    emitting = true;
+                }
+
+                for (;;)
+                {
+                    size_t emitted = 0;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (nextChunk == chunkCount || !parsedChunks[nextChunk])
+                        {
+                            emitting = false;
+                            return;
+                        }
+                        emitted = nextChunk;
+                    }
+
+                    const size_t emittedFirst = emitted * chunkSize;
+                    const size_t emittedEnd = std::min(emittedFirst + chunkSize, window.size());
+                    for (size_t i = emittedFirst; i < emittedEnd; ++i)
+                        sink(windowFirst + i, outputs[i], static_cast<const ParseResult&>(results[i]));
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ++nextChunk;
+                }
+            });
+        }
+        return parsedCount();
+    }
+
+private:
+    // Parsers keep their working values in their members, each worker gets a copy on its own cache lines
+    struct alignas(64) Worker
+    {
+        explicit Worker(const ParserType& parser)
+            : parser(parser)
+            , parsedCount(0)
+        {
+        }
+
+        ParserType parser;
+        size_t parsedCount;
+    };
+
+    ParallelOptions _options;
+    WorkStealingPool _pool;
+    std::vector<Worker> _workers;
+
+    void resetCounts()
+    {
+        for (Worker& worker : _workers)
+            worker.parsedCount = 0;
+    }
+
+    size_t parsedCount() const
+    {
+        size_t count = 0;
+        for (const Worker& worker : _workers)
+            count += worker.parsedCount;
+        return count;
+    }
+};
+
+// =============================================================================
+// Utilities
+// =============================================================================
+
+/**
+* Builds a hook decoding large arrays on a pool, see PacketParser::setArrayExecutor
+*
+* @param pool Pool running the ranges, it must outlive the parsers using the hook.
+* Parsers sharing it, e.g. the workers of a ParallelParser, decode one array at a time on it
+* @param threshold Minimum element count of an array decoded in parallel
+*/
+inline ArrayExecutor makeArrayExecutor(WorkStealingPool& pool, size_t threshold = 65536)
+{
+    ArrayExecutor executor;
+    executor.run = [](void* executor, size_t taskCount, void (*task)(void*, size_t), void* context)
+    {
+        static_cast<WorkStealingPool*>(executor)->run(taskCount, [&](size_t index, size_t) { task(context, index); });
+    };
+    executor.executor = &pool;
+    executor.threshold = threshold;
+    executor.rangeCount = pool.workerCount() * 4;
+    return executor;
+}
+
+template <class ParserType>
+ParallelParser<ParserType> makeParallelParser(const ParserType& parser, ParallelOptions options = {})
+{
+    return {parser, options};
+}
+
+} // namespace GenericPacketParser
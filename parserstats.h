@@ -0,0 +1,318 @@
+#pragma once
+
+#include "genericpacketparser.h"
+#include "perthread.h"
+
+#include <atomic>
+#include <cstring>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace GenericPacketParser
+{
+
+// =============================================================================
+// ParserStatsSnapshot
+// =============================================================================
+
+/**
+* Struct holding the outcome counters of a parser, added up over all threads.
+* It is trivially copyable, so it can be copied as is to a shared memory segment.
+*/
+struct ParserStatsSnapshot
+{
+    static constexpr size_t outcomeCount = static_cast<size_t>(PacketParserErrorId::Unknown) + 1;
+    static constexpr size_t sizeBucketCount = 65;
+
+    // Packets by outcome, indexed by PacketParserErrorId
+    uint64_t outcomes[outcomeCount];
+
+    // Sum of the packet lengths
+    uint64_t bytes;
+
+    // Packets by length, bucket b counting the lengths of b significant bits: 0, 1, 2-3, 4-7, ...
+    uint64_t sizes[sizeBucketCount];
+
+    uint64_t packets() const
+    {
+        uint64_t packets = 0;
+        for (const uint64_t count : outcomes)
+            packets += count;
+        return packets;
+    }
+
+    uint64_t count(PacketParserErrorId error) const
+    {
+        return outcomes[static_cast<size_t>(error)];
+    }
+
+    /**
+    * Adds the counters of another snapshot, e.g. of another parser or process
+    */
+    void merge(const ParserStatsSnapshot& other)
+    {
+        for (size_t i = 0; i < outcomeCount; ++i)
+            outcomes[i] += other.outcomes[i];
+        bytes += other.bytes;
+        for (size_t i = 0; i < sizeBucketCount; ++i)
+            sizes[i] += other.sizes[i];
+    }
+
+    /**
+    * @return Bucket of a packet length in sizes
+    */
+    static size_t sizeBucket(uint64_t length)
+    {
+#if defined(__GNUC__)
+        return length == 0 ? 0 : 64 - __builtin_clzll(length);
+#else
+        size_t bucket = 0;
+        for (; length != 0; length >>= 1)
+            ++bucket;
+        return bucket;
+#endif
+    }
+};
+
+// =============================================================================
+// ParserStats
+// =============================================================================
+
+/**
+* Class counting the outcomes, lengths and bytes of the packets parsed by a parser.
+*
+* Each thread counts into its own cache-line aligned counters with plain loads and stores,
+* so recording never contends. Snapshots add up the counters of every thread while they keep counting.
+*/
+class ParserStats
+{
+public:
+    ParserStats() = default;
+    ParserStats(const ParserStats&) = delete;
+    ParserStats& operator=(const ParserStats&) = delete;
+
+    /**
+    * Counts a packet
+    *
+    * @param error Outcome of the parsing
+    * @param length Length of the packet
+    */
+    void record(PacketParserErrorId error, size_t length)
+    {
+        Counters& counters = _counters.local();
+        addOwned(counters.outcomes[static_cast<size_t>(error)], 1);
+        addOwned(counters.bytes, length);
+        addOwned(counters.sizes[ParserStatsSnapshot::sizeBucket(length)], 1);
+    }
+
+    /**
+    * Counts the frames of a batch
+    *
+    * @param frames Frames parsed
+    * @param results Outcome of each frame
+    */
+    void record(Span<const Frame> frames, Span<const ParseResult> results)
+    {
+        Counters& counters = _counters.local();
+        uint64_t bytes = 0;
+        for (size_t i = 0; i < frames.size(); ++i)
+        {
+            addOwned(counters.outcomes[static_cast<size_t>(results[i].error)], 1);
+            addOwned(counters.sizes[ParserStatsSnapshot::sizeBucket(frames[i].length)], 1);
+            bytes += frames[i].length;
+        }
+        addOwned(counters.bytes, bytes);
+    }
+
+    /**
+    * @return Counters added up over all threads, each thread's counters being read as they are at the time
+    */
+    ParserStatsSnapshot snapshot() const
+    {
+        ParserStatsSnapshot snapshot{};
+        _counters.forEach([&](const Counters& counters)
+        {
+            for (size_t i = 0; i < ParserStatsSnapshot::outcomeCount; ++i)
+                snapshot.outcomes[i] += counters.outcomes[i].load(std::memory_order_relaxed);
+            snapshot.bytes += counters.bytes.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < ParserStatsSnapshot::sizeBucketCount; ++i)
+                snapshot.sizes[i] += counters.sizes[i].load(std::memory_order_relaxed);
+        });
+        return snapshot;
+    }
+
+private:
+    struct alignas(64) Counters
+    {
+        std::atomic<uint64_t> outcomes[ParserStatsSnapshot::outcomeCount] = {};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> sizes[ParserStatsSnapshot::sizeBucketCount] = {};
+    };
+
+    PerThread<Counters> _counters;
+};
+
+// =============================================================================
+// Shared memory export
+// =============================================================================
+
+/**
+* Layout of the shared memory segment written by SharedStatsExporter
+*/
+struct SharedStatsSegment
+{
+    static constexpr uint64_t magic = 0x5350505354415453ull;
+
+    uint64_t signature;
+
+    // Odd while a snapshot is being written
+    std::atomic<uint64_t> sequence;
+
+    ParserStatsSnapshot snapshot;
+};
+
+/**
+* Class publishing snapshots to a POSIX shared memory segment, read by an external scraper with readSharedStats
+* or by mapping SharedStatsSegment.
+*
+* Publishing never waits for readers: a sequence number tells them to retry a snapshot written meanwhile.
+*
+* @note The segment is only available on POSIX systems, isOpen returns false elsewhere
+*/
+class SharedStatsExporter
+{
+public:
+    /**
+    * @param name Name of the segment, e.g. "/parser-stats", created or reused
+    */
+    explicit SharedStatsExporter(const char* name)
+        : _segment(nullptr)
+    {
+#if defined(__linux__) || defined(__APPLE__)
+        const int descriptor = shm_open(name, O_CREAT | O_RDWR, 0644);
+        if (descriptor < 0)
+            return;
+
+        if (ftruncate(descriptor, sizeof(SharedStatsSegment)) == 0)
+        {
+            void* memory = mmap(nullptr, sizeof(SharedStatsSegment), PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+            if (memory != MAP_FAILED)
+            {
+                _segment = static_cast<SharedStatsSegment*>(memory);
+                _segment->sequence.store(0, std::memory_order_relaxed);
+                std::memset(&_segment->snapshot, 0, sizeof(ParserStatsSnapshot));
+                _segment->signature = SharedStatsSegment::magic;
+            }
+        }
+        close(descriptor);
+#else
+        (void)name;
+#endif
+    }
+
+    SharedStatsExporter(const SharedStatsExporter&) = delete;
+    SharedStatsExporter& operator=(const SharedStatsExporter&) = delete;
+
+    /**
+    * @note The segment stays available to scrapers after the exporter is destroyed, until shm_unlink
+    */
+    ~SharedStatsExporter()
+    {
+#if defined(__linux__) || defined(__APPLE__)
+        if (_segment != nullptr)
+            munmap(_segment, sizeof(SharedStatsSegment));
+#endif
+    }
+
+    bool isOpen() const
+    {
+        return _segment != nullptr;
+    }
+
+    /**
+    * Writes a snapshot to the segment
+    */
+    void publish(const ParserStatsSnapshot& snapshot)
+    {
+        if (_segment == nullptr)
+            return;
+
+        const uint64_t sequence = _segment->sequence.load(std::memory_order_relaxed);
+        _segment->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&_segment->snapshot, &snapshot, sizeof(ParserStatsSnapshot));
+        _segment->sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+private:
+    SharedStatsSegment* _segment;
+};
+
+// =============================================================================
+// Utilities
+// =============================================================================
+
+/**
+* Parses a packet and counts its outcome
+*/
+template <class ParserType, class OutputType>
+PacketParserErrorId parseCounted(ParserType& parser, ParserStats& stats, const unsigned char* data, size_t length, OutputType& output)
+{
+    const PacketParserErrorId error = parser.parse(data, length, output);
+    stats.record(error, length);
+    return error;
+}
+
+/**
+* Reads the last snapshot published to a shared memory segment, from any process
+*
+* @return False if the segment does not exist, was not written by a SharedStatsExporter
+* or stays mid-write, e.g. after its writer died
+*/
+inline bool readSharedStats(const char* name, ParserStatsSnapshot& snapshot)
+{
+#if defined(__linux__) || defined(__APPLE__)
+    const int descriptor = shm_open(name, O_RDONLY, 0);
+    if (descriptor < 0)
+        return false;
+
+    // Mapping past the end of a segment not sized yet would fault on access
+    struct stat status;
+    if (fstat(descriptor, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(SharedStatsSegment))
+    {
+        close(descriptor);
+        return false;
+    }
+
+    void* memory = mmap(nullptr, sizeof(SharedStatsSegment), PROT_READ, MAP_SHARED, descriptor, 0);
+    close(descriptor);
+    if (memory == MAP_FAILED)
+        return false;
+
+    const SharedStatsSegment* segment = static_cast<const SharedStatsSegment*>(memory);
+    bool valid = false;
+    for (size_t attempt = 0; attempt < 100000 && !valid && segment->signature == SharedStatsSegment::magic; ++attempt)
+    {
+        const uint64_t sequence = segment->sequence.load(std::memory_order_acquire);
+        if (sequence % 2 != 0)
+            continue;
+
+        std::memcpy(&snapshot, &segment->snapshot, sizeof(ParserStatsSnapshot));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        valid = segment->sequence.load(std::memory_order_relaxed) == sequence;
+    }
+    munmap(memory, sizeof(SharedStatsSegment));
+    return valid;
+#else
+    (void)name;
+    (void)snapshot;
+    return false;
+#endif
+}
+
+} // namespace GenericPacketParser
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace GenericPacketParser
+{
+
+// =============================================================================
+// ThreadIndex
+// =============================================================================
+
+/**
+* Small index identifying the calling thread among the running threads.
+*
+* Indices are taken on the first call of a thread and returned when it exits, so they stay
+* below the number of threads running at once.
+*/
+class ThreadIndex
+{
+public:
+    static size_t current()
+    {
+        thread_local const Slot slot;
+        return slot.index;
+    }
+
+private:
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<size_t> released;
+        size_t next = 0;
+    };
+
+    struct Slot
+    {
+        Slot()
+        {
+            Registry& indices = registry();
+            std::lock_guard<std::mutex> lock(indices.mutex);
+            if (indices.released.empty())
+            {
+                index = indices.next++;
+            }
+            else
+            {
+                index = indices.released.back();
+                indices.released.pop_back();
+            }
+        }
+
+        ~Slot()
+        {
+            Registry& indices = registry();
+            std::lock_guard<std::mutex> lock(indices.mutex);
+            indices.released.push_back(index);
+        }
+
+        size_t index;
+    };
+
+    static Registry& registry()
+    {
+        static Registry registry;
+        return registry;
+    }
+};
+
+// =============================================================================
+// PerThread
+// =============================================================================
+
+/**
+* Lock-free table of objects owned by the threads using them, read together by any thread.
+*
+* Each thread gets its own object on its first call to local, found afterwards with two loads.
+* Objects outlive their thread and are reused by the next thread taking the same index, so what
+* they accumulated is never lost.
+*
+* @tparam T Default constructible type, aligned on a cache line to keep threads from sharing one
+*/
+template <class T>
+class PerThread
+{
+public:
+    /**
+    * Maximum number of threads using the table at once
+    */
+    static constexpr size_t maxThreads = 4096;
+
+    PerThread()
+    {
+        for (std::atomic<Chunk*>& chunk : _chunks)
+            chunk.store(nullptr, std::memory_order_relaxed);
+    }
+
+    PerThread(const PerThread&) = delete;
+    PerThread& operator=(const PerThread&) = delete;
+
+    ~PerThread()
+    {
+        for (std::atomic<Chunk*>& chunk : _chunks)
+        {
+            Chunk* objects = chunk.load(std::memory_order_acquire);
+            if (objects == nullptr)
+                continue;
+            for (std::atomic<T*>& object : objects->objects)
+                delete object.load(std::memory_order_acquire);
+            delete objects;
+        }
+    }
+
+    /**
+    * @return Object of the calling thread
+    */
+    T& local()
+    {
+        const size_t index = ThreadIndex::current();
+        assert(((void)"Too many threads running at once.", index < maxThreads));
+
+        Chunk* chunk = _chunks[index / chunkSize].load(std::memory_order_acquire);
+        if (chunk == nullptr)
+            chunk = createChunk(index / chunkSize);
+
+        // Only the thread holding the index creates its object
+        std::atomic<T*>& slot = chunk->objects[index % chunkSize];
+        T* object = slot.load(std::memory_order_acquire);
+        if (object == nullptr)
+        {
+            object = new T();
+            slot.store(object, std::memory_order_release);
+        }
+        return *object;
+    }
+
+    /**
+    * Calls function(const T&) on the object of every thread that called local
+    */
+    template <class Function>
+    void forEach(Function&& function) const
+    {
+        for (const std::atomic<Chunk*>& chunk : _chunks)
+        {
+            const Chunk* objects = chunk.load(std::memory_order_acquire);
+            if (objects == nullptr)
+                continue;
+            for (const std::atomic<T*>& slot : objects->objects)
+            {
+                if (const T* object = slot.load(std::memory_order_acquire))
+                    function(*object);
+            }
+        }
+    }
+
+private:
+    static constexpr size_t chunkSize = 64;
+
+    struct Chunk
+    {
+        Chunk()
+        {
+            for (std::atomic<T*>& object : objects)
+                object.store(nullptr, std::memory_order_relaxed);
+        }
+
+        std::atomic<T*> objects[chunkSize];
+    };
+
+    std::atomic<Chunk*> _chunks[maxThreads / chunkSize];
+
+    Chunk* createChunk(size_t index)
+    {
+        Chunk* chunk = new Chunk();
+        Chunk* expected = nullptr;
+        if (_chunks[index].compare_exchange_strong(expected, chunk, std::memory_order_acq_rel))
+            return chunk;
+
+        // Another thread of the same chunk won
+        delete chunk;
+        return expected;
+    }
+};
+
+// =============================================================================
+// Utilities
+// =============================================================================
+
+/**
+* Adds to a counter written by a single thread, without the locked instruction of fetch_add
+*/
+inline void addOwned(std::atomic<uint64_t>& counter, uint64_t value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+} // namespace GenericPacketParser
@@ -0,0 +1,601 @@
+#pragma once
+
+#include "genericpacketparser.h"
+#include "objectpool.h"
+#include "spscqueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace GenericPacketParser
+{
+
+// =============================================================================
+// Pipeline options
+// =============================================================================
+
+enum class PipelineMode
+{
+    // One thread per stage, stages connected by lock-free queues
+    ThreadPerStage,
+    // One thread running every stage of a chunk before reading the next one,
+    // latencies are then service times and the frame stage includes the parse and dispatch of its frames
+    RunToCompletion
+};
+
+enum class OverflowPolicy
+{
+    // A stage waits for the next stage to free an item
+    Block,
+    // A stage drops its output when the next stage is saturated, and counts it
+    Drop
+};
+
+enum class PipelineStage
+{
+    Ingest,
+    Frame,
+    Parse,
+    Dispatch
+};
+
+/**
+* Struct used to configure a Pipeline
+*/
+struct PipelineOptions
+{
+    PipelineMode mode = PipelineMode::ThreadPerStage;
+    OverflowPolicy overflow = OverflowPolicy::Block;
+
+    // Items in flight between two stages
+    size_t queueCapacity = 1024;
+
+    // Largest chunk read from the source
+    size_t maxChunkSize = 65536;
+
+    // CPU of the ingest, frame, parse and dispatch threads, -1 leaves a thread unpinned.
+    // In RunToCompletion mode, the only thread uses the ingest CPU.
+    int cpus[4] = {-1, -1, -1, -1};
+
+    // Timestamps items to measure stage latencies
+    bool measureLatency = true;
+
+    // How stages poll their input queue when it is empty, and their free items under the Block policy
+    WaitStrategy wait = WaitStrategy::Spin;
+};
+
+/**
+* Struct holding the metrics of a pipeline stage
+*/
+struct StageMetrics
+{
+    // Items processed by the stage, dropped items excluded
+    size_t processed;
+
+    // Items produced by the stage and dropped because the next stage was saturated
+    size_t dropped;
+
+    // Items waiting in the input queue of the stage, and the most seen
+    size_t queueDepth;
+    size_t maxQueueDepth;
+
+    // Nanoseconds from the time an item is queued to the stage to the end of its processing
+    uint64_t totalLatency;
+    uint64_t maxLatency;
+};
+
+/**
+* Pins a thread to a CPU
+*
+* @return False if the CPU is negative or pinning is not supported on this platform
+*/
+inline bool pinThread(std::thread& thread, int cpu)
+{
+#if defined(__linux__)
+    if (cpu < 0)
+        return false;
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    return pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus) == 0;
+#else
+    (void)thread;
+    (void)cpu;
+    return false;
+#endif
+}
+
+// =============================================================================
+// Framers
+// =============================================================================
+
+/**
+* Framer of datagram sources, every chunk is a frame
+*/
+struct DatagramFramer
+{
+    template <class Emit>
+    void operator()(const unsigned char* data, size_t length, Emit&& emit)
+    {
+        emit(data, length);
+    }
+};
+
+/**
+* Framer of stream sources, every frame being preceded by its length.
+* Frames split across chunks are reassembled.
+*
+* @tparam SizeType Type of the length prefix, in host order like the size prefixes of the parsed fields
+*/
+template <class SizeType>
+class LengthPrefixFramer
+{
+public:
+    template <class Emit>
+    void operator()(const unsigned char* data, size_t length, Emit&& emit)
+    {
+        // Bytes left by the previous chunk are completed first
+        if (!_pending.empty())
+        {
+            _pending.insert(_pending.end(), data, data + length);
+            const size_t consumed = emitFrames(_pending.data(), _pending.size(), emit);
+            _pending.erase(_pending.begin(), _pending.begin() + consumed);
+            return;
+        }
+
+        const size_t consumed = emitFrames(data, length, emit);
+        _pending.assign(data + consumed, data + length);
+    }
+
+private:
+    std::vector<unsigned char> _pending;
+
+    template <class Emit>
+    static size_t emitFrames(const unsigned char* data, size_t length, Emit& emit)
+    {
+        size_t offset = 0;
+        while (length - offset >= sizeof(SizeType))
+        {
+            const size_t frameLength = loadUnaligned<SizeType>(&data[offset]);
+            if (frameLength > length - offset - sizeof(SizeType))
+                break;
+
+            emit(&data[offset + sizeof(SizeType)], frameLength);
+            offset += sizeof(SizeType) + frameLength;
+        }
+        return offset;
+    }
+};
+
+// =============================================================================
+// Sources
+// =============================================================================
+
+/**
+* In-process source returning chunks from memory, one per call
+*/
+class MemorySource
+{
+public:
+    /**
+    * @param chunks Chunks returned in order, their data must outlive the source
+    */
+    explicit MemorySource(Span<const Frame> chunks)
+        : _chunks(chunks)
+        , _next(0)
+    {
+    }
+
+    /**
+    * @return False once every chunk was returned
+    */
+    bool operator()(unsigned char* buffer, size_t capacity, size_t& length)
+    {
+        if (_next == _chunks.size())
+            return false;
+
+        const Frame& chunk = _chunks[_next++];
+        assert(((void)"Chunk larger than the pipeline chunk size.", chunk.length <= capacity));
+        length = chunk.length < capacity ? chunk.length : capacity;
+        std::memcpy(buffer, chunk.data, length);
+        return true;
+    }
+
+private:
+    Span<const Frame> _chunks;
+    size_t _next;
+};
+
+// =============================================================================
+// Pipeline
+// =============================================================================
+
+/**
+* Class connecting a source, a framer, a parser and a handler as pipeline stages.
+*
+* In ThreadPerStage mode, each edge between stages owns a fixed set of items cycling through a forward queue
+* and a free queue. A stage that finds no free item applies the overflow policy, so backpressure travels up
+* to the source without allocations.
+*
+* @tparam OutputType Receiving output struct/class type, default constructible and reused through resetObject
+* @tparam ParserType PacketParser type
+* @tparam Source Callable as source(buffer, capacity, length), returning false at the end of the stream
+* @tparam Framer Callable as framer(data, length, emit), calling emit(data, length) for each frame
+* @tparam Handler Callable as handler(output, result)
+*/
+template <class OutputType, class ParserType, class Source, class Framer, class Handler>
+class Pipeline
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+    * @see GenericPackerParser::makePipeline
+    */
+    Pipeline(const ParserType& parser, Source source, Framer framer, Handler handler, PipelineOptions options = {})
+        : _parser(parser)
+        , _source(source)
+        , _framer(framer)
+        , _handler(handler)
+        , _options(options)
+        , _chunks(options.mode == PipelineMode::ThreadPerStage ? options.queueCapacity : 0)
+        , _frames(options.mode == PipelineMode::ThreadPerStage ? options.queueCapacity : 0)
+        , _outputs(options.mode == PipelineMode::ThreadPerStage ? options.queueCapacity : 0)
+        , _stopping(false)
+    {
+        for (std::unique_ptr<Buffer>& chunk : _chunks.items)
+            chunk->bytes.resize(options.maxChunkSize);
+    }
+
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+
+    ~Pipeline()
+    {
+        stop();
+        wait();
+    }
+
+    /**
+    * Starts the stage threads
+    */
+    void start()
+    {
+        if (_options.mode == PipelineMode::RunToCompletion)
+        {
+            _threads.emplace_back(&Pipeline::runToCompletion, this);
+        }
+        else
+        {
+            _threads.emplace_back(&Pipeline::ingestStage, this);
+            _threads.emplace_back(&Pipeline::frameStage, this);
+            _threads.emplace_back(&Pipeline::parseStage, this);
+            _threads.emplace_back(&Pipeline::dispatchStage, this);
+        }
+
+        for (size_t i = 0; i < _threads.size(); ++i)
+            pinThread(_threads[i], _options.cpus[i]);
+    }
+
+    /**
+    * Stops reading the source, items already read still reach the handler
+    */
+    void stop()
+    {
+        _stopping.store(true, std::memory_order_release);
+    }
+
+    /**
+    * Waits until the end of the stream has gone through every stage
+    */
+    void wait()
+    {
+        for (std::thread& thread : _threads)
+            thread.join();
+        _threads.clear();
+    }
+
+    StageMetrics metrics(PipelineStage stage) const
+    {
+        const Counters& counters = _counters[static_cast<size_t>(stage)];
+        StageMetrics metrics{};
+        metrics.processed = counters.processed.load(std::memory_order_relaxed);
+        metrics.dropped = counters.dropped.load(std::memory_order_relaxed);
+        metrics.maxQueueDepth = counters.maxQueueDepth.load(std::memory_order_relaxed);
+        metrics.totalLatency = counters.totalLatency.load(std::memory_order_relaxed);
+        metrics.maxLatency = counters.maxLatency.load(std::memory_order_relaxed);
+
+        switch (stage)
+        {
+        case PipelineStage::Frame: metrics.queueDepth = _chunks.queued.size(); break;
+        case PipelineStage::Parse: metrics.queueDepth = _frames.queued.size(); break;
+        case PipelineStage::Dispatch: metrics.queueDepth = _outputs.queued.size(); break;
+        default: break;
+        }
+        return metrics;
+    }
+
+private:
+    struct Buffer
+    {
+        std::vector<unsigned char> bytes;
+        size_t length = 0;
+        Clock::time_point queuedTime;
+    };
+
+    struct Parsed
+    {
+        OutputType output;
+        ParseResult result{};
+        Clock::time_point queuedTime;
+    };
+
+    /**
+    * Items cycling between two stages, the queues can hold every item so pushes never fail.
+    * Edges are left empty in RunToCompletion mode.
+    */
+    template <class Item>
+    struct Edge
+    {
+        explicit Edge(size_t capacity)
+            : queued(capacity + 1)
+            , free(capacity)
+        {
+            for (size_t i = 0; i < capacity; ++i)
+            {
+                items.emplace_back(new Item);
+                free.push(items.back().get());
+            }
+        }
+
+        std::vector<std::unique_ptr<Item>> items;
+
+        // Null pointers mark the end of the stream
+        SpscQueue<Item*> queued;
+        SpscQueue<Item*> free;
+    };
+
+    // Written by one stage thread each, read by metrics
+    struct alignas(64) Counters
+    {
+        std::atomic<size_t> processed{0};
+        std::atomic<size_t> dropped{0};
+        std::atomic<size_t> maxQueueDepth{0};
+        std::atomic<uint64_t> totalLatency{0};
+        std::atomic<uint64_t> maxLatency{0};
+    };
+
+    ParserType _parser;
+    Source _source;
+    Framer _framer;
+    Handler _handler;
+    PipelineOptions _options;
+
+    Edge<Buffer> _chunks;
+    Edge<Buffer> _frames;
+    Edge<Parsed> _outputs;
+
+    Counters _counters[4];
+    std::vector<std::thread> _threads;
+    std::atomic<bool> _stopping;
+
+    static void increment(std::atomic<size_t>& counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    Clock::time_point now() const
+    {
+        return _options.measureLatency ? Clock::now() : Clock::time_point();
+    }
+
+    void recordLatency(PipelineStage stage, Clock::time_point begin)
+    {
+        if (!_options.measureLatency)
+            return;
+
+        Counters& counters = _counters[static_cast<size_t>(stage)];
+        const uint64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count();
+        counters.totalLatency.store(counters.totalLatency.load(std::memory_order_relaxed) + latency, std::memory_order_relaxed);
+        if (latency > counters.maxLatency.load(std::memory_order_relaxed))
+            counters.maxLatency.store(latency, std::memory_order_relaxed);
+    }
+
+    /**
+    * @return A free item of the edge, or null if the overflow policy dropped the output of the stage
+    */
+    template <class Item>
+    Item* acquire(Edge<Item>& edge, PipelineStage stage)
+    {
+        Item* item = nullptr;
+        if (edge.free.pop(item))
+            return item;
+
+        if (_options.overflow == OverflowPolicy::Drop)
+        {
+            increment(_counters[static_cast<size_t>(stage)].dropped);
+            return nullptr;
+        }
+
+        IdleWait idleWait(_options.wait);
+        while (!edge.free.pop(item))
+            idleWait();
+        return item;
+    }
+
+    template <class Item>
+    void forward(Edge<Item>& edge, Item* item, PipelineStage nextStage)
+    {
+        if (item != nullptr)
+            item->queuedTime = now();
+        edge.queued.push(item);
+
+        std::atomic<size_t>& maxQueueDepth = _counters[static_cast<size_t>(nextStage)].maxQueueDepth;
+        const size_t depth = edge.queued.size();
+        if (depth > maxQueueDepth.load(std::memory_order_relaxed))
+            maxQueueDepth.store(depth, std::memory_order_relaxed);
+    }
+
+    template <class Item>
+    Item* next(Edge<Item>& edge) const
+    {
+        Item* item = nullptr;
+        IdleWait idleWait(_options.wait);
+        while (!edge.queued.pop(item))
+            idleWait();
+        return item;
+    }
+
+    void ingestStage()
+    {
+        // Chunks dropped under the Drop policy are still read, to keep the source moving
+        std::vector<unsigned char> scratch(_options.maxChunkSize);
+
+        // The frame stage is the only producer of free chunks, a chunk left empty is kept for the next read
+        Buffer* chunk = nullptr;
+        while (!_stopping.load(std::memory_order_acquire))
+        {
+            // Under the Drop policy, a chunk is only counted as dropped once the source returns one
+            if (chunk == nullptr && !_chunks.free.pop(chunk) && _options.overflow == OverflowPolicy::Block)
+                chunk = acquire(_chunks, PipelineStage::Ingest);
+            unsigned char* data = chunk != nullptr ? chunk->bytes.data() : scratch.data();
+
+            const Clock::time_point begin = now();
+            size_t length = 0;
+            if (!_source(data, _options.maxChunkSize, length))
+                break;
+            recordLatency(PipelineStage::Ingest, begin);
+
+            if (chunk == nullptr)
+            {
+                if (length > 0)
+                    increment(_counters[static_cast<size_t>(PipelineStage::Ingest)].dropped);
+                continue;
+            }
+            increment(_counters[static_cast<size_t>(PipelineStage::Ingest)].processed);
+            if (length == 0)
+                continue;
+
+            chunk->length = length;
+            forward(_chunks, chunk, PipelineStage::Frame);
+            chunk = nullptr;
+        }
+        forward<Buffer>(_chunks, nullptr, PipelineStage::Frame);
+    }
+
+    void frameStage()
+    {
+        while (Buffer* chunk = next(_chunks))
+        {
+            _framer(chunk->bytes.data(), chunk->length, [this](const unsigned char* data, size_t length)
+            {
+                Buffer* frame = acquire(_frames, PipelineStage::Frame);
+                if (frame == nullptr)
+                    return;
+
+                // Buffers grow to the largest frame seen and keep their capacity
+                if (frame->bytes.size() < length)
+                    frame->bytes.resize(length);
+                std::memcpy(frame->bytes.data(), data, length);
+                frame->length = length;
+                forward(_frames, frame, PipelineStage::Parse);
+            });
+
+            recordLatency(PipelineStage::Frame, chunk->queuedTime);
+            increment(_counters[static_cast<size_t>(PipelineStage::Frame)].processed);
+            _chunks.free.push(chunk);
+        }
+        forward<Buffer>(_frames, nullptr, PipelineStage::Parse);
+    }
+
+    void parseStage()
+    {
+        while (Buffer* frame = next(_frames))
+        {
+            Parsed* parsed = acquire(_outputs, PipelineStage::Parse);
+            if (parsed != nullptr)
+            {
+                const Frame input{frame->bytes.data(), frame->length};
+                resetObject(parsed->output);
+                _parser.parseBatch(Span<const Frame>(&input, 1), Span<OutputType>(&parsed->output, 1), Span<ParseResult>(&parsed->result, 1));
+                recordLatency(PipelineStage::Parse, frame->queuedTime);
+                increment(_counters[static_cast<size_t>(PipelineStage::Parse)].processed);
+            }
+            _frames.free.push(frame);
+
+            if (parsed != nullptr)
+                forward(_outputs, parsed, PipelineStage::Dispatch);
+        }
+        forward<Parsed>(_outputs, nullptr, PipelineStage::Dispatch);
+    }
+
+    void dispatchStage()
+    {
+        while (Parsed* parsed = next(_outputs))
+        {
+            _handler(parsed->output, static_cast<const ParseResult&>(parsed->result));
+            recordLatency(PipelineStage::Dispatch, parsed->queuedTime);
+            increment(_counters[static_cast<size_t>(PipelineStage::Dispatch)].processed);
+            _outputs.free.push(parsed);
+        }
+    }
+
+    void runToCompletion()
+    {
+        std::vector<unsigned char> chunk(_options.maxChunkSize);
+        OutputType output;
+        ParseResult result{};
+
+        while (!_stopping.load(std::memory_order_acquire))
+        {
+            Clock::time_point begin = now();
+            size_t length = 0;
+            if (!_source(chunk.data(), chunk.size(), length))
+                break;
+            recordLatency(PipelineStage::Ingest, begin);
+            increment(_counters[static_cast<size_t>(PipelineStage::Ingest)].processed);
+
+            begin = now();
+            _framer(chunk.data(), length, [&](const unsigned char* data, size_t frameLength)
+            {
+                const Clock::time_point parseBegin = now();
+                const Frame input{data, frameLength};
+                resetObject(output);
+                _parser.parseBatch(Span<const Frame>(&input, 1), Span<OutputType>(&output, 1), Span<ParseResult>(&result, 1));
+                recordLatency(PipelineStage::Parse, parseBegin);
+                increment(_counters[static_cast<size_t>(PipelineStage::Parse)].processed);
+
+                const Clock::time_point dispatchBegin = now();
+                _handler(output, static_cast<const ParseResult&>(result));
+                recordLatency(PipelineStage::Dispatch, dispatchBegin);
+                increment(_counters[static_cast<size_t>(PipelineStage::Dispatch)].processed);
+            });
+            recordLatency(PipelineStage::Frame, begin);
+            increment(_counters[static_cast<size_t>(PipelineStage::Frame)].processed);
+        }
+    }
+};
+
+// =============================================================================
+// Utilities
+// =============================================================================
+
+/**
+* Builds a pipeline, e.g. makePipeline<MyPacket>(parser, MemorySource(chunks), DatagramFramer(), handler)
+*/
+template <class OutputType, class ParserType, class Source, class Framer, class Handler>
+Pipeline<OutputType, ParserType, Source, Framer, Handler> makePipeline(const ParserType& parser, Source source, Framer framer, Handler handler, PipelineOptions options = {})
+{
+    return {parser, source, framer, handler, options};
+}
+
+} // namespace GenericPacketParser
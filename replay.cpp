@@ -0,0 +1,388 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "framefile.h"
+#include "genericpacketparser.h"
+#include "latencyhistogram.h"
+#include "packetgenerator.h"
+#include "parserstats.h"
+
+#if defined(__linux__)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace GenericPacketParser;
+
+// =============================================================================
+// Layouts
+// =============================================================================
+
+struct SubPacket
+{
+    string name;
+    uint32_t value;
+    void setName(const char* s) { name = s; }
+    void setValue(uint32_t v) { value = v; }
+};
+
+struct MyPacket
+{
+    string name;
+    uint32_t value;
+    vector<SubPacket> array;
+    void setName(const char* s) { name = s; }
+    void setValue(uint32_t v) { value = v; }
+    void addToArray(SubPacket& sp) { array.emplace_back(sp); }
+};
+
+struct Quote
+{
+    uint16_t instrument;
+    uint32_t sequence;
+    uint64_t price;
+    void setInstrument(uint16_t v) { instrument = v; }
+    void setSequence(uint32_t v) { sequence = v; }
+    void setPrice(uint64_t v) { price = v; }
+};
+
+/**
+* Calls function(parser, OutputType{}) with the parser of a layout, add a layout here to replay it
+*
+* @return False if the layout is unknown
+*/
+template <class Function>
+bool withLayout(const string& name, Function&& function)
+{
+    if (name == "mypacket")
+    {
+        function(makePacketParser(
+            TEXT_FIELD(&MyPacket::setName, 16),
+            VALUE_FIELD(&MyPacket::setValue, uint32_t),
+            DYNAMIC_ARRAY(uint8_t,
+                MULTI_FIELD(SubPacket, &MyPacket::addToArray,
+                    TEXT_FIELD_ALLOW_EMPTY(&SubPacket::setName, 16),
+                    VALUE_FIELD_ENDIAN(&SubPacket::setValue, uint32_t)))), MyPacket{});
+        return true;
+    }
+
+    if (name == "quote")
+    {
+        function(makePacketParser(
+            VALUE_FIELD(&Quote::setInstrument, uint16_t),
+            VALUE_FIELD_ENDIAN(&Quote::setSequence, uint32_t),
+            VALUE_FIELD_ENDIAN(&Quote::setPrice, uint64_t)), Quote{});
+        return true;
+    }
+
+    return false;
+}
+
+// =============================================================================
+// Pacing
+// =============================================================================
+
+/**
+* Class holding frames back until their recorded time, scaled by a speed factor
+*/
+class Pacer
+{
+public:
+    /**
+    * @param speed Replay speed relative to the recording, 0 replaying flat-out
+    */
+    explicit Pacer(double speed)
+        : _speed(speed)
+        , _firstTimestamp(0)
+    {
+    }
+
+    /**
+    * Restarts the schedule, the frame of the given timestamp being due now
+    */
+    void restart(uint64_t firstTimestamp)
+    {
+        _firstTimestamp = firstTimestamp;
+        _start = chrono::steady_clock::now();
+    }
+
+    /**
+    * Waits until a frame is due, sleeping through long gaps and spinning through short ones
+    *
+    * @return Nanoseconds the frame is late
+    */
+    uint64_t wait(uint64_t timestamp)
+    {
+        const double offset = timestamp > _firstTimestamp ? static_cast<double>(timestamp - _firstTimestamp) / _speed : 0.0;
+        const chrono::steady_clock::time_point due = _start + chrono::nanoseconds(static_cast<int64_t>(offset));
+
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        if (due - now > chrono::microseconds(200))
+        {
+            this_thread::sleep_until(due - chrono::microseconds(100));
+            now = chrono::steady_clock::now();
+        }
+        while (now < due)
+            now = chrono::steady_clock::now();
+
+        return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(now - due).count());
+    }
+
+    bool paced() const
+    {
+        return _speed > 0;
+    }
+
+private:
+    double _speed;
+    uint64_t _firstTimestamp;
+    chrono::steady_clock::time_point _start;
+};
+
+// =============================================================================
+// Replay
+// =============================================================================
+
+struct ReplayOptions
+{
+    string layout = "mypacket";
+    double speed = 0;
+    size_t loops = 1;
+    int udpPort = 0;
+    int tcpPort = 0;
+    CapturePayload payload = CapturePayload::Transport;
+};
+
+/**
+* Prints the throughput of a replay and the lateness of the frames when paced
+*/
+void reportThroughput(const char* name, size_t frameCount, size_t byteCount, chrono::steady_clock::duration elapsed,
+    const Pacer& pacer, const LatencySnapshot& lateness)
+{
+    const double seconds = chrono::duration<double>(elapsed).count();
+    printf("%-10s %zu frames, %zu bytes in %.3f s: %.3f Mframes/s, %.1f MB/s\n",
+        name, frameCount, byteCount, seconds, frameCount / seconds / 1e6, byteCount / seconds / 1e6);
+
+    if (pacer.paced())
+    {
+        printf("%-10s p50 %.0f ns p99 %.0f ns p99.9 %.0f ns max %.0f ns\n",
+            "lateness", lateness.percentile(50), lateness.percentile(99), lateness.percentile(99.9), lateness.max());
+    }
+}
+
+/**
+* Parses every frame, reporting throughput, parse latencies and outcomes
+*/
+template <class ParserType, class OutputType>
+void replayParse(ParserType& parser, const vector<TimedFrame>& frames, const ReplayOptions& options)
+{
+    LatencyRecorder latencies;
+    LatencyRecorder lateness;
+    ParserStats stats;
+    Pacer pacer(options.speed);
+
+    const chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    for (size_t loop = 0; loop < options.loops; ++loop)
+    {
+        pacer.restart(frames.front().timestamp);
+        for (const TimedFrame& frame : frames)
+        {
+            if (pacer.paced())
+                lateness.record(pacer.wait(frame.timestamp));
+            OutputType output{};
+            stats.record(parseTimed(parser, latencies, frame.frame.data, frame.frame.length, output), frame.frame.length);
+        }
+    }
+    const chrono::steady_clock::duration elapsed = chrono::steady_clock::now() - begin;
+
+    // Lateness is recorded in nanoseconds rather than ticks
+    LatencySnapshot latenessSnapshot = lateness.snapshot();
+    latenessSnapshot.nanosecondsPerTick = 1.0;
+
+    const ParserStatsSnapshot outcomes = stats.snapshot();
+    reportThroughput("parsed", outcomes.packets(), outcomes.bytes, elapsed, pacer, latenessSnapshot);
+
+    const LatencySnapshot latency = latencies.snapshot();
+    printf("%-10s p50 %.0f ns p99 %.0f ns p99.9 %.0f ns max %.0f ns\n",
+        "latency", latency.percentile(50), latency.percentile(99), latency.percentile(99.9), latency.max());
+
+    for (size_t i = 0; i < ParserStatsSnapshot::outcomeCount; ++i)
+    {
+        const PacketParserErrorId outcome = static_cast<PacketParserErrorId>(i);
+        if (outcomes.count(outcome) != 0)
+            cout << "outcome    " << outcome << ": " << outcomes.count(outcome) << endl;
+    }
+}
+
+#if defined(__linux__)
+/**
+* Sends every frame to a loopback port, one datagram per frame or back to back on a TCP stream
+*
+* @return False if the socket could not be connected
+*/
+bool replayPush(const vector<TimedFrame>& frames, const ReplayOptions& options)
+{
+    const bool udp = options.udpPort != 0;
+    const int destination = socket(AF_INET, udp ? SOCK_DGRAM : SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(udp ? options.udpPort : options.tcpPort));
+    if (destination < 0 || connect(destination, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        fprintf(stderr, "cannot connect to port %d\n", ntohs(address.sin_port));
+        if (destination >= 0)
+            close(destination);
+        return false;
+    }
+
+    LatencyRecorder lateness;
+    Pacer pacer(options.speed);
+    size_t sentFrames = 0;
+    size_t sentBytes = 0;
+    size_t failures = 0;
+
+    const chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    for (size_t loop = 0; loop < options.loops; ++loop)
+    {
+        pacer.restart(frames.front().timestamp);
+        for (const TimedFrame& frame : frames)
+        {
+            if (pacer.paced())
+                lateness.record(pacer.wait(frame.timestamp));
+
+            // Streams may take a frame in several writes
+            size_t sent = 0;
+            while (sent < frame.frame.length)
+            {
+                const ssize_t written = send(destination, frame.frame.data + sent, frame.frame.length - sent, MSG_NOSIGNAL);
+                if (written < 0)
+                    break;
+                sent += static_cast<size_t>(written);
+                if (udp)
+                    break;
+            }
+
+            const bool complete = sent == frame.frame.length;
+            sentFrames += complete ? 1 : 0;
+            sentBytes += sent;
+            failures += complete ? 0 : 1;
+        }
+    }
+    const chrono::steady_clock::duration elapsed = chrono::steady_clock::now() - begin;
+    close(destination);
+
+    LatencySnapshot latenessSnapshot = lateness.snapshot();
+    latenessSnapshot.nanosecondsPerTick = 1.0;
+    reportThroughput("sent", sentFrames, sentBytes, elapsed, pacer, latenessSnapshot);
+    if (failures != 0)
+        printf("%-10s %zu frames\n", "failed", failures);
+    return true;
+}
+#endif
+
+void printUsage()
+{
+    printf(
+        "Usage: replay FILE [options]\n"
+        "  Replays a frame file or a pcap file through a parser, or pushes it to a loopback port\n"
+        "\n"
+        "  --layout NAME      parser layout: mypacket (default), quote\n"
+        "  --speed X          replay at X times the recorded timing, 0 for flat-out (default)\n"
+        "  --loops N          replay the file N times\n"
+        "  --link-layer       keep whole captured packets from pcap files instead of their UDP/TCP payload\n"
+        "  --udp PORT         send each frame as a datagram to 127.0.0.1:PORT instead of parsing it\n"
+        "  --tcp PORT         send the frames back to back to 127.0.0.1:PORT instead of parsing them\n"
+        "  --generate COUNT   write COUNT generated packets of the layout to FILE, 1 us apart, and exit\n");
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printUsage();
+        return 1;
+    }
+
+    const char* path = argv[1];
+    ReplayOptions options;
+    size_t generateCount = 0;
+    for (int i = 2; i < argc; ++i)
+    {
+        const string argument = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (argument == "--layout" && hasValue)
+            options.layout = argv[++i];
+        else if (argument == "--speed" && hasValue)
+            options.speed = atof(argv[++i]);
+        else if (argument == "--loops" && hasValue)
+            options.loops = strtoull(argv[++i], nullptr, 10);
+        else if (argument == "--link-layer")
+            options.payload = CapturePayload::LinkLayer;
+        else if (argument == "--udp" && hasValue)
+            options.udpPort = atoi(argv[++i]);
+        else if (argument == "--tcp" && hasValue)
+            options.tcpPort = atoi(argv[++i]);
+        else if (argument == "--generate" && hasValue)
+            generateCount = strtoull(argv[++i], nullptr, 10);
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (generateCount != 0)
+    {
+        bool written = false;
+        const bool known = withLayout(options.layout, [&](auto parser, auto)
+        {
+            written = makePacketGenerator(parser).generateFrameFile(path, generateCount);
+        });
+        if (!known || !written)
+            fprintf(stderr, known ? "cannot write %s\n" : "unknown layout %s\n", known ? path : options.layout.c_str());
+        return known && written ? 0 : 1;
+    }
+
+    vector<unsigned char> contents;
+    vector<TimedFrame> frames;
+    if (!readCaptureFile(path, contents, frames, options.payload))
+    {
+        fprintf(stderr, "%s is not a readable frame or pcap file\n", path);
+        return 1;
+    }
+    if (frames.empty())
+    {
+        fprintf(stderr, "%s holds no frame\n", path);
+        return 1;
+    }
+
+    if (options.udpPort != 0 || options.tcpPort != 0)
+    {
+#if defined(__linux__)
+        return replayPush(frames, options) ? 0 : 1;
+#else
+        fprintf(stderr, "pushing frames is only available on Linux\n");
+        return 1;
+#endif
+    }
+
+    const bool known = withLayout(options.layout, [&](auto parser, auto output)
+    {
+        replayParse<decltype(parser), decltype(output)>(parser, frames, options);
+    });
+    if (!known)
+    {
+        fprintf(stderr, "unknown layout %s\n", options.layout.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+#include "genericpacketparser.h"
+#include "objectpool.h"
+#include "spscqueue.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace GenericPacketParser
+{
+
+// =============================================================================
+// ShardedParser
+// =============================================================================
+
+/**
+* Struct used to configure a ShardedParser
+*/
+struct ShardingOptions
+{
+    // Number of shard threads
+    size_t shardCount = 4;
+
+    // Frames queued per shard before dispatch waits for the shard
+    size_t queueCapacity = 4096;
+
+    // How idle shards poll their queue
+    WaitStrategy wait = WaitStrategy::Spin;
+};
+
+/**
+* Struct holding the counters of a shard
+*/
+struct ShardStats
+{
+    // Frames parsed by the shard
+    size_t frames;
+
+    // Frames parsed without error
+    size_t parsed;
+
+    // Times dispatch found the shard queue full and waited
+    size_t stalls;
+};
+
+/**
+* Class parsing a frame stream on several threads while keeping the order of frames sharing a key.
+*
+* The key is a value field at a compile-time offset, peeked before the full parse and hashed to a shard.
+* Each shard thread owns a copy of the parser and takes its frames from a lock-free queue, so frames
+* with the same key are parsed and handled in dispatch order.
+*
+* @tparam KeyFieldIndex Index of a value field preceded only by fixed-size fields
+* @tparam OutputType Receiving output struct/class type, default constructible and reused through resetObject
+* @tparam ParserType PacketParser type
+* @tparam Handler Callable as handler(shard, output, result), called concurrently by different shards
+*/
+template <size_t KeyFieldIndex, class OutputType, class ParserType, class Handler>
+class ShardedParser
+{
+public:
+    /**
+    * @param parser Parser copied to every shard
+    * @param handler Receives the parsed frames
+    * @param options Shard count and queue capacity
+    * @see GenericPackerParser::makeShardedParser
+    */
+    ShardedParser(const ParserType& parser, Handler handler, ShardingOptions options = {})
+        : _handler(handler)
+        , _wait(options.wait)
+        , _stopping(false)
+    {
+        const size_t shardCount = options.shardCount > 0 ? options.shardCount : 1;
+        for (size_t i = 0; i < shardCount; ++i)
+            _shards.emplace_back(new Shard(parser, options.queueCapacity));
+
+        for (size_t i = 0; i < shardCount; ++i)
+            _shards[i]->thread = std::thread(&ShardedParser::shardMain, this, i);
+    }
+
+    ShardedParser(const ShardedParser&) = delete;
+    ShardedParser& operator=(const ShardedParser&) = delete;
+
+    ~ShardedParser()
+    {
+        drain();
+        _stopping.store(true, std::memory_order_release);
+        for (std::unique_ptr<Shard>& shard : _shards)
+            shard->thread.join();
+    }
+
+    size_t shardCount() const
+    {
+        return _shards.size();
+    }
+
+    /**
+    * @return Shard parsing the frame, frames too short to hold the key go to shard 0
+    */
+    size_t shardOf(const Frame& frame) const
+    {
+        constexpr size_t keyEnd = ParserType::template fieldOffset<KeyFieldIndex>() + sizeof(KeyType);
+        if (frame.length < keyEnd)
+            return 0;
+
+        // Fibonacci hashing spreads consecutive keys over the shards
+        const uint64_t key = static_cast<uint64_t>(ParserType::template peek<KeyFieldIndex>(frame.data));
+        return static_cast<size_t>(((key * 0x9E3779B97F4A7C15ull) >> 32) % _shards.size());
+    }
+
+    /**
+    * Queues a frame to its shard, waiting while the shard queue is full
+    *
+    * @param frame Frame to parse, its data must stay valid until it is handled
+    * @note Must always be called from the same thread
+    */
+    void dispatch(const Frame& frame)
+    {
+        Shard& shard = *_shards[shardOf(frame)];
+        if (shard.queue.push(frame))
+            return;
+
+        shard.stalls.fetch_add(1, std::memory_order_relaxed);
+        while (!shard.queue.push(frame))
+            std::this_thread::yield();
+    }
+
+    /**
+    * Waits until every dispatched frame has been handled
+    */
+    void drain()
+    {
+        for (std::unique_ptr<Shard>& shard : _shards)
+        {
+            while (!shard->queue.empty() || shard->busy.load(std::memory_order_acquire))
+                std::this_thread::yield();
+        }
+    }
+
+    /**
+    * @return Counters of each shard
+    */
+    std::vector<ShardStats> stats() const
+    {
+        std::vector<ShardStats> stats;
+        for (const std::unique_ptr<Shard>& shard : _shards)
+        {
+            stats.push_back({
+                shard->frames.load(std::memory_order_relaxed),
+                shard->parsed.load(std::memory_order_relaxed),
+                shard->stalls.load(std::memory_order_relaxed)});
+        }
+        return stats;
+    }
+
+    /**
+    * @return Frames of the busiest shard over the mean per shard, 1 being a perfect balance
+    */
+    double imbalance() const
+    {
+        size_t total = 0;
+        size_t busiest = 0;
+        for (const ShardStats& shard : stats())
+        {
+            total += shard.frames;
+            busiest = shard.frames > busiest ? shard.frames : busiest;
+        }
+        return total > 0 ? static_cast<double>(busiest) * _shards.size() / total : 1.0;
+    }
+
+private:
+    using KeyType = typename ParserType::template FieldValueType<KeyFieldIndex>;
+
+    struct alignas(64) Shard
+    {
+        Shard(const ParserType& parser, size_t queueCapacity)
+            : parser(parser)
+            , queue(queueCapacity)
+            , busy(false)
+            , frames(0)
+            , parsed(0)
+            , stalls(0)
+        {
+        }
+
+        ParserType parser;
+        SpscQueue<Frame> queue;
+        std::thread thread;
+
+        // Set while a popped frame is being parsed and handled
+        std::atomic<bool> busy;
+
+        alignas(64) std::atomic<size_t> frames;
+        std::atomic<size_t> parsed;
+        std::atomic<size_t> stalls;
+    };
+
+    Handler _handler;
+    WaitStrategy _wait;
+    std::vector<std::unique_ptr<Shard>> _shards;
+    std::atomic<bool> _stopping;
+
+    void shardMain(size_t index)
+    {
+        Shard& shard = *_shards[index];
+        OutputType output;
+        ParseResult result{};
+        Frame frame{};
+        IdleWait idleWait(_wait);
+        for (;;)
+        {
+            // busy is raised before popping, so drain never sees an empty queue with a frame in flight
+            shard.busy.store(true, std::memory_order_relaxed);
+            if (!shard.queue.pop(frame))
+            {
+                shard.busy.store(false, std::memory_order_release);
+                if (_stopping.load(std::memory_order_acquire))
+                    return;
+                idleWait();
+                continue;
+            }
+            idleWait.reset();
+
+            resetObject(output);
+            shard.parser.parseBatch(Span<const Frame>(&frame, 1), Span<OutputType>(&output, 1), Span<ParseResult>(&result, 1));
+            _handler(index, output, static_cast<const ParseResult&>(result));
+
+            shard.frames.store(shard.frames.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            if (result.error == PacketParserErrorId::NoError)
+                shard.parsed.store(shard.parsed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+};
+
+// =============================================================================
+// Utilities
+// =============================================================================
+
+/**
+* Builds a sharded parser, e.g. makeShardedParser<0, Quote>(parser, handler, options)
+*/
+template <size_t KeyFieldIndex, class OutputType, class ParserType, class Handler>
+ShardedParser<KeyFieldIndex, OutputType, ParserType, Handler> makeShardedParser(const ParserType& parser, Handler handler, ShardingOptions options = {})
+{
+    return {parser, handler, options};
+}
+
+} // namespace GenericPacketParser
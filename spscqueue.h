@@ -0,0 +1,182 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace GenericPacketParser
+{
+
+// =============================================================================
+// SpscQueue
+// =============================================================================
+
+/**
+* Bounded lock-free queue between one producer thread and one consumer thread.
+*
+* Each side caches the last index it read from the other side, so the shared cache lines
+* only move when the queue looks full to the producer or empty to the consumer.
+*
+* @tparam T Copyable element type
+*/
+template <class T>
+class SpscQueue
+{
+public:
+    /**
+    * @param capacity Minimum number of elements, rounded up to a power of two
+    */
+    explicit SpscQueue(size_t capacity)
+        : _mask(roundUpToPowerOfTwo(capacity > 0 ? capacity : 1) - 1)
+        , _slots(_mask + 1)
+        , _tail(0)
+        , _cachedHead(0)
+        , _head(0)
+        , _cachedTail(0)
+    {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    size_t capacity() const
+    {
+        return _mask + 1;
+    }
+
+    /**
+    * Producer side
+    *
+    * @return False if the queue is full
+    */
+    bool push(const T& value)
+    {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _cachedHead > _mask)
+        {
+            _cachedHead = _head.load(std::memory_order_acquire);
+            if (tail - _cachedHead > _mask)
+                return false;
+        }
+
+        _slots[tail & _mask] = value;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+    * Consumer side
+    *
+    * @return False if the queue is empty
+    */
+    bool pop(T& value)
+    {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _cachedTail)
+        {
+            _cachedTail = _tail.load(std::memory_order_acquire);
+            if (head == _cachedTail)
+                return false;
+        }
+
+        value = _slots[head & _mask];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+    * @return Number of queued elements, exact only when called from one of the two sides while the other is idle
+    */
+    size_t size() const
+    {
+        return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+private:
+    const size_t _mask;
+    std::vector<T> _slots;
+
+    // Producer side
+    alignas(64) std::atomic<size_t> _tail;
+    size_t _cachedHead;
+
+    // Consumer side
+    alignas(64) std::atomic<size_t> _head;
+    size_t _cachedTail;
+
+    static size_t roundUpToPowerOfTwo(size_t value)
+    {
+        size_t power = 1;
+        while (power < value)
+            power <<= 1;
+        return power;
+    }
+};
+
+// =============================================================================
+// IdleWait
+// =============================================================================
+
+enum class WaitStrategy
+{
+    // Yields between polls: the lowest wake-up latency, but an idle thread keeps its CPU busy
+    Spin,
+    // Yields for a few polls then sleeps, doubling the sleep up to maxSleep, so idle threads free their CPU
+    Backoff
+};
+
+/**
+* Class pacing a thread polling a queue found empty or full
+*/
+class IdleWait
+{
+public:
+    static constexpr size_t yieldCount = 64;
+    static constexpr std::chrono::microseconds maxSleep{256};
+
+    explicit IdleWait(WaitStrategy strategy)
+        : _strategy(strategy)
+        , _idleCount(0)
+        , _sleep(1)
+    {
+    }
+
+    /**
+    * Waits before the next poll
+    */
+    void operator()()
+    {
+        if (_strategy == WaitStrategy::Spin || _idleCount < yieldCount)
+        {
+            ++_idleCount;
+            std::this_thread::yield();
+            return;
+        }
+
+        std::this_thread::sleep_for(_sleep);
+        _sleep = _sleep * 2 < maxSleep ? _sleep * 2 : maxSleep;
+    }
+
+    /**
+    * Restarts the pacing after a successful poll
+    */
+    void reset()
+    {
+        _idleCount = 0;
+        _sleep = std::chrono::microseconds(1);
+    }
+
+private:
+    WaitStrategy _strategy;
+    size_t _idleCount;
+    std::chrono::microseconds _sleep;
+};
+
+} // namespace GenericPacketParser
@@ -0,0 +1,254 @@
+#pragma once
+
+#include "genericpacketparser.h"
+
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
+
+namespace GenericPacketParser
+{
+
+// =============================================================================
+// InternedText
+// =============================================================================
+
+/**
+* Text interned by a StringInterner
+*/
+struct InternedText
+{
+    // Equal for equal texts, numbered from 0 in order of first appearance
+    uint32_t id;
+
+    // Pooled copy of the text, null-terminated, valid as long as its interner
+    std::string_view text;
+};
+
+// =============================================================================
+// StringInterner
+// =============================================================================
+
+/**
+* Class mapping texts to stable small IDs and pooled copies, so repeated texts are stored once
+* and compared as integers.
+*
+* The table is probed a group of 16 slots at a time, as in SwissTable: each slot has a control byte holding
+* 7 bits of the hash of its text, compared to those of the looked-up text for the whole group in one SSE2
+* instruction. Texts are only compared on a likely match, and pooled texts never move when the table grows.
+*
+* @note Not thread-safe: parsers copied for other threads share the interner of their interned fields,
+* so they need one interner each, IDs being then per interner
+*/
+class StringInterner
+{
+public:
+    static constexpr uint32_t invalidId = UINT32_MAX;
+
+    /**
+    * @param capacity Number of texts held before the table grows
+    */
+    explicit StringInterner(size_t capacity = 1024)
+    {
+        size_t groupCount = 1;
+        while (groupCount * groupSize * 7 / 8 < capacity)
+            groupCount *= 2;
+        allocate(groupCount);
+    }
+
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+
+    InternedText intern(std::string_view text)
+    {
+        return intern(text.data(), text.size(), hashText(text.data(), text.size()));
+    }
+
+    /**
+    * Finds a text, or adds it
+    *
+    * @param text Characters of the text, not necessarily null-terminated
+    * @param length Length of the text
+    * @param hash Hash of the text, as computed by hashText or scanText
+    */
+    InternedText intern(const char* text, size_t length, uint64_t hash)
+    {
+        uint32_t id = lookup(text, length, hash);
+        if (id == invalidId)
+        {
+            id = static_cast<uint32_t>(_texts.size());
+            _texts.push_back(pool(text, length));
+            _hashes.push_back(hash);
+            if (_texts.size() > _maxSize)
+                grow();
+            else
+                insert(id, hash);
+        }
+        return {id, _texts[id]};
+    }
+
+    /**
+    * @return ID of a text, or invalidId if it was never interned
+    */
+    uint32_t find(std::string_view text) const
+    {
+        return lookup(text.data(), text.size(), hashText(text.data(), text.size()));
+    }
+
+    /**
+    * @return Pooled text of an ID
+    */
+    std::string_view text(uint32_t id) const
+    {
+        return _texts[id];
+    }
+
+    /**
+    * Number of distinct texts
+    */
+    size_t size() const
+    {
+        return _texts.size();
+    }
+
+    /**
+    * Bytes taken by the table and the pooled texts
+    */
+    size_t memoryUsage() const
+    {
+        return _control.size() * (sizeof(int8_t) + sizeof(uint32_t))
+            + _texts.size() * (sizeof(std::string_view) + sizeof(uint64_t))
+            + _poolBytes;
+    }
+
+private:
+    static constexpr size_t groupSize = 16;
+    static constexpr int8_t emptyControl = -128;
+    static constexpr size_t poolBlockSize = 64 * 1024;
+
+    void allocate(size_t groupCount)
+    {
+        _control.assign(groupCount * groupSize, emptyControl);
+        _slots.assign(groupCount * groupSize, 0);
+        _groupMask = groupCount - 1;
+        _maxSize = groupCount * groupSize * 7 / 8;
+    }
+
+    void grow()
+    {
+        allocate((_groupMask + 1) * 2);
+        for (uint32_t id = 0; id < _texts.size(); ++id)
+            insert(id, _hashes[id]);
+    }
+
+    /**
+    * @return Bit i set for each slot i of a group whose control byte equals control
+    */
+    uint32_t matchGroup(size_t group, int8_t control) const
+    {
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&_control[group * groupSize]));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(control))));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < groupSize; ++i)
+            mask |= _control[group * groupSize + i] == control ? 1u << i : 0u;
+        return mask;
+#endif
+    }
+
+    static size_t lowestBit(uint32_t mask)
+    {
+#if defined(__GNUC__)
+        return __builtin_ctz(mask);
+#else
+        size_t bit = 0;
+        for (; (mask & 1) == 0; mask >>= 1)
+            ++bit;
+        return bit;
+#endif
+    }
+
+    // The low 7 bits of the hash go to the control bytes, the others pick the first group to probe.
+    // Groups are then visited at triangular offsets, which covers all of them for a power-of-2 count
+
+    uint32_t lookup(const char* text, size_t length, uint64_t hash) const
+    {
+        const int8_t control = static_cast<int8_t>(hash & 0x7f);
+        size_t group = static_cast<size_t>(hash >> 7) & _groupMask;
+        for (size_t probe = 1;; ++probe)
+        {
+            for (uint32_t mask = matchGroup(group, control); mask != 0; mask &= mask - 1)
+            {
+                const uint32_t id = _slots[group * groupSize + lowestBit(mask)];
+                if (_hashes[id] == hash && _texts[id].size() == length && std::memcmp(_texts[id].data(), text, length) == 0)
+                    return id;
+            }
+
+            // Texts are never removed, so an empty slot ends the probe sequence
+            if (matchGroup(group, emptyControl) != 0)
+                return invalidId;
+            group = (group + probe) & _groupMask;
+        }
+    }
+
+    void insert(uint32_t id, uint64_t hash)
+    {
+        size_t group = static_cast<size_t>(hash >> 7) & _groupMask;
+        for (size_t probe = 1;; ++probe)
+        {
+            const uint32_t mask = matchGroup(group, emptyControl);
+            if (mask != 0)
+            {
+                const size_t slot = group * groupSize + lowestBit(mask);
+                _control[slot] = static_cast<int8_t>(hash & 0x7f);
+                _slots[slot] = id;
+                return;
+            }
+            group = (group + probe) & _groupMask;
+        }
+    }
+
+    /**
+    * Copies a text and its terminator to the pool
+    */
+    std::string_view pool(const char* text, size_t length)
+    {
+        if (length + 1 > _blockRemaining)
+        {
+            const size_t blockSize = length + 1 > poolBlockSize ? length + 1 : poolBlockSize;
+            _blocks.emplace_back(new char[blockSize]);
+            _blockCursor = _blocks.back().get();
+            _blockRemaining = blockSize;
+            _poolBytes += blockSize;
+        }
+
+        char* const copy = _blockCursor;
+        std::memcpy(copy, text, length);
+        copy[length] = '\0';
+        _blockCursor += length + 1;
+        _blockRemaining -= length + 1;
+        return {copy, length};
+    }
+
+    std::vector<int8_t> _control;
+    std::vector<uint32_t> _slots;
+    size_t _groupMask = 0;
+    size_t _maxSize = 0;
+
+    // Indexed by ID
+    std::vector<std::string_view> _texts;
+    std::vector<uint64_t> _hashes;
+
+    std::vector<std::unique_ptr<char[]>> _blocks;
+    char* _blockCursor = nullptr;
+    size_t _blockRemaining = 0;
+    size_t _poolBytes = 0;
+};
+
+} // namespace GenericPacketParser
@@ -1,8 +1,23 @@
 #include "gtest/gtest.h"
+#include <chrono>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "columnbatch.h"
+#include "fieldinstrumentation.h"
 #include "genericpacketparser.h"
+#include "latencyhistogram.h"
+#include "objectpool.h"
+#include "packetbatcher.h"
+#include "packetgenerator.h"
+#include "packettranscoder.h"
+#include "packetwriter.h"
+#include "parallelparser.h"
+#include "parserstats.h"
+#include "pipeline.h"
+#include "shardedparser.h"
+#include "stringinterner.h"
 
 using namespace std;
 using namespace GenericPacketParser;
@@ -116,3 +131,1660 @@ TEST_F(Test, Demo2)
     auto error = parser2.parse(data2, 18, output);
     cout << error << '\n';
 }
+
+TEST_F(Test, WriterRoundTrip)
+{
+    auto parser = makePacketParser(
+        WITH_GETTER(TEXT_FIELD(&MyPacket::setName, 16), &MyPacket::name),
+        WITH_GETTER(VALUE_FIELD(&MyPacket::setValue, uint32_t), &MyPacket::value),
+        DYNAMIC_ARRAY(uint8_t,
+            WITH_GETTER(MULTI_FIELD(SubPacket, &MyPacket::addToArray,
+                WITH_GETTER(TEXT_FIELD_ALLOW_EMPTY(&SubPacket::setName, 16), &SubPacket::name),
+                WITH_GETTER(VALUE_FIELD_ENDIAN(&SubPacket::setValue, uint32_t), &SubPacket::value)
+            ), &MyPacket::array)
+        )
+    );
+    auto writer = makePacketWriter(parser);
+
+    MyPacket input{"Alexandre Dumas", 257, {{"", 1}, {"Aramis", 2}, {"Athos", 3}, {"Porthos", 4}}, {}};
+    vector<unsigned char> buffer;
+    ASSERT_EQ(writer.write(input, buffer), PacketParserErrorId::NoError);
+    EXPECT_EQ(buffer.size(), 59u);
+    EXPECT_EQ(buffer[25], 0x01); // Big endian array value
+
+    MyPacket output{};
+    ASSERT_EQ(parser.parse(buffer.data(), buffer.size(), output), PacketParserErrorId::NoError);
+    EXPECT_EQ(output.name, input.name);
+    EXPECT_EQ(output.value, input.value);
+    ASSERT_EQ(output.array.size(), input.array.size());
+    for (size_t i = 0; i < input.array.size(); ++i)
+    {
+        EXPECT_EQ(output.array[i].name, input.array[i].name);
+        EXPECT_EQ(output.array[i].value, input.array[i].value);
+    }
+
+    // Invalid inputs are reported before anything is written
+    input.name = "This name is way too long";
+    EXPECT_EQ(writer.write(input, buffer), PacketParserErrorId::InvalidText);
+    input.name = "";
+    EXPECT_EQ(writer.write(input, buffer), PacketParserErrorId::EmptyTextNotAllowed);
+}
+
+TEST_F(Test, WriterConstantWireSize)
+{
+    auto writer = makePacketWriter(
+        WITH_GETTER(VALUE_FIELD(&SubPacket::setValue, uint32_t), &SubPacket::value),
+        WITH_GETTER(VALUE_FIELD_ENDIAN(&SubPacket::setValue, uint32_t), &SubPacket::value));
+    static_assert(decltype(writer)::hasConstantWireSize && decltype(writer)::constantWireSize == 8);
+
+    SubPacket input{"", 0x01020304};
+    unsigned char buffer[8];
+    size_t written = 0;
+    EXPECT_EQ(writer.write(input, buffer, 7, written), PacketParserErrorId::ExceededDataRange);
+    ASSERT_EQ(writer.write(input, buffer, sizeof(buffer), written), PacketParserErrorId::NoError);
+    EXPECT_EQ(written, 8u);
+    EXPECT_EQ(loadUnaligned<uint32_t>(buffer), 0x01020304u);
+    EXPECT_EQ(buffer[4], 0x01);
+    EXPECT_EQ(buffer[7], 0x04);
+}
+
+struct BlobPacket
+{
+    string name;
+    vector<unsigned char> payload;
+    void setName(const char* s) { name = s; }
+    void setPayload(const unsigned char* data, size_t length) { payload.assign(data, data + length); }
+};
+
+TEST_F(Test, WriterGather)
+{
+    auto writer = makePacketWriter(
+        WITH_GETTER(TEXT_FIELD(&BlobPacket::setName, 16), &BlobPacket::name),
+        WITH_GETTER(BINARY_FIELD(uint16_t, &BlobPacket::setPayload), &BlobPacket::payload));
+
+    BlobPacket input{"blob", vector<unsigned char>(4096, 0xAB)};
+    vector<unsigned char> contiguous;
+    ASSERT_EQ(writer.write(input, contiguous), PacketParserErrorId::NoError);
+
+    vector<unsigned char> framing;
+    vector<IoVec> segments;
+    ASSERT_EQ(writer.writeGather(input, framing, segments), PacketParserErrorId::NoError);
+
+    // Only the name and the payload size are copied
+    EXPECT_EQ(framing.size(), 7u);
+    ASSERT_EQ(segments.size(), 2u);
+    EXPECT_EQ(segments[1].iov_base, input.payload.data());
+    EXPECT_EQ(segments[1].iov_len, input.payload.size());
+
+    vector<unsigned char> gathered;
+    for (const IoVec& segment : segments)
+    {
+        const unsigned char* base = static_cast<const unsigned char*>(segment.iov_base);
+        gathered.insert(gathered.end(), base, base + segment.iov_len);
+    }
+    EXPECT_EQ(gathered, contiguous);
+
+    // Everything is copied when payloads are below the threshold
+    ASSERT_EQ(writer.writeGather(input, framing, segments, 8192), PacketParserErrorId::NoError);
+    ASSERT_EQ(segments.size(), 1u);
+    EXPECT_EQ(framing, contiguous);
+}
+
+struct ValueCounter
+{
+    size_t count = 0;
+    void addValue(uint8_t) { ++count; }
+};
+
+TEST_F(Test, TruncatedPackets)
+{
+    auto blobParser = makePacketParser(
+        TEXT_FIELD(&BlobPacket::setName, 16),
+        BINARY_FIELD(uint16_t, &BlobPacket::setPayload));
+    const vector<unsigned char> blob = {'b', 'l', 'o', 'b', 0, 3, 0, 0xAA, 0xBB, 0xCC};
+
+    auto parser = makePacketParser(
+        VALUE_FIELD(&MyPacket::setValue, uint32_t),
+        DYNAMIC_ARRAY(uint16_t,
+            MULTI_FIELD(SubPacket, &MyPacket::addToArray,
+                TEXT_FIELD_ALLOW_EMPTY(&SubPacket::setName, 16),
+                VALUE_FIELD(&SubPacket::setValue, uint32_t))));
+    const vector<unsigned char> packet = {1, 0, 0, 0, 2, 0, 'P', 0, 1, 0, 0, 0, 0, 2, 0, 0, 0};
+
+    // Each prefix gets a buffer of its own size, so sanitizers catch any read past its end
+    for (size_t length = 0; length <= blob.size(); ++length)
+    {
+        const vector<unsigned char> truncated(blob.begin(), blob.begin() + length);
+        BlobPacket output;
+        EXPECT_EQ(blobParser.parse(truncated.data(), length, output) == PacketParserErrorId::NoError, length == blob.size());
+    }
+
+    for (size_t length = 0; length <= packet.size(); ++length)
+    {
+        const vector<unsigned char> truncated(packet.begin(), packet.begin() + length);
+        MyPacket output;
+        EXPECT_EQ(parser.parse(truncated.data(), length, output) == PacketParserErrorId::NoError, length == packet.size());
+    }
+
+    // A forged array size stops at the first element out of range
+    auto valuesParser = makePacketParser(DYNAMIC_ARRAY(uint32_t, VALUE_FIELD(&ValueCounter::addValue, uint8_t)));
+    const vector<unsigned char> hugeArray = {0xff, 0xff, 0xff, 0xff, 1, 2, 3, 4, 5, 6, 7, 8};
+    ValueCounter counter;
+    EXPECT_EQ(valuesParser.parse(hugeArray.data(), hugeArray.size(), counter), PacketParserErrorId::ExceededDataRange);
+    EXPECT_EQ(counter.count, 8u);
+}
+
+struct RelayPacket
+{
+    uint32_t sequence;
+    uint16_t checksum;
+    uint8_t ttl;
+    uint64_t timestamp;
+    string name;
+    void setSequence(uint32_t v) { sequence = v; }
+    void setChecksum(uint16_t v) { checksum = v; }
+    void setTtl(uint8_t v) { ttl = v; }
+    void setTimestamp(uint64_t v) { timestamp = v; }
+    void setName(const char* s) { name = s; }
+};
+
+TEST_F(Test, PeekAndPatch)
+{
+    auto parser = makePacketParser(
+        WITH_GETTER(VALUE_FIELD_ENDIAN(&RelayPacket::setSequence, uint32_t), &RelayPacket::sequence),
+        WITH_GETTER(VALUE_FIELD(&RelayPacket::setChecksum, uint16_t), &RelayPacket::checksum),
+        WITH_GETTER(VALUE_FIELD(&RelayPacket::setTtl, uint8_t), &RelayPacket::ttl),
+        WITH_GETTER(VALUE_FIELD_ENDIAN(&RelayPacket::setTimestamp, uint64_t), &RelayPacket::timestamp),
+        WITH_GETTER(TEXT_FIELD(&RelayPacket::setName, 16), &RelayPacket::name));
+    using Parser = decltype(parser);
+    static_assert(Parser::fixedFieldCount == 4);
+    static_assert(Parser::fixedPrefixLength == 15);
+    static_assert(Parser::fieldOffset<3>() == 7);
+
+    RelayPacket input{0x01020304, 0, 64, 123456789, "relay"};
+    vector<unsigned char> buffer;
+    ASSERT_EQ(makePacketWriter(parser).write(input, buffer), PacketParserErrorId::NoError);
+
+    EXPECT_EQ(Parser::peek<0>(buffer.data()), 0x01020304u);
+    EXPECT_EQ(buffer[0], 0x01);
+    EXPECT_EQ(Parser::peek<2>(buffer.data()), 64);
+    EXPECT_EQ(Parser::peek<3>(buffer.data()), 123456789u);
+
+    Parser::patch<0>(buffer.data(), 0x0A0B0C0D);
+    EXPECT_EQ(Parser::peek<0>(buffer.data()), 0x0A0B0C0Du);
+    EXPECT_EQ(buffer[0], 0x0A);
+
+    storeUnaligned(&buffer[4], internetChecksum(buffer.data(), buffer.size()));
+
+    // Incrementally updated checksums match a full computation, fields at odd offsets included
+    Parser::patchWithChecksum<0, 1>(buffer.data(), 0x11121314);
+    Parser::patchWithChecksum<2, 1>(buffer.data(), 63);
+    Parser::patchWithChecksum<3, 1>(buffer.data(), 987654321);
+    EXPECT_EQ(onesComplementSum(buffer.data(), buffer.size()), 0xffff);
+
+    RelayPacket output{};
+    ASSERT_EQ(parser.parse(buffer.data(), buffer.size(), output), PacketParserErrorId::NoError);
+    EXPECT_EQ(output.sequence, 0x11121314u);
+    EXPECT_EQ(output.ttl, 63);
+    EXPECT_EQ(output.timestamp, 987654321u);
+    EXPECT_EQ(output.name, "relay");
+}
+
+TEST_F(Test, Introspection)
+{
+    auto parser = makePacketParser(
+        VALUE_FIELD_ENDIAN(&RelayPacket::setSequence, uint32_t),
+        VALUE_FIELD(&RelayPacket::setTtl, uint8_t),
+        TEXT_FIELD(&RelayPacket::setName, 16),
+        STATIC_ARRAY(3, VALUE_FIELD(&RelayPacket::setChecksum, uint16_t)));
+    using Parser = decltype(parser);
+    static_assert(Parser::fieldCount == 4);
+    static_assert(Parser::fieldTypeId(0) == FieldTypeId::ValueField);
+    static_assert(Parser::fieldTypeId(2) == FieldTypeId::TextField);
+    static_assert(Parser::fieldTypeId(3) == FieldTypeId::StaticFieldArray);
+    static_assert(Parser::fixedFieldCount == 2);
+    static_assert(Parser::fixedPrefixLength == 5);
+    static_assert(Parser::fieldOffset<2>() == 5);
+
+    // Static arrays are counted with one element from the type, with their size from the parser
+    static_assert(Parser::minWireSizeBound == 4 + 1 + 2 + 2);
+    EXPECT_EQ(parser.minWireSize(), 4u + 1 + 2 + 6);
+    EXPECT_EQ(parser.maxWireSize(), 4u + 1 + 16 + 6);
+
+    // Shorter packets are rejected before any setter is called
+    const unsigned char data[] = {0, 0, 0, 1, 64, 'a', 0, 1, 0, 2, 0, 3, 0};
+    RelayPacket output{};
+    EXPECT_EQ(parser.parse(data, sizeof(data) - 1, output), PacketParserErrorId::ExceededDataRange);
+    EXPECT_EQ(output.sequence, 0u);
+    EXPECT_EQ(parser.parse(data, sizeof(data), output), PacketParserErrorId::NoError);
+    EXPECT_EQ(output.sequence, 1u);
+
+    // Size prefixes bound binary fields and dynamic arrays, unless they overflow
+    auto bounded = makePacketParser(DYNAMIC_ARRAY(uint16_t, VALUE_FIELD(&RelayPacket::setTtl, uint8_t)));
+    EXPECT_EQ(bounded.minWireSize(), 2u);
+    EXPECT_EQ(bounded.maxWireSize(), 2u + 65535);
+    auto unbounded = makePacketParser(DYNAMIC_ARRAY(uint64_t, STATIC_ARRAY(2, VALUE_FIELD(&RelayPacket::setTtl, uint8_t))));
+    EXPECT_EQ(unbounded.maxWireSize(), SIZE_MAX);
+}
+
+struct VersionedPacket
+{
+    string name;
+    uint32_t value;
+    uint64_t timestamp;
+    vector<SubPacket> array;
+    void setName(const char* s) { name = s; }
+    void setValue(uint32_t v) { value = v; }
+    void setShortValue(uint16_t v) { value = v; }
+    void setTimestamp(uint64_t v) { timestamp = v; }
+    void addToArray(SubPacket& sp) { array.emplace_back(sp); }
+};
+
+TEST_F(Test, Transcoder)
+{
+    auto subPacket = WITH_GETTER(MULTI_FIELD(SubPacket, &VersionedPacket::addToArray,
+        WITH_GETTER(TEXT_FIELD_ALLOW_EMPTY(&SubPacket::setName, 16), &SubPacket::name),
+        WITH_GETTER(VALUE_FIELD_ENDIAN(&SubPacket::setValue, uint32_t), &SubPacket::value)
+    ), &VersionedPacket::array);
+
+    auto version1 = makePacketParser(
+        WITH_GETTER(TEXT_FIELD(&VersionedPacket::setName, 16), &VersionedPacket::name),
+        WITH_GETTER(VALUE_FIELD(&VersionedPacket::setShortValue, uint16_t), &VersionedPacket::value),
+        WITH_GETTER(VALUE_FIELD_ENDIAN(&VersionedPacket::setTimestamp, uint64_t), &VersionedPacket::timestamp),
+        DYNAMIC_ARRAY(uint8_t, subPacket));
+
+    // Reordered, widened, byte order changed and larger array size
+    auto version2 = makePacketParser(
+        VALUE_FIELD(&VersionedPacket::setTimestamp, uint64_t),
+        VALUE_FIELD(&VersionedPacket::setValue, uint32_t),
+        TEXT_FIELD(&VersionedPacket::setName, 8),
+        DYNAMIC_ARRAY(uint16_t, subPacket));
+
+    VersionedPacket input{"Dumas", 1844, 0x0102030405060708, {{"Aramis", 2}, {"", 3}}};
+    vector<unsigned char> source;
+    ASSERT_EQ(makePacketWriter(version1).write(input, source), PacketParserErrorId::NoError);
+
+    auto transcoder = makePacketTranscoder<2, 1, 0, 3>(version1, version2);
+    vector<unsigned char> target;
+    ASSERT_EQ(transcoder.transcode(source.data(), source.size(), target), PacketParserErrorId::NoError);
+    EXPECT_EQ(target.size(), source.size() + 2 + 1);
+
+    VersionedPacket output{};
+    ASSERT_EQ(version2.parse(target.data(), target.size(), output), PacketParserErrorId::NoError);
+    EXPECT_EQ(output.name, input.name);
+    EXPECT_EQ(output.value, input.value);
+    EXPECT_EQ(output.timestamp, input.timestamp);
+    ASSERT_EQ(output.array.size(), 2u);
+    EXPECT_EQ(output.array[0].name, "Aramis");
+    EXPECT_EQ(output.array[1].value, 3u);
+
+    // Identical layouts are copied as a whole
+    vector<unsigned char> copy;
+    ASSERT_EQ(makePacketTranscoder(version1, version1).transcode(source.data(), source.size(), copy), PacketParserErrorId::NoError);
+    EXPECT_EQ(copy, source);
+
+    // Source errors and target constraints are reported
+    EXPECT_EQ(transcoder.transcode(source.data(), source.size() - 1, target), PacketParserErrorId::ExceededDataRange);
+    input.name = "Alexandre Dumas";
+    ASSERT_EQ(makePacketWriter(version1).write(input, source), PacketParserErrorId::NoError);
+    EXPECT_EQ(transcoder.transcode(source.data(), source.size(), target), PacketParserErrorId::MissingNullTerminator);
+}
+
+struct Batch
+{
+    uint32_t session = 0;
+    vector<SubPacket> messages;
+    void setSession(uint32_t v) { session = v; }
+    void addMessage(SubPacket& sp) { messages.emplace_back(sp); }
+};
+
+TEST_F(Test, Batcher)
+{
+    auto message = MULTI_FIELD(SubPacket, &Batch::addMessage,
+        WITH_GETTER(TEXT_FIELD(&SubPacket::setName, 16), &SubPacket::name),
+        WITH_GETTER(VALUE_FIELD(&SubPacket::setValue, uint32_t), &SubPacket::value));
+    auto batchParser = makePacketParser(
+        VALUE_FIELD(&Batch::setSession, uint32_t),
+        DYNAMIC_ARRAY(uint16_t, message));
+
+    BatchingOptions options;
+    options.maxBatchSize = 32;
+    options.maxDelay = chrono::milliseconds(10);
+    const vector<unsigned char> header{0x2A, 0, 0, 0};
+    auto batcher = makePacketBatcher(makePacketWriter(std::get<0>(message.fields), std::get<1>(message.fields)), header, options);
+
+    // 4 + 2 bytes of framing leave room for two 10-byte messages
+    const auto start = chrono::steady_clock::now();
+    ASSERT_EQ(batcher.append(SubPacket{"Athos", 1}, start), PacketParserErrorId::NoError);
+    ASSERT_EQ(batcher.append(SubPacket{"Athos", 2}, start), PacketParserErrorId::NoError);
+    EXPECT_TRUE(batcher.readyBatches().empty());
+    ASSERT_EQ(batcher.append(SubPacket{"Athos", 3}, start), PacketParserErrorId::NoError);
+    ASSERT_EQ(batcher.readyBatches().size(), 1u);
+    EXPECT_EQ(batcher.readyBatches()[0].iov_len, 26u);
+    EXPECT_EQ(batcher.pendingMessages(), 1u);
+
+    // Flush on delay
+    batcher.poll(start + chrono::milliseconds(5));
+    EXPECT_EQ(batcher.readyBatches().size(), 1u);
+    batcher.poll(start + chrono::milliseconds(10));
+    ASSERT_EQ(batcher.readyBatches().size(), 2u);
+
+    uint32_t expectedValue = 1;
+    for (const IoVec& segment : batcher.readyBatches())
+    {
+        Batch batch;
+        ASSERT_EQ(batchParser.parse(static_cast<const unsigned char*>(segment.iov_base), segment.iov_len, batch), PacketParserErrorId::NoError);
+        EXPECT_EQ(batch.session, 42u);
+        for (const SubPacket& sp : batch.messages)
+            EXPECT_EQ(sp.value, expectedValue++);
+    }
+    EXPECT_EQ(expectedValue, 4u);
+
+    batcher.releaseBatches();
+    EXPECT_TRUE(batcher.readyBatches().empty());
+
+    // Without outer header, batches start with the message count
+    auto headerless = makePacketBatcher(makePacketWriter(std::get<0>(message.fields), std::get<1>(message.fields)), {}, options);
+    ASSERT_EQ(headerless.append(SubPacket{"Athos", 1}, start), PacketParserErrorId::NoError);
+    headerless.flush();
+    ASSERT_EQ(headerless.readyBatches().size(), 1u);
+    EXPECT_EQ(headerless.readyBatches()[0].iov_len, 12u);
+}
+
+TEST_F(Test, Generator)
+{
+    auto parser = makePacketParser(
+        TEXT_FIELD(&MyPacket::setName, 16),
+        VALUE_FIELD(&MyPacket::setValue, uint32_t),
+        DYNAMIC_ARRAY(uint8_t,
+            MULTI_FIELD(SubPacket, &MyPacket::addToArray,
+                TEXT_FIELD_ALLOW_EMPTY(&SubPacket::setName, 16),
+                VALUE_FIELD_ENDIAN(&SubPacket::setValue, uint32_t)
+            )
+        )
+    );
+
+    // Valid packets only
+    GeneratorOptions options;
+    options.textLength = {0, 64, SizeDistribution::Shape::Skewed};
+    auto generator = makePacketGenerator(parser, options);
+    vector<unsigned char> data;
+    vector<Frame> frames;
+    EXPECT_EQ(generator.generateCorpus(1000, data, frames), 0u);
+    ASSERT_EQ(frames.size(), 1000u);
+    EXPECT_EQ(frames.back().data + frames.back().length, data.data() + data.size());
+    for (const Frame& frame : frames)
+    {
+        MyPacket output{};
+        ASSERT_EQ(parser.parse(frame.data, frame.length, output), PacketParserErrorId::NoError);
+    }
+
+    // Every packet corrupted, most of them fail to parse
+    options.corruptionRate = 1.0;
+    auto corruptingGenerator = makePacketGenerator(parser, options);
+    EXPECT_EQ(corruptingGenerator.generateCorpus(1000, data, frames), 1000u);
+    size_t errors = 0;
+    for (const Frame& frame : frames)
+    {
+        MyPacket output{};
+        errors += parser.parse(frame.data, frame.length, output) != PacketParserErrorId::NoError ? 1 : 0;
+    }
+    EXPECT_GT(errors, 500u);
+
+    // Frame file round trip
+    const char* path = "generator_test.frames";
+    ASSERT_TRUE(generator.generateFrameFile(path, 100, 500));
+    vector<unsigned char> contents;
+    vector<TimedFrame> timedFrames;
+    ASSERT_TRUE(readFrameFile(path, contents, timedFrames));
+    remove(path);
+    ASSERT_EQ(timedFrames.size(), 100u);
+    EXPECT_EQ(timedFrames[99].timestamp, 99u * 500);
+    MyPacket output{};
+    EXPECT_EQ(parser.parse(timedFrames[99].frame.data, timedFrames[99].frame.length, output), PacketParserErrorId::NoError);
+}
+
+TEST_F(Test, PcapFile)
+{
+    const unsigned char payload[] = {'q', 'u', 'o', 't', 'e'};
+
+    // Ethernet with a VLAN tag, IPv4, UDP, then padding to the Ethernet minimum
+    vector<unsigned char> udpPacket = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 0x81, 0x00, 0x00, 0x07, 0x08, 0x00,
+        0x45, 0, 0, 20 + 8 + 5, 0, 0, 0x40, 0, 64, 17, 0, 0, 127, 0, 0, 1, 127, 0, 0, 1,
+        0x30, 0x39, 0x30, 0x39, 0, 8 + 5, 0, 0};
+    udpPacket.insert(udpPacket.end(), payload, payload + sizeof(payload));
+    udpPacket.resize(64, 0);
+
+    // Ethernet, IPv6, TCP with options, then a TCP segment without payload
+    vector<unsigned char> tcpPacket = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 0x86, 0xDD,
+        0x60, 0, 0, 0, 0, 24 + 3, 6, 64};
+    tcpPacket.resize(tcpPacket.size() + 32, 0);
+    const unsigned char tcpHeader[24] = {0x30, 0x39, 0x30, 0x39, 0, 0, 0, 1, 0, 0, 0, 0, 0x60, 0x18};
+    tcpPacket.insert(tcpPacket.end(), tcpHeader, tcpHeader + sizeof(tcpHeader));
+    tcpPacket.insert(tcpPacket.end(), payload, payload + 3);
+    vector<unsigned char> ackPacket(tcpPacket.begin(), tcpPacket.end() - 3);
+    ackPacket[14 + 5] = 24;
+
+    const char* path = "pcap_test.pcap";
+    FILE* file = fopen(path, "wb");
+    ASSERT_NE(file, nullptr);
+    const uint32_t fileHeader[] = {0xa1b2c3d4, 0x00040002, 0, 0, 65535, 1};
+    fwrite(fileHeader, sizeof(fileHeader), 1, file);
+    uint32_t second = 0;
+    for (const vector<unsigned char>* packet : {&udpPacket, &tcpPacket, &ackPacket})
+    {
+        const uint32_t length = static_cast<uint32_t>(packet->size());
+        const uint32_t recordHeader[] = {++second, 250, length, length};
+        fwrite(recordHeader, sizeof(recordHeader), 1, file);
+        fwrite(packet->data(), packet->size(), 1, file);
+    }
+    fclose(file);
+
+    vector<unsigned char> contents;
+    vector<TimedFrame> frames;
+    ASSERT_TRUE(readCaptureFile(path, contents, frames));
+    ASSERT_EQ(frames.size(), 2u);
+    EXPECT_EQ(frames[0].timestamp, 1000250000u);
+    EXPECT_EQ(string(reinterpret_cast<const char*>(frames[0].frame.data), frames[0].frame.length), "quote");
+    EXPECT_EQ(frames[1].timestamp, 2000250000u);
+    EXPECT_EQ(string(reinterpret_cast<const char*>(frames[1].frame.data), frames[1].frame.length), "quo");
+
+    ASSERT_TRUE(readPcapFile(path, contents, frames, CapturePayload::LinkLayer));
+    ASSERT_EQ(frames.size(), 3u);
+    EXPECT_EQ(frames[0].frame.length, 64u);
+    remove(path);
+}
+
+TEST_F(Test, ParseBatch)
+{
+    auto parser = makePacketParser(
+        TEXT_FIELD(&MyPacket::setName, 16),
+        VALUE_FIELD(&MyPacket::setValue, uint32_t),
+        DYNAMIC_ARRAY(uint8_t,
+            MULTI_FIELD(SubPacket, &MyPacket::addToArray,
+                TEXT_FIELD_ALLOW_EMPTY(&SubPacket::setName, 16),
+                VALUE_FIELD_ENDIAN(&SubPacket::setValue, uint32_t)
+            )
+        )
+    );
+
+    GeneratorOptions options;
+    options.corruptionRate = 0.3;
+    auto generator = makePacketGenerator(parser, options);
+    vector<unsigned char> data;
+    vector<Frame> frames;
+    generator.generateCorpus(500, data, frames);
+
+    vector<MyPacket> outputs(frames.size(), MyPacket{});
+    vector<ParseResult> results(frames.size());
+    const size_t parsed = parser.parseBatch(Span<const Frame>(frames), Span<MyPacket>(outputs), Span<ParseResult>(results));
+
+    // Errors do not stop the batch, every frame matches an individual parse
+    size_t expectedParsed = 0;
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+        MyPacket expected{};
+        const PacketParserErrorId error = parser.parse(frames[i].data, frames[i].length, expected);
+        expectedParsed += error == PacketParserErrorId::NoError ? 1 : 0;
+        ASSERT_EQ(results[i].error, error);
+        ASSERT_LE(results[i].length, frames[i].length);
+        if (error == PacketParserErrorId::NoError)
+        {
+            EXPECT_EQ(results[i].length, frames[i].length);
+            EXPECT_EQ(outputs[i].name, expected.name);
+            EXPECT_EQ(outputs[i].value, expected.value);
+            EXPECT_EQ(outputs[i].array.size(), expected.array.size());
+        }
+    }
+    EXPECT_EQ(parsed, expectedParsed);
+    EXPECT_LT(parsed, frames.size());
+    EXPECT_GT(parsed, 0u);
+}
+
+struct Tick
+{
+    uint64_t timestamp;
+    uint32_t price;
+    uint16_t quantity;
+    uint8_t side;
+    void setTimestamp(uint64_t v) { timestamp = v; }
+    void setPrice(uint32_t v) { price = v; }
+    void setQuantity(uint16_t v) { quantity = v; }
+    void setSide(uint8_t v) { side = v; }
+};
+
+TEST_F(Test, ParseFixedBatch)
+{
+    auto parser = makePacketParser(
+        VALUE_FIELD_ENDIAN(&Tick::setTimestamp, uint64_t),
+        VALUE_FIELD_ENDIAN(&Tick::setPrice, uint32_t),
+        VALUE_FIELD(&Tick::setQuantity, uint16_t),
+        VALUE_FIELD(&Tick::setSide, uint8_t)
+    );
+
+    // Group sizes not multiple of the lane count, with a truncated frame
+    auto generator = makePacketGenerator(parser);
+    vector<unsigned char> data;
+    vector<Frame> frames;
+    generator.generateCorpus(37, data, frames);
+    frames[20].length -= 3;
+
+    vector<Tick> outputs(frames.size(), Tick{0, 0, 0, 0});
+    vector<ParseResult> results(frames.size());
+    EXPECT_EQ(parser.parseFixedBatch(Span<const Frame>(frames), Span<Tick>(outputs), Span<ParseResult>(results)), 36u);
+
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+        if (i == 20)
+        {
+            EXPECT_EQ(results[i].error, PacketParserErrorId::ExceededDataRange);
+            EXPECT_EQ(outputs[i].timestamp, 0u);
+            continue;
+        }
+
+        Tick expected{0, 0, 0, 0};
+        ASSERT_EQ(parser.parse(frames[i].data, frames[i].length, expected), PacketParserErrorId::NoError);
+        EXPECT_EQ(results[i].error, PacketParserErrorId::NoError);
+        EXPECT_EQ(results[i].length, 15u);
+        EXPECT_EQ(outputs[i].timestamp, expected.timestamp);
+        EXPECT_EQ(outputs[i].price, expected.price);
+        EXPECT_EQ(outputs[i].quantity, expected.quantity);
+        EXPECT_EQ(outputs[i].side, expected.side);
+    }
+
+    // Columns
+    vector<uint64_t> timestamps(frames.size() - 21);
+    vector<uint32_t> prices(frames.size() - 21);
+    parser.gatherField<0>(Span<const Frame>(&frames[21], frames.size() - 21), timestamps.data());
+    parser.gatherField<1>(Span<const Frame>(&frames[21], frames.size() - 21), prices.data());
+    for (size_t i = 0; i < timestamps.size(); ++i)
+    {
+        EXPECT_EQ(timestamps[i], outputs[21 + i].timestamp);
+        EXPECT_EQ(prices[i], outputs[21 + i].price);
+    }
+}
+
+TEST_F(Test, ParallelParser)
+{
+    auto parser = makePacketParser(
+        TEXT_FIELD(&MyPacket::setName, 16),
+        VALUE_FIELD(&MyPacket::setValue, uint32_t),
+        DYNAMIC_ARRAY(uint8_t,
+            MULTI_FIELD(SubPacket, &MyPacket::addToArray,
+                TEXT_FIELD_ALLOW_EMPTY(&SubPacket::setName, 16),
+                VALUE_FIELD_ENDIAN(&SubPacket::setValue, uint32_t)
+            )
+        )
+    );
+
+    GeneratorOptions options;
+    options.corruptionRate = 0.1;
+    vector<unsigned char> data;
+    vector<Frame> frames;
+    makePacketGenerator(parser, options).generateCorpus(2000, data, frames);
+
+    ParallelOptions parallelOptions;
+    parallelOptions.threadCount = 4;
+    parallelOptions.chunkSize = 7;
+    parallelOptions.chunksInFlight = 2;
+    auto parallelParser = makeParallelParser(parser, parallelOptions);
+    EXPECT_EQ(parallelParser.threadCount(), 4u);
+
+    // Outputs at the index of their frame
+    vector<MyPacket> outputs(frames.size(), MyPacket{});
+    vector<ParseResult> results(frames.size());
+    const size_t parsed = parallelParser.parse(Span<const Frame>(frames), Span<MyPacket>(outputs), Span<ParseResult>(results));
+
+    vector<MyPacket> expected(frames.size(), MyPacket{});
+    vector<ParseResult> expectedResults(frames.size());
+    EXPECT_EQ(parsed, parser.parseBatch(Span<const Frame>(frames), Span<MyPacket>(expected), Span<ParseResult>(expectedResults)));
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+        ASSERT_EQ(results[i].error, expectedResults[i].error);
+        ASSERT_EQ(results[i].length, expectedResults[i].length);
+        ASSERT_EQ(outputs[i].name, expected[i].name);
+        ASSERT_EQ(outputs[i].array.size(), expected[i].array.size());
+    }
+
+    // Ordered sink, over several windows
+    size_t nextIndex = 0;
+    size_t sinkParsed = 0;
+    EXPECT_EQ(parallelParser.parseToSink<MyPacket>(Span<const Frame>(frames), [&](size_t index, MyPacket& output, const ParseResult& result)
+    {
+        ASSERT_EQ(index, nextIndex++);
+        ASSERT_EQ(result.error, expectedResults[index].error);
+        ASSERT_EQ(output.value, expected[index].value);
+        sinkParsed += result.error == PacketParserErrorId::NoError ? 1 : 0;
+    }), parsed);
+    EXPECT_EQ(nextIndex, frames.size());
+    EXPECT_EQ(sinkParsed, parsed);
+}
+
+struct Quote
+{
+    uint16_t instrument;
+    uint32_t sequence;
+    void setInstrument(uint16_t v) { instrument = v; }
+    void setSequence(uint32_t v) { sequence = v; }
+};
+
+TEST_F(Test, ShardedParser)
+{
+    auto parser = makePacketParser(
+        VALUE_FIELD(&Quote::setInstrument, uint16_t),
+        VALUE_FIELD(&Quote::setSequence, uint32_t)
+    );
+
+    // Interleaved sequences of 50 instruments
+    const size_t instrumentCount = 50;
+    const size_t quoteCount = 20000;
+    vector<unsigned char> data(quoteCount * 6);
+    vector<Frame> frames(quoteCount);
+    for (size_t i = 0; i < quoteCount; ++i)
+    {
+        storeUnaligned(&data[i * 6], static_cast<uint16_t>(i % instrumentCount));
+        storeUnaligned(&data[i * 6 + 2], static_cast<uint32_t>(i / instrumentCount));
+        frames[i] = {&data[i * 6], 6};
+    }
+
+    ShardingOptions options;
+    options.shardCount = 4;
+    options.queueCapacity = 64;
+    options.wait = WaitStrategy::Backoff;
+
+    // Each shard only touches its own entries of the instruments it owns
+    vector<uint32_t> nextSequence(instrumentCount, 0);
+    vector<size_t> outOfOrder(options.shardCount, 0);
+    vector<size_t> handled(options.shardCount, 0);
+    {
+        auto sharded = makeShardedParser<0, Quote>(parser, [&](size_t shard, Quote& quote, const ParseResult& result)
+        {
+            ++handled[shard];
+            if (result.error != PacketParserErrorId::NoError || quote.sequence != nextSequence[quote.instrument]++)
+                ++outOfOrder[shard];
+        }, options);
+
+        for (const Frame& frame : frames)
+            sharded.dispatch(frame);
+        sharded.drain();
+
+        size_t frameCount = 0;
+        for (const ShardStats& shard : sharded.stats())
+        {
+            EXPECT_EQ(shard.frames, shard.parsed);
+            frameCount += shard.frames;
+        }
+        EXPECT_EQ(frameCount, quoteCount);
+        EXPECT_GE(sharded.imbalance(), 1.0);
+        EXPECT_EQ(sharded.shardOf(frames[0]), sharded.shardOf(frames[instrumentCount]));
+
+        // Too short for the key
+        EXPECT_EQ(sharded.shardOf(Frame{data.data(), 1}), 0u);
+    }
+
+    for (size_t shard = 0; shard < options.shardCount; ++shard)
+        EXPECT_EQ(outOfOrder[shard], 0u);
+    for (uint32_t sequence : nextSequence)
+        EXPECT_EQ(sequence, quoteCount / instrumentCount);
+}
+
+struct Level
+{
+    uint64_t price;
+    uint32_t quantity;
+    void setPrice(uint64_t v) { price = v; }
+    void setQuantity(uint32_t v) { quantity = v; }
+};
+
+struct Snapshot
+{
+    vector<Level> levels;
+    vector<uint32_t> ids;
+    void addLevel(Level& level) { levels.push_back(level); }
+    void addId(uint32_t id) { ids.push_back(id); }
+};
+
+TEST_F(Test, ParallelArray)
+{
+    auto parser = makePacketParser(
+        DYNAMIC_ARRAY(uint32_t,
+            MULTI_FIELD(Level, &Snapshot::addLevel,
+                VALUE_FIELD_ENDIAN(&Level::setPrice, uint64_t),
+                VALUE_FIELD(&Level::setQuantity, uint32_t)
+            )
+        ),
+        DYNAMIC_ARRAY(uint16_t, VALUE_FIELD_ENDIAN(&Snapshot::addId, uint32_t))
+    );
+
+    GeneratorOptions options;
+    options.arraySize = {1000, 5000};
+    vector<unsigned char> packet;
+    makePacketGenerator(parser, options).generate(packet);
+
+    Snapshot expected;
+    ASSERT_EQ(parser.parse(packet.data(), packet.size(), expected), PacketParserErrorId::NoError);
+    ASSERT_GE(expected.levels.size(), 1000u);
+
+    WorkStealingPool pool(4);
+    auto parallelParser = parser;
+    parallelParser.setArrayExecutor(makeArrayExecutor(pool, 100));
+
+    Snapshot output;
+    ASSERT_EQ(parallelParser.parse(packet.data(), packet.size(), output), PacketParserErrorId::NoError);
+    ASSERT_EQ(output.levels.size(), expected.levels.size());
+    ASSERT_EQ(output.ids, expected.ids);
+    for (size_t i = 0; i < expected.levels.size(); ++i)
+    {
+        ASSERT_EQ(output.levels[i].price, expected.levels[i].price);
+        ASSERT_EQ(output.levels[i].quantity, expected.levels[i].quantity);
+    }
+
+    // Truncated arrays take the serial path and fail the same way
+    Snapshot truncated;
+    Snapshot expectedTruncated;
+    EXPECT_EQ(parallelParser.parse(packet.data(), packet.size() - 3, truncated), PacketParserErrorId::ExceededDataRange);
+    EXPECT_EQ(parser.parse(packet.data(), packet.size() - 3, expectedTruncated), PacketParserErrorId::ExceededDataRange);
+    EXPECT_EQ(truncated.levels.size(), expectedTruncated.levels.size());
+    EXPECT_EQ(truncated.ids.size(), expectedTruncated.ids.size());
+
+    // Elements taking no bytes are not split in ranges
+    auto emptyLevelsParser = makePacketParser(DYNAMIC_ARRAY(uint32_t, makeMultiField<Level>(&Snapshot::addLevel)));
+    emptyLevelsParser.setArrayExecutor(makeArrayExecutor(pool, 100));
+    const unsigned char emptyLevels[] = {200, 0, 0, 0};
+    Snapshot emptyLevelsOutput;
+    EXPECT_EQ(emptyLevelsParser.parse(emptyLevels, sizeof(emptyLevels), emptyLevelsOutput), PacketParserErrorId::NoError);
+    EXPECT_EQ(emptyLevelsOutput.levels.size(), 200u);
+
+    // Workers of a ParallelParser share the executor of their parser copies
+    auto idsParser = makePacketParser(DYNAMIC_ARRAY(uint32_t, VALUE_FIELD(&Snapshot::addId, uint32_t)));
+    GeneratorOptions idsOptions;
+    idsOptions.arraySize = {5000, 5000};
+    vector<unsigned char> data;
+    vector<Frame> frames;
+    makePacketGenerator(idsParser, idsOptions).generateCorpus(64, data, frames);
+
+    auto executedIdsParser = idsParser;
+    executedIdsParser.setArrayExecutor(makeArrayExecutor(pool, 64));
+    ParallelOptions parallelOptions;
+    parallelOptions.threadCount = 4;
+    parallelOptions.chunkSize = 1;
+    auto framesParser = makeParallelParser(executedIdsParser, parallelOptions);
+
+    vector<Snapshot> outputs(frames.size());
+    vector<ParseResult> results(frames.size());
+    ASSERT_EQ(framesParser.parse(Span<const Frame>(frames), Span<Snapshot>(outputs), Span<ParseResult>(results)), frames.size());
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+        Snapshot expectedIds;
+        ASSERT_EQ(idsParser.parse(frames[i].data, frames[i].length, expectedIds), PacketParserErrorId::NoError);
+        ASSERT_EQ(outputs[i].ids, expectedIds.ids);
+    }
+
+    // Jobs started by tasks of the same pool run inline
+    vector<size_t> nestedTasks(8, 0);
+    pool.run(nestedTasks.size(), [&](size_t task, size_t)
+    {
+        pool.run(16, [&](size_t, size_t) { ++nestedTasks[task]; });
+    });
+    EXPECT_EQ(nestedTasks, vector<size_t>(8, 16));
+}
+
+struct Record
+{
+    string name;
+    uint32_t value;
+    vector<unsigned char> payload;
+    void setName(const char* s) { name = s; }
+    void setValue(uint32_t v) { value = v; }
+    void setPayload(const unsigned char* data, size_t length) { payload.assign(data, data + length); }
+};
+
+struct RecordBatch
+{
+    vector<Record> records;
+    void addRecord(Record& record) { records.push_back(record); }
+};
+
+TEST_F(Test, TwoPhaseArray)
+{
+    auto parser = makePacketParser(
+        DYNAMIC_ARRAY(uint32_t,
+            MULTI_FIELD(Record, &RecordBatch::addRecord,
+                TEXT_FIELD_ALLOW_EMPTY(&Record::setName, 32),
+                VALUE_FIELD_ENDIAN(&Record::setValue, uint32_t),
+                BINARY_FIELD(uint8_t, &Record::setPayload)
+            )
+        )
+    );
+
+    WorkStealingPool pool(4);
+    auto parallelParser = parser;
+    parallelParser.setArrayExecutor(makeArrayExecutor(pool, 100));
+
+    GeneratorOptions options;
+    options.arraySize = {500, 2000};
+    options.textLength = {0, 31, SizeDistribution::Shape::Skewed};
+    options.binaryLength = {0, 40};
+    options.corruptionRate = 0.5;
+    auto generator = makePacketGenerator(parser, options);
+
+    // Scanned then decoded in parallel, corrupted packets fall back to the serial path
+    vector<unsigned char> packet;
+    for (size_t i = 0; i < 20; ++i)
+    {
+        generator.generate(packet);
+
+        RecordBatch expected;
+        RecordBatch output;
+        ASSERT_EQ(parallelParser.parse(packet.data(), packet.size(), output), parser.parse(packet.data(), packet.size(), expected));
+        ASSERT_EQ(output.records.size(), expected.records.size());
+        for (size_t j = 0; j < expected.records.size(); ++j)
+        {
+            ASSERT_EQ(output.records[j].name, expected.records[j].name);
+            ASSERT_EQ(output.records[j].value, expected.records[j].value);
+            ASSERT_EQ(output.records[j].payload, expected.records[j].payload);
+        }
+    }
+}
+
+TEST_F(Test, Pipeline)
+{
+    auto parser = makePacketParser(
+        TEXT_FIELD(&MyPacket::setName, 16),
+        VALUE_FIELD(&MyPacket::setValue, uint32_t),
+        DYNAMIC_ARRAY(uint8_t,
+            MULTI_FIELD(SubPacket, &MyPacket::addToArray,
+                TEXT_FIELD_ALLOW_EMPTY(&SubPacket::setName, 16),
+                VALUE_FIELD_ENDIAN(&SubPacket::setValue, uint32_t)
+            )
+        )
+    );
+
+    vector<unsigned char> data;
+    vector<Frame> frames;
+    makePacketGenerator(parser).generateCorpus(2000, data, frames);
+    vector<uint32_t> expected;
+    for (const Frame& frame : frames)
+    {
+        MyPacket output{};
+        parser.parse(frame.data, frame.length, output);
+        expected.push_back(output.value);
+    }
+
+    // Datagrams, one thread per stage
+    {
+        vector<uint32_t> values;
+        PipelineOptions options;
+        options.queueCapacity = 16;
+        options.maxChunkSize = 2048;
+        options.wait = WaitStrategy::Backoff;
+        auto pipeline = makePipeline<MyPacket>(parser, MemorySource(Span<const Frame>(frames)), DatagramFramer(), [&](MyPacket& output, const ParseResult& result)
+        {
+            EXPECT_EQ(result.error, PacketParserErrorId::NoError);
+            values.push_back(output.value);
+        }, options);
+        pipeline.start();
+        pipeline.wait();
+
+        EXPECT_EQ(values, expected);
+        EXPECT_EQ(pipeline.metrics(PipelineStage::Ingest).processed, frames.size());
+        EXPECT_EQ(pipeline.metrics(PipelineStage::Dispatch).processed, frames.size());
+        EXPECT_EQ(pipeline.metrics(PipelineStage::Parse).dropped, 0u);
+        EXPECT_LE(pipeline.metrics(PipelineStage::Parse).maxQueueDepth, 16u);
+        EXPECT_GT(pipeline.metrics(PipelineStage::Dispatch).totalLatency, 0u);
+    }
+
+    // Source returning an empty chunk before each datagram, the chunk is read again by ingest
+    {
+        vector<Frame> chunks;
+        for (const Frame& frame : frames)
+        {
+            chunks.push_back({frame.data, 0});
+            chunks.push_back(frame);
+        }
+
+        vector<uint32_t> values;
+        PipelineOptions options;
+        options.queueCapacity = 2;
+        options.maxChunkSize = 2048;
+        auto pipeline = makePipeline<MyPacket>(parser, MemorySource(Span<const Frame>(chunks)), DatagramFramer(), [&](MyPacket& output, const ParseResult&)
+        {
+            values.push_back(output.value);
+        }, options);
+        pipeline.start();
+        pipeline.wait();
+
+        EXPECT_EQ(values, expected);
+        EXPECT_EQ(pipeline.metrics(PipelineStage::Ingest).processed, chunks.size());
+        EXPECT_EQ(pipeline.metrics(PipelineStage::Frame).processed, frames.size());
+    }
+
+    // Length-prefixed stream cut in chunks of random sizes, run to completion
+    {
+        vector<unsigned char> stream;
+        for (const Frame& frame : frames)
+        {
+            const uint16_t length = static_cast<uint16_t>(frame.length);
+            stream.insert(stream.end(), reinterpret_cast<const unsigned char*>(&length), reinterpret_cast<const unsigned char*>(&length) + 2);
+            stream.insert(stream.end(), frame.data, frame.data + frame.length);
+        }
+        vector<Frame> chunks;
+        FastRandom random(7);
+        for (size_t offset = 0; offset < stream.size();)
+        {
+            const size_t length = min(random.nextInRange(1, 100), stream.size() - offset);
+            chunks.push_back({&stream[offset], length});
+            offset += length;
+        }
+
+        vector<uint32_t> values;
+        PipelineOptions options;
+        options.mode = PipelineMode::RunToCompletion;
+        auto pipeline = makePipeline<MyPacket>(parser, MemorySource(Span<const Frame>(chunks)), LengthPrefixFramer<uint16_t>(), [&](MyPacket& output, const ParseResult&)
+        {
+            values.push_back(output.value);
+        }, options);
+        pipeline.start();
+        pipeline.wait();
+
+        EXPECT_EQ(values, expected);
+        EXPECT_EQ(pipeline.metrics(PipelineStage::Frame).processed, chunks.size());
+    }
+
+    // Saturated handler, every item is either handled or counted as dropped
+    {
+        size_t handled = 0;
+        PipelineOptions options;
+        options.overflow = OverflowPolicy::Drop;
+        options.queueCapacity = 4;
+        options.maxChunkSize = 2048;
+        auto pipeline = makePipeline<MyPacket>(parser, MemorySource(Span<const Frame>(frames)), DatagramFramer(), [&](MyPacket&, const ParseResult&)
+        {
+            if (handled++ == 0)
+                this_thread::sleep_for(chrono::milliseconds(50));
+        }, options);
+        pipeline.start();
+        pipeline.wait();
+
+        const size_t dropped = pipeline.metrics(PipelineStage::Ingest).dropped
+            + pipeline.metrics(PipelineStage::Frame).dropped
+            + pipeline.metrics(PipelineStage::Parse).dropped;
+        EXPECT_GT(dropped, 0u);
+        EXPECT_EQ(handled + dropped, frames.size());
+
+        // Dropped items are not counted as processed
+        EXPECT_EQ(pipeline.metrics(PipelineStage::Ingest).processed + pipeline.metrics(PipelineStage::Ingest).dropped, frames.size());
+        EXPECT_EQ(pipeline.metrics(PipelineStage::Parse).processed, handled);
+    }
+}
+
+struct PooledPacket
+{
+    string name;
+    uint32_t value;
+    vector<SubPacket> array;
+    void setName(const char* s) { name = s; }
+    void setValue(uint32_t v) { value = v; }
+    void addToArray(SubPacket& sp) { array.emplace_back(sp); }
+    void reset() { name.clear(); value = 0; array.clear(); }
+};
+
+TEST_F(Test, ObjectPool)
+{
+    auto parser = makePacketParser(
+        TEXT_FIELD(&PooledPacket::setName, 64),
+        VALUE_FIELD(&PooledPacket::setValue, uint32_t),
+        DYNAMIC_ARRAY(uint8_t,
+            MULTI_FIELD(SubPacket, &PooledPacket::addToArray,
+                TEXT_FIELD_ALLOW_EMPTY(&SubPacket::setName, 16),
+                VALUE_FIELD_ENDIAN(&SubPacket::setValue, uint32_t)
+            )
+        )
+    );
+
+    GeneratorOptions options;
+    options.textLength = {40, 60};
+    options.arraySize = {10, 20};
+    vector<unsigned char> data;
+    vector<Frame> frames;
+    makePacketGenerator(parser, options).generateCorpus(2, data, frames);
+
+    // Released objects come back reset, with their capacity
+    ObjectPool<PooledPacket> pool(1);
+    PacketParserErrorId error = PacketParserErrorId::Unknown;
+    const PooledPacket* first = nullptr;
+    size_t nameCapacity = 0;
+    size_t arrayCapacity = 0;
+    {
+        auto output = parsePooled(parser, pool, frames[0].data, frames[0].length, error);
+        ASSERT_EQ(error, PacketParserErrorId::NoError);
+        EXPECT_GE(output->array.size(), 10u);
+        first = output.get();
+        nameCapacity = output->name.capacity();
+        arrayCapacity = output->array.capacity();
+    }
+    {
+        auto output = pool.acquire();
+        EXPECT_EQ(output.get(), first);
+        EXPECT_TRUE(output->name.empty());
+        EXPECT_TRUE(output->array.empty());
+        EXPECT_EQ(output->name.capacity(), nameCapacity);
+        EXPECT_EQ(output->array.capacity(), arrayCapacity);
+
+        // Exhausted pools allocate, the extra object is deleted on release as the pool is full
+        auto extra = parsePooled(parser, pool, frames[1].data, frames[1].length, error);
+        EXPECT_NE(extra.get(), first);
+    }
+
+    // Concurrent acquire and release
+    ObjectPool<PooledPacket> sharedPool(8);
+    vector<thread> threads;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        threads.emplace_back([&]
+        {
+            for (size_t j = 0; j < 10000; ++j)
+            {
+                auto output = sharedPool.acquire();
+                EXPECT_TRUE(output->name.empty());
+                output->name = "used";
+            }
+        });
+    }
+    for (thread& thread : threads)
+        thread.join();
+}
+
+TEST_F(Test, FieldInstrumentation)
+{
+    auto parser = makeBasicPacketParser<FieldInstrumentation>(
+        TEXT_FIELD(&MyPacket::setName, 16),
+        VALUE_FIELD(&MyPacket::setValue, uint32_t),
+        DYNAMIC_ARRAY(uint8_t,
+            MULTI_FIELD(SubPacket, &MyPacket::addToArray,
+                TEXT_FIELD_ALLOW_EMPTY(&SubPacket::setName, 16),
+                VALUE_FIELD_ENDIAN(&SubPacket::setValue, uint32_t))));
+    static_assert(decltype(parser)::fieldNodeCount == 6, "Fields, subfields and array elements are counted");
+
+    GeneratorOptions options;
+    options.arraySize = {4, 4};
+    vector<unsigned char> data;
+    makePacketGenerator(parser, options).generate(data);
+    resetFieldProfile(parser);
+
+    // Measures from every thread are added up
+    MyPacket output{};
+    ASSERT_EQ(parser.parse(data.data(), data.size(), output), PacketParserErrorId::NoError);
+    thread([&]
+    {
+        auto copy = parser;
+        MyPacket threadOutput{};
+        EXPECT_EQ(copy.parse(data.data(), data.size(), threadOutput), PacketParserErrorId::NoError);
+    }).join();
+
+    FieldProfile profile = snapshotFieldProfile(parser);
+    EXPECT_EQ(profile.paths, (vector<string>{"0", "1", "2", "2[]", "2[].0", "2[].1"}));
+    ASSERT_EQ(profile.counters.size(), 6u);
+    EXPECT_EQ(profile.counters[0].count, 2u);
+    EXPECT_EQ(profile.counters[2].count, 2u);
+    EXPECT_EQ(profile.counters[3].count, 8u);
+    EXPECT_EQ(profile.counters[5].count, 8u);
+    EXPECT_EQ(profile.counters[1].bytes, 8u);
+    EXPECT_EQ(profile.counters[5].bytes, 32u);
+
+    // Top-level fields cover the packet, nested fields are included in their parent
+    EXPECT_EQ(profile.counters[0].bytes + profile.counters[1].bytes + profile.counters[2].bytes, 2 * data.size());
+    EXPECT_EQ(profile.counters[3].bytes, profile.counters[4].bytes + profile.counters[5].bytes);
+    EXPECT_EQ(profile.counters[2].bytes, profile.counters[3].bytes + 2);
+
+    profile.merge(snapshotFieldProfile(parser));
+    EXPECT_EQ(profile.counters[3].count, 16u);
+
+    resetFieldProfile(parser);
+    EXPECT_EQ(snapshotFieldProfile(parser).counters[0].count, 0u);
+}
+
+TEST_F(Test, Diagnostics)
+{
+    const unsigned char data[] =
+    {
+        'A', 'l', 'e', 'x', 'a', 'n', 'd', 'r', 'e', ' ', 'D', 'u', 'm', 'a', 's', 0,
+        0x01, 0x01, 0x00, 0x00,
+        0x04,
+            0,
+            0x00, 0x00, 0x00, 0x01,
+            'A', 'r', 'a', 'm', 'i', 's', 0,
+            0x00, 0x00, 0x00, 0x02,
+            'A', 't', 'h', 'o', 's', 0,
+            0x00, 0x00, 0x00, 0x03,
+            'P', 'o', 'r', 't', 'h', 'o', 's', 0,
+            0x00, 0x00, 0x00, 0x04,
+    };
+
+    auto parser = makePacketParser(
+        TEXT_FIELD(&MyPacket::setName, 16),
+        VALUE_FIELD(&MyPacket::setValue, uint32_t),
+        DYNAMIC_ARRAY(uint8_t,
+            MULTI_FIELD(SubPacket, &MyPacket::addToArray,
+                TEXT_FIELD_ALLOW_EMPTY(&SubPacket::setName, 16),
+                VALUE_FIELD_ENDIAN(&SubPacket::setValue, uint32_t))));
+
+    MyPacket output{};
+    ParseDiagnostics diagnostics{};
+    EXPECT_EQ(parser.parse(data, sizeof(data), output, diagnostics), PacketParserErrorId::NoError);
+    EXPECT_EQ(diagnostics.error, PacketParserErrorId::NoError);
+    EXPECT_EQ(diagnostics.offset, sizeof(data));
+    EXPECT_TRUE(diagnostics.fieldPath.empty());
+
+    // Truncated in the value of the third element
+    output = {};
+    EXPECT_EQ(parser.parse(data, 45, output, diagnostics), PacketParserErrorId::ExceededDataRange);
+    EXPECT_EQ(diagnostics.error, PacketParserErrorId::ExceededDataRange);
+    EXPECT_EQ(diagnostics.fieldPath, "2[2].1");
+    EXPECT_EQ(diagnostics.offset, 43u);
+    EXPECT_EQ(diagnostics.neededBytes, 4u);
+    EXPECT_EQ(diagnostics.availableBytes, 2u);
+
+    // Empty name
+    vector<unsigned char> emptyName(data, data + sizeof(data));
+    emptyName[0] = 0;
+    output = {};
+    EXPECT_EQ(parser.parse(emptyName.data(), emptyName.size(), output, diagnostics), PacketParserErrorId::EmptyTextNotAllowed);
+    EXPECT_EQ(diagnostics.fieldPath, "0");
+    EXPECT_EQ(diagnostics.offset, 0u);
+    EXPECT_EQ(diagnostics.neededBytes, 0u);
+
+    // Shorter than any valid packet, reported as such rather than by its first invalid field
+    vector<unsigned char> shortPacket(3, 0);
+    output = {};
+    EXPECT_EQ(parser.parse(shortPacket.data(), shortPacket.size(), output, diagnostics), PacketParserErrorId::ExceededDataRange);
+    EXPECT_EQ(diagnostics.error, PacketParserErrorId::ExceededDataRange);
+    EXPECT_TRUE(diagnostics.fieldPath.empty());
+    EXPECT_EQ(diagnostics.offset, 0u);
+    EXPECT_EQ(diagnostics.neededBytes, parser.minWireSize());
+    EXPECT_EQ(diagnostics.availableBytes, shortPacket.size());
+
+    // Forged array size, diagnosed without parsing
+    vector<unsigned char> forgedSize(data, data + sizeof(data));
+    forgedSize[20] = 0xff;
+    parser.diagnose(forgedSize.data(), forgedSize.size(), diagnostics);
+    EXPECT_EQ(diagnostics.error, PacketParserErrorId::ExceededDataRange);
+    EXPECT_EQ(diagnostics.fieldPath, "2[4].0");
+    EXPECT_EQ(diagnostics.offset, sizeof(data));
+    EXPECT_EQ(diagnostics.neededBytes, 1u);
+    EXPECT_EQ(diagnostics.availableBytes, 0u);
+
+    // Fixed-size elements past the end are located without walking the elements in range
+    auto valuesParser = makePacketParser(STATIC_ARRAY(1000, VALUE_FIELD(&MyPacket::setValue, uint32_t)));
+    valuesParser.diagnose(data, sizeof(data), diagnostics);
+    EXPECT_EQ(diagnostics.fieldPath, "0[14]");
+    EXPECT_EQ(diagnostics.offset, 56u);
+    EXPECT_EQ(diagnostics.availableBytes, 3u);
+}
+
+TEST_F(Test, ParserStats)
+{
+    auto parser = makePacketParser(
+        VALUE_FIELD(&Quote::setInstrument, uint16_t),
+        VALUE_FIELD_ENDIAN(&Quote::setSequence, uint32_t));
+    const unsigned char data[] = {0x01, 0x00, 0x00, 0x00, 0x00, 0x02};
+
+    // Counted by several threads, added up on read
+    ParserStats stats;
+    vector<thread> threads;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        threads.emplace_back([&]
+        {
+            auto threadParser = parser;
+            Quote quote{};
+            for (size_t j = 0; j < 1000; ++j)
+            {
+                parseCounted(threadParser, stats, data, sizeof(data), quote);
+                parseCounted(threadParser, stats, data, 3, quote);
+            }
+        });
+    }
+    for (thread& thread : threads)
+        thread.join();
+
+    ParserStatsSnapshot snapshot = stats.snapshot();
+    EXPECT_EQ(snapshot.packets(), 8000u);
+    EXPECT_EQ(snapshot.count(PacketParserErrorId::NoError), 4000u);
+    EXPECT_EQ(snapshot.count(PacketParserErrorId::ExceededDataRange), 4000u);
+    EXPECT_EQ(snapshot.bytes, 4000u * 9);
+    EXPECT_EQ(snapshot.sizes[ParserStatsSnapshot::sizeBucket(6)], 4000u);
+    EXPECT_EQ(snapshot.sizes[2], 4000u);
+
+    // Batches
+    const Frame frames[] = {{data, sizeof(data)}, {data, 1}};
+    ParseResult results[2];
+    vector<Quote> quotes(2);
+    parser.parseBatch(Span<const Frame>(frames, 2), Span<Quote>(quotes), Span<ParseResult>(results, 2));
+    stats.record(Span<const Frame>(frames, 2), Span<const ParseResult>(results, 2));
+    snapshot = stats.snapshot();
+    EXPECT_EQ(snapshot.count(PacketParserErrorId::NoError), 4001u);
+    EXPECT_EQ(snapshot.sizes[1], 1u);
+
+    ParserStatsSnapshot merged = snapshot;
+    merged.merge(snapshot);
+    EXPECT_EQ(merged.packets(), 2 * snapshot.packets());
+
+#if defined(__linux__)
+    // Published to shared memory for a scraper
+    const string name = "/gpp-stats-test-" + to_string(getpid());
+    {
+        SharedStatsExporter exporter(name.c_str());
+        ASSERT_TRUE(exporter.isOpen());
+        exporter.publish(snapshot);
+    }
+    ParserStatsSnapshot scraped{};
+    EXPECT_TRUE(readSharedStats(name.c_str(), scraped));
+    EXPECT_EQ(scraped.packets(), snapshot.packets());
+    EXPECT_EQ(scraped.bytes, snapshot.bytes);
+    shm_unlink(name.c_str());
+    EXPECT_FALSE(readSharedStats(name.c_str(), scraped));
+#endif
+}
+
+TEST_F(Test, LatencyHistogram)
+{
+    // Buckets cover every value without gaps, within 1/64
+    for (uint64_t value : {uint64_t(0), uint64_t(63), uint64_t(64), uint64_t(127), uint64_t(128), uint64_t(1000), uint64_t(123456789), UINT64_MAX})
+    {
+        const size_t bucket = LatencySnapshot::bucketIndex(value);
+        EXPECT_LE(LatencySnapshot::bucketLowest(bucket), value);
+        EXPECT_GE(LatencySnapshot::bucketHighest(bucket), value);
+        EXPECT_LE(LatencySnapshot::bucketHighest(bucket) - LatencySnapshot::bucketLowest(bucket), value / 64);
+    }
+    EXPECT_EQ(LatencySnapshot::bucketIndex(UINT64_MAX), LatencySnapshot::bucketCount - 1);
+
+    // Recorded by several threads, added up on read
+    LatencyRecorder recorder;
+    vector<thread> threads;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        threads.emplace_back([&]
+        {
+            for (uint64_t ticks = 1; ticks <= 1000; ++ticks)
+                recorder.record(ticks);
+        });
+    }
+    for (thread& thread : threads)
+        thread.join();
+
+    LatencySnapshot snapshot = recorder.snapshot();
+    EXPECT_GT(snapshot.nanosecondsPerTick, 0.0);
+    snapshot.nanosecondsPerTick = 1.0;
+    EXPECT_EQ(snapshot.count(), 4000u);
+    EXPECT_EQ(snapshot.max(), 1000.0);
+    EXPECT_EQ(snapshot.mean(), 500.5);
+    EXPECT_NEAR(snapshot.percentile(50), 500, 500 / 64.0);
+    EXPECT_NEAR(snapshot.percentile(99), 990, 990 / 64.0);
+    EXPECT_NEAR(snapshot.percentile(99.9), 999, 999 / 64.0);
+    EXPECT_EQ(snapshot.percentile(100), 1000.0);
+
+    LatencySnapshot merged = snapshot;
+    merged.merge(snapshot);
+    EXPECT_EQ(merged.count(), 8000u);
+    EXPECT_EQ(merged.max(), 1000.0);
+
+    // Intervals hold the samples recorded since the previous one
+    EXPECT_EQ(recorder.intervalSnapshot().count(), 4000u);
+    recorder.record(5000);
+    recorder.record(20);
+    LatencySnapshot interval = recorder.intervalSnapshot();
+    interval.nanosecondsPerTick = 1.0;
+    EXPECT_EQ(interval.count(), 2u);
+    EXPECT_EQ(interval.max(), 5000.0);
+    EXPECT_EQ(interval.mean(), 2510.0);
+    EXPECT_EQ(recorder.intervalSnapshot().count(), 0u);
+    EXPECT_EQ(recorder.snapshot().count(), 4002u);
+
+    // Parses and batches
+    auto parser = makePacketParser(
+        VALUE_FIELD(&Quote::setInstrument, uint16_t),
+        VALUE_FIELD_ENDIAN(&Quote::setSequence, uint32_t));
+    const unsigned char data[] = {0x01, 0x00, 0x00, 0x00, 0x00, 0x02};
+    LatencyRecorder parses;
+    Quote quote{};
+    EXPECT_EQ(parseTimed(parser, parses, data, sizeof(data), quote), PacketParserErrorId::NoError);
+    EXPECT_EQ(quote.sequence, 2u);
+
+    const Frame frames[] = {{data, sizeof(data)}, {data, 1}, {data, sizeof(data)}};
+    ParseResult results[3];
+    vector<Quote> quotes(3);
+    EXPECT_EQ(parseBatchTimed(parser, parses, Span<const Frame>(frames, 3), Span<Quote>(quotes), Span<ParseResult>(results, 3)), 2u);
+    EXPECT_EQ(parses.snapshot().count(), 4u);
+}
+
+struct Trade
+{
+    uint32_t id;
+    string venue;
+    vector<unsigned char> note;
+    vector<uint16_t> sizes;
+    void setId(uint32_t v) { id = v; }
+    void setVenue(const char* s) { venue = s; }
+    void setNote(const unsigned char* data, size_t length) { note.assign(data, data + length); }
+    void addSize(uint16_t v) { sizes.push_back(v); }
+};
+
+TEST_F(Test, ColumnBatch)
+{
+    auto parser = makePacketParser(
+        VALUE_FIELD_ENDIAN(&Trade::setId, uint32_t),
+        TEXT_FIELD(&Trade::setVenue, 8),
+        BINARY_FIELD(uint8_t, &Trade::setNote),
+        DYNAMIC_ARRAY(uint8_t, VALUE_FIELD_ENDIAN(&Trade::addSize, uint16_t)));
+
+    const unsigned char first[] = {0, 0, 0, 1, 'X', 'N', 'Y', 'S', 0, 2, 0xAA, 0xBB, 2, 0, 10, 0, 20};
+    const unsigned char second[] = {0, 0, 0, 2, 'B', 'A', 'T', 0, 0, 0};
+    // Invalid in its array, after its text and binary were decoded
+    const unsigned char truncated[] = {0, 0, 0, 3, 'L', 'S', 'E', 0, 1, 0xCC, 3, 0, 1};
+    const Frame frames[] = {{first, sizeof(first)}, {truncated, sizeof(truncated)}, {second, sizeof(second)}};
+
+    auto batch = makeColumnBatch(parser);
+    ParseResult results[3];
+    EXPECT_EQ(parseColumns(parser, Span<const Frame>(frames, 3), batch, Span<ParseResult>(results, 3)), 2u);
+    EXPECT_EQ(results[1].error, PacketParserErrorId::ExceededDataRange);
+    ASSERT_EQ(batch.rows, 3u);
+
+    const auto& ids = batch.column<0>();
+    EXPECT_EQ(ids[0], 1u);
+    EXPECT_EQ(ids[2], 2u);
+    EXPECT_FALSE(ids.valid(1));
+
+    // Null rows take no bytes in variable columns
+    const TextColumn& venues = batch.column<1>();
+    EXPECT_EQ(venues[0], "XNYS");
+    EXPECT_TRUE(venues[1].empty());
+    EXPECT_FALSE(venues.valid(1));
+    EXPECT_EQ(venues[2], "BAT");
+    EXPECT_EQ(venues.data.size(), 7u);
+
+    const BinaryColumn& notes = batch.column<2>();
+    EXPECT_EQ(notes[0].size(), 2u);
+    EXPECT_EQ(notes[0][1], 0xBB);
+    EXPECT_TRUE(notes[2].empty());
+    EXPECT_TRUE(notes.valid(2));
+
+    const auto& sizes = batch.column<3>();
+    ASSERT_EQ(sizes[0].size(), 2u);
+    EXPECT_EQ(sizes[0][1], 20);
+    EXPECT_EQ(sizes[1].size(), 0u);
+    EXPECT_EQ(sizes[2].size(), 0u);
+    EXPECT_EQ(sizes.values.size(), 2u);
+
+    // Appended after the current rows, long arrays copied and byte swapped in bulk
+    vector<unsigned char> longArray = {0, 0, 0, 4, 'X', 0, 0, 40};
+    for (uint16_t i = 0; i < 40; ++i)
+    {
+        longArray.push_back(0);
+        longArray.push_back(static_cast<unsigned char>(i));
+    }
+    const Frame more[] = {{first, sizeof(first)}, {longArray.data(), longArray.size()}};
+    EXPECT_EQ(parseColumns(parser, Span<const Frame>(more, 2), batch, Span<ParseResult>(results, 2)), 2u);
+    EXPECT_EQ(batch.rows, 5u);
+    EXPECT_EQ(batch.column<1>()[3], "XNYS");
+    ASSERT_EQ(batch.column<3>()[4].size(), 40u);
+    EXPECT_EQ(batch.column<3>()[4][39], 39);
+    batch.clear();
+    EXPECT_EQ(batch.rows, 0u);
+    EXPECT_EQ(batch.column<1>().size(), 0u);
+
+    // Held to the work budget of the parser, like parse()
+    WorkBudget budget;
+    budget.maxElements = 1;
+    parser.setWorkBudget(budget);
+    Trade trade{};
+    EXPECT_EQ(parser.parse(first, sizeof(first), trade), PacketParserErrorId::WorkBudgetExceeded);
+    EXPECT_EQ(parseColumns(parser, Span<const Frame>(frames, 3), batch, Span<ParseResult>(results, 3)), 1u);
+    EXPECT_EQ(results[0].error, PacketParserErrorId::WorkBudgetExceeded);
+    EXPECT_EQ(results[1].error, PacketParserErrorId::WorkBudgetExceeded);
+    EXPECT_EQ(results[2].error, PacketParserErrorId::NoError);
+    EXPECT_FALSE(batch.column<3>().valid(0));
+    batch.clear();
+
+    // Value-only layouts are gathered column by column
+    auto quoteParser = makePacketParser(
+        VALUE_FIELD(&Quote::setInstrument, uint16_t),
+        VALUE_FIELD_ENDIAN(&Quote::setSequence, uint32_t));
+    const unsigned char quote[] = {0x01, 0x00, 0x00, 0x00, 0x00, 0x02};
+    vector<Frame> quotes(20, Frame{quote, sizeof(quote)});
+    auto quoteBatch = makeColumnBatch(quoteParser);
+    vector<ParseResult> quoteResults(20);
+    EXPECT_EQ(parseColumns(quoteParser, Span<const Frame>(quotes), quoteBatch, Span<ParseResult>(quoteResults)), 20u);
+    EXPECT_EQ(quoteBatch.column<1>()[19], 2u);
+
+    quotes[7].length = 3;
+    EXPECT_EQ(parseColumns(quoteParser, Span<const Frame>(quotes), quoteBatch, Span<ParseResult>(quoteResults)), 19u);
+    EXPECT_EQ(quoteBatch.rows, 40u);
+    EXPECT_FALSE(quoteBatch.column<0>().valid(27));
+    EXPECT_EQ(quoteBatch.column<0>()[28], 1u);
+
+    WorkBudget quoteBudget;
+    quoteBudget.maxSetterCalls = 1;
+    quoteParser.setWorkBudget(quoteBudget);
+    quotes[7].length = sizeof(quote);
+    EXPECT_EQ(parseColumns(quoteParser, Span<const Frame>(quotes), quoteBatch, Span<ParseResult>(quoteResults)), 0u);
+    EXPECT_EQ(quoteResults[0].error, PacketParserErrorId::WorkBudgetExceeded);
+}
+
+struct Tape
+{
+    vector<Tick> ticks;
+    void addTick(Tick& tick) { ticks.push_back(tick); }
+};
+
+TEST_F(Test, RecordTransposition)
+{
+    auto tickField = MULTI_FIELD(Tick, &Tape::addTick,
+        VALUE_FIELD_ENDIAN(&Tick::setTimestamp, uint64_t),
+        VALUE_FIELD_ENDIAN(&Tick::setPrice, uint32_t),
+        VALUE_FIELD(&Tick::setQuantity, uint16_t),
+        VALUE_FIELD(&Tick::setSide, uint8_t));
+    auto tapeParser = makePacketParser(DYNAMIC_ARRAY(uint32_t, tickField));
+
+    // Counts around the shuffle group sizes, against the records parsed one by one
+    for (uint32_t count = 0; count < 70; ++count)
+    {
+        GeneratorOptions options;
+        options.arraySize = {count, count};
+        vector<unsigned char> packet;
+        makePacketGenerator(tapeParser, options).generate(packet);
+        Tape tape;
+        ASSERT_EQ(tapeParser.parse(packet.data(), packet.size(), tape), PacketParserErrorId::NoError);
+
+        vector<uint64_t> timestamps(count);
+        vector<uint32_t> prices(count);
+        vector<uint16_t> quantities(count);
+        vector<uint8_t> sides(count);
+        transposeRecords<decltype(tickField)>(packet.data() + sizeof(uint32_t), count,
+            timestamps.data(), prices.data(), quantities.data(), sides.data());
+        for (size_t i = 0; i < count; ++i)
+        {
+            ASSERT_EQ(timestamps[i], tape.ticks[i].timestamp);
+            ASSERT_EQ(prices[i], tape.ticks[i].price);
+            ASSERT_EQ(quantities[i], tape.ticks[i].quantity);
+            ASSERT_EQ(sides[i], tape.ticks[i].side);
+        }
+    }
+
+    // Arrays of value records get a column per member
+    auto parser = makePacketParser(
+        DYNAMIC_ARRAY(uint32_t,
+            MULTI_FIELD(Level, &Snapshot::addLevel,
+                VALUE_FIELD_ENDIAN(&Level::setPrice, uint64_t),
+                VALUE_FIELD(&Level::setQuantity, uint32_t))),
+        DYNAMIC_ARRAY(uint16_t, VALUE_FIELD_ENDIAN(&Snapshot::addId, uint32_t)));
+
+    GeneratorOptions options;
+    options.arraySize = {0, 300};
+    vector<unsigned char> data;
+    vector<Frame> frames;
+    makePacketGenerator(parser, options).generateCorpus(20, data, frames);
+    frames[5].length -= 3;
+
+    auto batch = makeColumnBatch(parser);
+    vector<ParseResult> results(frames.size());
+    EXPECT_EQ(parseColumns(parser, Span<const Frame>(frames), batch, Span<ParseResult>(results)), 19u);
+
+    const auto& levels = batch.column<0>();
+    size_t levelCount = 0;
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+        Snapshot expected;
+        const PacketParserErrorId error = parser.parse(frames[i].data, frames[i].length, expected);
+        ASSERT_EQ(levels.valid(i), error == PacketParserErrorId::NoError);
+        if (!levels.valid(i))
+        {
+            EXPECT_EQ(levels.member<0>(i).size(), 0u);
+            continue;
+        }
+
+        ASSERT_EQ(levels.member<0>(i).size(), expected.levels.size());
+        for (size_t j = 0; j < expected.levels.size(); ++j)
+        {
+            ASSERT_EQ(levels.member<0>(i)[j], expected.levels[j].price);
+            ASSERT_EQ(levels.member<1>(i)[j], expected.levels[j].quantity);
+        }
+        levelCount += expected.levels.size();
+    }
+
+    // Null rows roll back the records they appended
+    EXPECT_EQ(std::get<0>(levels.members).size(), levelCount);
+    EXPECT_EQ(std::get<1>(levels.members).size(), levelCount);
+}
+
+struct Order
+{
+    InternedText symbol;
+    InternedText venue;
+    uint32_t quantity;
+    void setSymbol(InternedText text) { symbol = text; }
+    void setVenue(InternedText text) { venue = text; }
+    void setQuantity(uint32_t v) { quantity = v; }
+};
+
+TEST_F(Test, StringInterning)
+{
+    // Hashes found while scanning for the terminator match those of known lengths, whatever follows
+    vector<unsigned char> text(48, 0xEE);
+    for (size_t length = 0; length < 40; ++length)
+    {
+        for (size_t i = 0; i < length; ++i)
+            text[i] = static_cast<unsigned char>('a' + i % 26);
+        text[length] = 0;
+
+        size_t scannedLength = 0;
+        uint64_t hash = 0;
+        ASSERT_TRUE(scanText(text.data(), text.size(), scannedLength, hash));
+        ASSERT_EQ(scannedLength, length);
+        ASSERT_EQ(hash, hashText(reinterpret_cast<const char*>(text.data()), length));
+        ASSERT_FALSE(scanText(text.data(), length, scannedLength, hash));
+    }
+
+    StringInterner interner;
+    auto parser = makePacketParser(
+        INTERNED_TEXT(TEXT_FIELD(&Order::setSymbol, 8), interner),
+        INTERNED_TEXT(TEXT_FIELD_ALLOW_EMPTY(&Order::setVenue, 8), interner),
+        VALUE_FIELD(&Order::setQuantity, uint32_t));
+
+    const unsigned char first[] = {'A', 'A', 'P', 'L', 0, 'X', 'N', 'A', 'S', 0, 1, 0, 0, 0};
+    const unsigned char second[] = {'M', 'S', 'F', 'T', 0, 0, 2, 0, 0, 0};
+    const unsigned char third[] = {'A', 'A', 'P', 'L', 0, 'X', 'N', 'A', 'S', 0, 3, 0, 0, 0};
+    Order orders[3];
+    ASSERT_EQ(parser.parse(first, sizeof(first), orders[0]), PacketParserErrorId::NoError);
+    ASSERT_EQ(parser.parse(second, sizeof(second), orders[1]), PacketParserErrorId::NoError);
+    ASSERT_EQ(parser.parse(third, sizeof(third), orders[2]), PacketParserErrorId::NoError);
+
+    EXPECT_EQ(orders[0].symbol.id, orders[2].symbol.id);
+    EXPECT_NE(orders[0].symbol.id, orders[1].symbol.id);
+    EXPECT_EQ(orders[0].venue.id, orders[2].venue.id);
+    EXPECT_EQ(orders[1].venue.text, "");
+    EXPECT_EQ(orders[2].symbol.text.data(), orders[0].symbol.text.data());
+    EXPECT_EQ(orders[2].quantity, 3u);
+    EXPECT_EQ(interner.size(), 4u);
+    EXPECT_EQ(interner.find("MSFT"), orders[1].symbol.id);
+    EXPECT_EQ(interner.find("IBM"), StringInterner::invalidId);
+
+    // Same errors as plain text fields
+    const unsigned char empty[] = {0, 0, 1, 0, 0, 0, 0};
+    const unsigned char unterminated[] = {'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 0};
+    const unsigned char truncated[] = {'A', 'B'};
+    Order order;
+    EXPECT_EQ(parser.parse(empty, sizeof(empty), order), PacketParserErrorId::EmptyTextNotAllowed);
+    EXPECT_EQ(parser.parse(unterminated, sizeof(unterminated), order), PacketParserErrorId::MissingNullTerminator);
+    EXPECT_EQ(parser.parse(truncated, sizeof(truncated), order), PacketParserErrorId::ExceededDataRange);
+
+    // Pooled texts stay in place and keep their ID while the table grows
+    StringInterner small(4);
+    vector<string> texts;
+    vector<InternedText> interned;
+    for (size_t i = 0; i < 5000; ++i)
+    {
+        texts.push_back("symbol" + to_string(i));
+        interned.push_back(small.intern(texts.back()));
+        ASSERT_EQ(interned.back().id, i);
+    }
+    EXPECT_EQ(small.size(), 5000u);
+    for (size_t i = 0; i < texts.size(); ++i)
+    {
+        ASSERT_EQ(small.find(texts[i]), i);
+        ASSERT_EQ(small.intern(texts[i]).text.data(), interned[i].text.data());
+        ASSERT_EQ(small.text(static_cast<uint32_t>(i)), texts[i]);
+    }
+}
+
+struct Bucket
+{
+    vector<uint8_t> values;
+    void addValue(uint8_t v) { values.push_back(v); }
+};
+
+struct Buckets
+{
+    vector<Bucket> buckets;
+    void addBucket(Bucket& bucket) { buckets.push_back(bucket); }
+};
+
+TEST_F(Test, WorkBudget)
+{
+    const unsigned char data[] =
+    {
+        0x03, 0x00,
+            0x02, 0x00, 1, 2,
+            0x02, 0x00, 3, 4,
+            0x02, 0x00, 5, 6,
+    };
+
+    auto parser = makePacketParser(
+        DYNAMIC_ARRAY(uint16_t,
+            MULTI_FIELD(Bucket, &Buckets::addBucket,
+                DYNAMIC_ARRAY(uint16_t, VALUE_FIELD(&Bucket::addValue, uint8_t)))));
+
+    auto parse = [&](WorkBudget budget, const unsigned char* packet, size_t length)
+    {
+        Buckets output;
+        parser.setWorkBudget(budget);
+        return parser.parse(packet, length, output);
+    };
+
+    // 9 elements and 9 setter calls, nested 4 deep
+    EXPECT_EQ(parse({}, data, sizeof(data)), PacketParserErrorId::NoError);
+    EXPECT_EQ(parse({4, 9, 9}, data, sizeof(data)), PacketParserErrorId::NoError);
+    EXPECT_EQ(parse({3, 9, 9}, data, sizeof(data)), PacketParserErrorId::WorkBudgetExceeded);
+    EXPECT_EQ(parse({4, 8, 9}, data, sizeof(data)), PacketParserErrorId::WorkBudgetExceeded);
+    EXPECT_EQ(parse({4, 9, 8}, data, sizeof(data)), PacketParserErrorId::WorkBudgetExceeded);
+
+    // A forged size fails before any element is parsed
+    vector<unsigned char> forged(data, data + sizeof(data));
+    forged[0] = 0xff;
+    forged[1] = 0xff;
+    Buckets output;
+    parser.setWorkBudget({SIZE_MAX, 1000, SIZE_MAX});
+    EXPECT_EQ(parser.parse(forged.data(), forged.size(), output), PacketParserErrorId::WorkBudgetExceeded);
+    EXPECT_TRUE(output.buckets.empty());
+}